@@ -0,0 +1,66 @@
+# Sweeps sphere count, icosphere subdivision and sphere mode and prints one CSV
+# row per run with the acceleration structure memory, build time and ray rate.
+#
+#   python scripts/sphere_benchmark.py --build build --spheres 1000 100000 --subdivisions 1 2 3
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+STAT = re.compile(r'^(\w+)(?:\[(\d+)\])?: (\d+)')
+
+
+def find_executable(build, name):
+    for candidate in [os.path.join(build, name), os.path.join(build, 'Release', name + '.exe'), os.path.join(build, name + '.exe')]:
+        if os.path.exists(candidate):
+            return candidate
+    sys.exit('cannot find ' + name + ' in ' + build)
+
+
+def parse_stats(output):
+    stats = {}
+    for line in output.splitlines():
+        match = STAT.match(line)
+        if match:
+            key, device, value = match.groups()
+            # Device 0 is reported, as the scene is replicated on every GPU.
+            if device is None or device == '0':
+                stats[key] = int(value)
+    return stats
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--build', default='build')
+    parser.add_argument('--spheres', type=int, nargs='+', default=[1000, 10000, 100000])
+    parser.add_argument('--subdivisions', type=int, nargs='+', default=[1, 2, 3])
+    parser.add_argument('--frames', type=int, default=300)
+    parser.add_argument('--samples', type=int, default=1)
+    args = parser.parse_args()
+
+    renderer = find_executable(args.build, 'RayTracingGPUVulkan')
+    generator = find_executable(args.build, 'scene_generator')
+
+    print('spheres,mode,subdivision,acceleration_structure_bytes,as_build_time_per_frame,primary_rays_per_second')
+    with tempfile.TemporaryDirectory() as directory:
+        for spheres in args.spheres:
+            scene = os.path.join(directory, 'spheres_%d.rtsc' % spheres)
+            subprocess.run([generator, '--spheres', str(spheres), '--output', scene], check=True, capture_output=True)
+            runs = [('aabb', 0)] + [('icosphere', subdivision) for subdivision in args.subdivisions]
+            for mode, subdivision in runs:
+                result = subprocess.run([renderer, '--scene', scene, '--sphere-mode', mode,
+                                         '--icosphere-subdivision', str(subdivision),
+                                         '--frames', str(args.frames), '--samples', str(args.samples)],
+                                        check=True, capture_output=True, text=True)
+                stats = parse_stats(result.stdout)
+                print('%d,%s,%d,%s,%s,%s' % (spheres, mode, subdivision,
+                                            stats.get('acceleration_structure_bytes', ''),
+                                            stats.get('as_build_time_per_frame', ''),
+                                            stats.get('primary_rays_per_second', '')))
+
+
+if __name__ == '__main__':
+    main()
@@ -1,7 +1,103 @@
+# Drives the renderer C interface of src/ray_trace_renderer.h through ctypes: renders the generated scene
+# progressively, prints the stats after every render and stores the image as a PPM.
+#
+#   python scripts/test.py --build build --width 640 --height 360 --renders 4 --samples 16
+
+import argparse
 import ctypes
+import os
+import sys
+
+
+class Stats(ctypes.Structure):
+    _fields_ = [
+        ('width', ctypes.c_uint32),
+        ('height', ctypes.c_uint32),
+        ('samples', ctypes.c_uint32),
+        ('render_count', ctypes.c_uint32),
+        ('total_samples', ctypes.c_uint64),
+        ('startup_ms', ctypes.c_double),
+        ('scene_ms', ctypes.c_double),
+        ('last_render_ms', ctypes.c_double),
+        ('total_render_ms', ctypes.c_double),
+    ]
+
+
+def find_library(build):
+    for candidate in [os.path.join(build, 'libray_trace.so'), os.path.join(build, 'libray_trace.dylib'),
+                      os.path.join(build, 'Release', 'ray_trace.dll'), os.path.join(build, 'Debug', 'ray_trace.dll')]:
+        if os.path.exists(candidate):
+            return candidate
+    sys.exit('cannot find the ray_trace library in ' + build)
+
+
+def load_library(path):
+    ray = ctypes.cdll.LoadLibrary(path)
+    renderer = ctypes.c_void_p
+    floats = ctypes.POINTER(ctypes.c_float)
+    ray.ray_trace_renderer_create.argtypes = [ctypes.c_uint32]
+    ray.ray_trace_renderer_create.restype = renderer
+    ray.ray_trace_renderer_destroy.argtypes = [renderer]
+    ray.ray_trace_renderer_destroy.restype = None
+    ray.ray_trace_renderer_load_scene.argtypes = [renderer, ctypes.c_char_p, ctypes.POINTER(ctypes.c_char_p), ctypes.c_uint32,
+                                                  ctypes.c_uint32, ctypes.c_uint32, ctypes.c_float]
+    ray.ray_trace_renderer_update_scene.argtypes = [renderer, ctypes.c_float]
+    ray.ray_trace_renderer_set_resolution.argtypes = [renderer, ctypes.c_uint32, ctypes.c_uint32]
+    ray.ray_trace_renderer_set_camera.argtypes = [renderer, floats, floats]
+    ray.ray_trace_renderer_render.argtypes = [renderer, ctypes.c_uint32]
+    ray.ray_trace_renderer_read_image.argtypes = [renderer, ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t]
+    for name in ['load_scene', 'update_scene', 'set_resolution', 'set_camera', 'render', 'read_image', 'get_stats']:
+        getattr(ray, 'ray_trace_renderer_' + name).restype = ctypes.c_bool
+    ray.ray_trace_renderer_get_stats.argtypes = [renderer, ctypes.POINTER(Stats)]
+    ray.ray_trace_get_last_error.argtypes = []
+    ray.ray_trace_get_last_error.restype = ctypes.c_char_p
+    return ray
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--build', default='build')
+    parser.add_argument('--gpu', type=int, default=0)
+    parser.add_argument('--scene', default=None)
+    parser.add_argument('--width', type=int, default=640)
+    parser.add_argument('--height', type=int, default=360)
+    parser.add_argument('--renders', type=int, default=4)
+    parser.add_argument('--samples', type=int, default=16)
+    parser.add_argument('--output', default='render_result.ppm')
+    args = parser.parse_args()
+
+    ray = load_library(find_library(args.build))
+
+    def check(succeeded):
+        if not succeeded:
+            sys.exit(ray.ray_trace_get_last_error().decode())
+
+    renderer = ray.ray_trace_renderer_create(args.gpu)
+    check(renderer)
+    try:
+        check(ray.ray_trace_renderer_load_scene(renderer, args.scene.encode() if args.scene else None, None, 0, 0, 2, 0.0))
+        check(ray.ray_trace_renderer_set_resolution(renderer, args.width, args.height))
+        position = (ctypes.c_float * 3)(13.0, 2.0, -3.0)
+        direction = (ctypes.c_float * 3)(-13.0, -2.0, 3.0)
+        check(ray.ray_trace_renderer_set_camera(renderer, position, direction))
+
+        stats = Stats()
+        for _ in range(args.renders):
+            check(ray.ray_trace_renderer_render(renderer, args.samples))
+            check(ray.ray_trace_renderer_get_stats(renderer, ctypes.byref(stats)))
+            print('samples: %d, render: %.2f ms, total render: %.2f ms, startup: %.2f ms, scene: %.2f ms'
+                  % (stats.samples, stats.last_render_ms, stats.total_render_ms, stats.startup_ms, stats.scene_ms))
 
-ray = ctypes.cdll.LoadLibrary('./Debug/ray_trace.dll')
+        image = (ctypes.c_uint8 * (args.width * args.height * 4))()
+        check(ray.ray_trace_renderer_read_image(renderer, image, len(image)))
+        rgb = bytes(image)
+        with open(args.output, 'wb') as file:
+            file.write(b'P6\n%d %d\n255\n' % (args.width, args.height))
+            file.write(b''.join(rgb[texel:texel + 3] for texel in range(0, len(rgb), 4)))
+        print('stored: ' + args.output)
+    finally:
+        ray.ray_trace_renderer_destroy(renderer)
 
-print(dir(ray))
 
-ray.ray_trace(100, 10, False, 1920, 1080)
+if __name__ == '__main__':
+    main()
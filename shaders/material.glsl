@@ -0,0 +1,102 @@
+// Material evaluation shared by the closest-hit shaders.
+// The including shader declares the ray payload as "payload".
+
+// ENUMS
+const uint MATERIAL_TYPE_DIFFUSE = 0;
+const uint MATERIAL_TYPE_METAL = 1;
+const uint MATERIAL_TYPE_REFRACTIVE = 2;
+
+const uint TEXTURE_TYPE_SOLID = 0;
+const uint TEXTURE_TYPE_CHECKERED = 1;
+
+
+// METHODS
+vec4 getTextureColor(const Material material, const vec3 point);
+vec3 getScatterDirection(const Material material, const vec3 normal, const bool frontFace);
+bool isVectorNearZero(const vec3 vector);
+bool canRefract(const vec3 vector, const vec3 normal, const float eta);
+float reflectanceFactor(const vec3 vector, const vec3 normal, const float eta);
+
+
+// TEXTURE
+vec4 getTextureColor(const Material material, const vec3 point) {
+    if (material.textureType == TEXTURE_TYPE_SOLID) {
+        return material.colors[0];
+
+    } else if (material.textureType == TEXTURE_TYPE_CHECKERED) {
+        const float size = 6.0f;
+        const float sines = sin(size * point.x) * sin(size * point.y) * sin(size * point.z);
+        return material.colors[sines > 0.0f ? 0 : 1];
+    }
+
+    return material.colors[0];
+}
+
+
+// MATERIAL
+vec3 getDiffuseScatterDirection(const Material material, const vec3 normal) {
+    vec3 scatterDirection = normal + randomUnitVector(payload.seed);
+
+    if (isVectorNearZero(scatterDirection)) {
+        scatterDirection = normal;
+    }
+
+    return scatterDirection;
+}
+
+vec3 getMetalScatterDirection(const Material material, const vec3 normal) {
+    const vec3 reflectedDirection = reflect(gl_WorldRayDirectionEXT, normal);
+    const vec3 fuzzDireciton = material.materialSpecificAttribute * randomUnitVector(payload.seed);
+    const vec3 scatterDirection = normalize(reflectedDirection + fuzzDireciton);
+
+    const bool doesScatter = dot(scatterDirection, normal) > 0.0f;
+    if (!doesScatter) {
+        return vec3(0.0f);
+    }
+
+    return scatterDirection;
+}
+
+vec3 getRefractiveScatterDirection(const Material material, const vec3 normal, const bool frontFace) {
+    const float eta = frontFace ? (1.0f / material.materialSpecificAttribute) : material.materialSpecificAttribute;
+    const bool doesRefract = canRefract(gl_WorldRayDirectionEXT, normal, eta) && reflectanceFactor(gl_WorldRayDirectionEXT, normal, eta) < randomFloat(payload.seed);
+
+    if (doesRefract) {
+        return refract(gl_WorldRayDirectionEXT, normal, eta);
+    }
+
+    return reflect(gl_WorldRayDirectionEXT, normal);
+}
+
+vec3 getScatterDirection(const Material material, const vec3 normal, const bool frontFace) {
+    if (material.materialType == MATERIAL_TYPE_DIFFUSE) {
+        return getDiffuseScatterDirection(material, normal);
+    }
+
+    if (material.materialType == MATERIAL_TYPE_METAL) {
+        return getMetalScatterDirection(material, normal);
+    }
+
+    if (material.materialType == MATERIAL_TYPE_REFRACTIVE) {
+        return getRefractiveScatterDirection(material, normal, frontFace);
+    }
+
+    return vec3(0.0f);
+}
+
+
+// UTILITY
+bool isVectorNearZero(const vec3 vector) {
+    const float s = 1e-8;
+    return abs(vector.x) < s && abs(vector.y) < s && abs(vector.z) < s;
+}
+
+bool canRefract(const vec3 vector, const vec3 normal, const float eta) {
+    const float cosTheta = dot(-vector, normal);
+    return eta * sqrt(1.0f - cosTheta * cosTheta) <= 1.0f;
+}
+
+float reflectanceFactor(const vec3 vector, const vec3 normal, const float eta) {
+    const float r = pow((1.0f - eta) / (1.0f + eta), 2.0f);
+    return r + (1.0f - r) * pow(1.0f - dot(-vector, normal), 5.0f);
+}
@@ -5,3 +5,6 @@ inline std::string rgen_shader_path = "${rgen_shader_path}";
 inline std::string rint_shader_path = "${rint_shader_path}";
 inline std::string rchit_shader_path = "${rchit_shader_path}";
 inline std::string rmiss_shader_path = "${rmiss_shader_path}";
+inline std::string comp_shader_path = "${comp_shader_path}";
+inline std::string triangle_rchit_shader_path = "${triangle_rchit_shader_path}";
+inline std::string icosphere_rchit_shader_path = "${icosphere_rchit_shader_path}";
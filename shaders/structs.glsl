@@ -31,8 +31,31 @@ struct Viewport {
 
 struct Sphere {
     vec4 geometry;
+};
+
+struct Material {
     uint materialType;
     uint textureType;
     vec4 colors[2];
     float materialSpecificAttribute;
 };
+
+struct SphereAnimation {
+    vec4 center;
+    vec4 amplitude;
+    vec4 angularFrequency;
+    vec4 phase;
+    uint sphereIndex;
+};
+
+struct MeshVertex {
+    vec4 position;
+    vec4 normal;
+};
+
+struct MeshInstanceInfo {
+    uint firstVertex;
+    uint firstIndex;
+    uvec2 reserved;
+    Material material;
+};
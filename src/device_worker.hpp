@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+namespace device_worker {
+	// Single-producer single-consumer ring buffer without locks: only the main
+	// thread pushes and only the worker pops.
+	template<typename T, size_t Capacity>
+	struct spsc_queue {
+		std::array<T, Capacity> slots{};
+		// Next slot to pop, written by the consumer only.
+		alignas(64) std::atomic<size_t> head{ 0 };
+		// Next slot to push, written by the producer only.
+		alignas(64) std::atomic<size_t> tail{ 0 };
+	};
+
+	template<typename T, size_t Capacity>
+	inline bool try_push(spsc_queue<T, Capacity>& queue, const T& value) {
+		auto tail = queue.tail.load(std::memory_order_relaxed);
+		if (tail - queue.head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+		queue.slots[tail % Capacity] = value;
+		queue.tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<typename T, size_t Capacity>
+	inline std::optional<T> try_pop(spsc_queue<T, Capacity>& queue) {
+		auto head = queue.head.load(std::memory_order_relaxed);
+		if (head == queue.tail.load(std::memory_order_acquire)) {
+			return std::nullopt;
+		}
+		auto value = queue.slots[head % Capacity];
+		queue.head.store(head + 1, std::memory_order_release);
+		return value;
+	}
+
+	// How many jobs a device may lag behind the main thread before push blocks.
+	constexpr size_t queue_capacity = 8;
+
+	// A long-lived thread owning one device: it runs the jobs pushed to it in
+	// order, so every device renders at its own pace.
+	template<typename Job>
+	struct worker {
+		spsc_queue<Job, queue_capacity> jobs;
+		// Bumped by every push and by stop, the worker sleeps on it while idle.
+		std::atomic<uint64_t> wake_count{ 0 };
+		std::atomic<uint64_t> done_count{ 0 };
+		// Only touched by the main thread.
+		uint64_t pushed_count = 0;
+		// The first exception thrown by a job, later jobs are skipped.
+		std::exception_ptr exception;
+		// Last member, so it is joined before the rest is destroyed.
+		std::jthread thread;
+	};
+
+	template<typename Job>
+	inline void start(worker<Job>& worker, std::function<void(const Job&)> run) {
+		worker.thread = std::jthread(
+			[&worker, run = std::move(run)](std::stop_token stop_token) {
+				// Also wakes an idle worker stopped by the jthread destructor.
+				auto wake_on_stop = std::stop_callback(stop_token,
+					[&worker]() {
+						worker.wake_count.fetch_add(1, std::memory_order_release);
+						worker.wake_count.notify_one();
+					});
+				while (true) {
+					auto seen_wake_count = worker.wake_count.load(std::memory_order_acquire);
+					if (auto job = try_pop(worker.jobs)) {
+						if (!worker.exception) {
+							try {
+								run(*job);
+							}
+							catch (...) {
+								worker.exception = std::current_exception();
+							}
+						}
+						worker.done_count.fetch_add(1, std::memory_order_release);
+						worker.done_count.notify_all();
+						continue;
+					}
+					if (stop_token.stop_requested()) {
+						return;
+					}
+					worker.wake_count.wait(seen_wake_count, std::memory_order_acquire);
+				}
+			});
+	}
+
+	template<typename Job>
+	inline void push(worker<Job>& worker, const Job& job) {
+		// A full queue means the device is queue_capacity jobs behind, wait for it to catch up.
+		while (!try_push(worker.jobs, job)) {
+			auto done_count = worker.done_count.load(std::memory_order_acquire);
+			if (try_push(worker.jobs, job)) {
+				break;
+			}
+			worker.done_count.wait(done_count, std::memory_order_acquire);
+		}
+		worker.pushed_count++;
+		worker.wake_count.fetch_add(1, std::memory_order_release);
+		worker.wake_count.notify_one();
+	}
+
+	// Waits until the worker has run every pushed job and rethrows the first exception of a job.
+	template<typename Job>
+	inline void wait_idle(worker<Job>& worker) {
+		auto done_count = worker.done_count.load(std::memory_order_acquire);
+		while (done_count != worker.pushed_count) {
+			worker.done_count.wait(done_count, std::memory_order_acquire);
+			done_count = worker.done_count.load(std::memory_order_acquire);
+		}
+		if (worker.exception) {
+			std::rethrow_exception(std::exchange(worker.exception, nullptr));
+		}
+	}
+
+	template<typename Job>
+	inline void stop(worker<Job>& worker) {
+		worker.thread.request_stop();
+		worker.thread.join();
+	}
+}
@@ -4,6 +4,7 @@
 #include <thread>
 #include <charconv>
 #include <cstring>
+#include <vector>
 
 #include "ray_trace.h"
 
@@ -15,15 +16,40 @@ int main(int argc, const char** argv) {
     uint32_t width = 1920;
     uint32_t height = 1080;
     uint32_t gpu_count = 1;
+    const char* scene_path = nullptr;
+    std::vector<const char*> mesh_specs;
+    uint32_t sphere_mode = 0;
+    uint32_t icosphere_subdivision = 2;
+    uint32_t max_frames = 0;
+    bool host_blas_builds = false;
+    uint32_t frames_in_flight = 0;
+    uint32_t tiles = 0;
+    const char* workload_cache_path = "workload_cache.txt";
+    bool cost_map = false;
+    bool sample_split = false;
+    uint32_t queues = 1;
 
     for (int i = 1; i < argc; i++) {
         if (argv[i] == "--help"s) {
             std::cout << "--help                            # Show this help infomation" << std::endl;
-            std::cout << "--store                           # Store rendered image to file" << std::endl;
+            std::cout << "--store                           # Store the image composited from all GPUs to render_result.png" << std::endl;
             std::cout << "--samples <count>                 # Total samples to render" << std::endl;
             std::cout << "--width <width>                   # Image width" << std::endl;
             std::cout << "--height <height>                 # Image height" << std::endl;
             std::cout << "--gpus <count>                    # Max used GPUs count" << std::endl;
+            std::cout << "--scene <path>                    # Binary scene file to render (see scene_generator)" << std::endl;
+            std::cout << "--mesh <path>[@x,y,z[,scale]]     # Place an OBJ or ASCII PLY mesh, may be repeated" << std::endl;
+            std::cout << "--sphere-mode <aabb|icosphere>    # Intersect spheres procedurally or as instanced triangle meshes" << std::endl;
+            std::cout << "--icosphere-subdivision <n>       # Subdivision level of the icosphere mode" << std::endl;
+            std::cout << "--frames <count>                  # Exit after rendering count frames" << std::endl;
+            std::cout << "--host-blas-builds                # Build static BLASes on the CPU cores if the GPU supports it" << std::endl;
+            std::cout << "--frames-in-flight <count>        # Frames the CPU may run ahead of the GPU, defaults to the swapchain image count" << std::endl;
+            std::cout << "--tiles <count>                   # Cut frames into count tiles the GPUs take as they go instead of strips" << std::endl;
+            std::cout << "--queues <count>                  # Compute queues per GPU the tiles are spread over" << std::endl;
+            std::cout << "--sample-split                    # Every GPU renders the whole frame with its share of the samples instead of strips" << std::endl;
+            std::cout << "--workload-cache <path>           # Learned GPU workload split to start from, workload_cache.txt by default" << std::endl;
+            std::cout << "--no-workload-cache               # Always start from an even split" << std::endl;
+            std::cout << "--cost-map                        # Split the GPU workload by the rays traced per row instead of by rows" << std::endl;
             exit(0);
         }
         else if (argv[i] == "--store"s) {
@@ -45,6 +71,62 @@ int main(int argc, const char** argv) {
             std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), gpu_count);
             ++i;
         }
+        else if (argv[i] == "--scene"s) {
+            scene_path = argv[i + 1];
+            ++i;
+        }
+        else if (argv[i] == "--mesh"s) {
+            mesh_specs.push_back(argv[i + 1]);
+            ++i;
+        }
+        else if (argv[i] == "--sphere-mode"s) {
+            if (argv[i + 1] == "aabb"s) {
+                sphere_mode = 0;
+            }
+            else if (argv[i + 1] == "icosphere"s) {
+                sphere_mode = 1;
+            }
+            else {
+                std::cerr << "unknown sphere mode: " << argv[i + 1] << std::endl;
+            }
+            ++i;
+        }
+        else if (argv[i] == "--icosphere-subdivision"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), icosphere_subdivision);
+            ++i;
+        }
+        else if (argv[i] == "--frames"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), max_frames);
+            ++i;
+        }
+        else if (argv[i] == "--host-blas-builds"s) {
+            host_blas_builds = true;
+        }
+        else if (argv[i] == "--frames-in-flight"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), frames_in_flight);
+            ++i;
+        }
+        else if (argv[i] == "--tiles"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), tiles);
+            ++i;
+        }
+        else if (argv[i] == "--queues"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), queues);
+            ++i;
+        }
+        else if (argv[i] == "--sample-split"s) {
+            sample_split = true;
+        }
+        else if (argv[i] == "--workload-cache"s) {
+            workload_cache_path = argv[i + 1];
+            ++i;
+        }
+        else if (argv[i] == "--no-workload-cache"s) {
+            workload_cache_path = nullptr;
+        }
+        else if (argv[i] == "--cost-map"s) {
+            cost_map = true;
+        }
         else {
             std::cerr << "unknown argument: " << argv[i] << std::endl;
         }
@@ -56,7 +138,20 @@ int main(int argc, const char** argv) {
             storeRenderResult,
             width,
             height,
-            gpu_count);
+            gpu_count,
+            scene_path,
+            mesh_specs.data(),
+            static_cast<uint32_t>(mesh_specs.size()),
+            sphere_mode,
+            icosphere_subdivision,
+            max_frames,
+            host_blas_builds,
+            frames_in_flight,
+            tiles,
+            workload_cache_path,
+            cost_map,
+            sample_split,
+            queues);
     }
     catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
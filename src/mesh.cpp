@@ -0,0 +1,379 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+static std::string readTextFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("[Error] Failed to open mesh at '" + path.string() + "'!");
+    }
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Splits a line into whitespace separated tokens without allocating.
+static size_t splitTokens(std::string_view line, std::span<std::string_view> tokens, const std::filesystem::path& path) {
+    size_t count = 0;
+    size_t pos = 0;
+    while (true) {
+        pos = line.find_first_not_of(" \t\r", pos);
+        if (pos == std::string_view::npos) {
+            break;
+        }
+        if (count == tokens.size()) {
+            throw std::runtime_error("[Error] Line with more than " + std::to_string(tokens.size()) + " tokens in mesh '" + path.string() + "'");
+        }
+        auto end = line.find_first_of(" \t\r", pos);
+        tokens[count++] = line.substr(pos, end - pos);
+        if (end == std::string_view::npos) {
+            break;
+        }
+        pos = end;
+    }
+    return count;
+}
+
+template<typename T>
+static T parseNumber(std::string_view token, const std::filesystem::path& path) {
+    T value{};
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (ec != std::errc{}) {
+        throw std::runtime_error("[Error] Invalid number '" + std::string(token) + "' in mesh '" + path.string() + "'");
+    }
+    return value;
+}
+
+static void forEachLine(std::string_view text, auto&& f) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        auto end = text.find('\n', pos);
+        if (end == std::string_view::npos) {
+            end = text.size();
+        }
+        f(text.substr(pos, end - pos));
+        pos = end + 1;
+    }
+}
+
+// Area-weighted vertex normals for the vertices the file gave no normal.
+static void computeMissingNormals(std::span<MeshVertex> vertices, std::span<const uint32_t> indices) {
+    std::vector<glm::vec3> normals(vertices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        auto a = glm::vec3(vertices[indices[i]].position);
+        auto b = glm::vec3(vertices[indices[i + 1]].position);
+        auto c = glm::vec3(vertices[indices[i + 2]].position);
+        auto faceNormal = glm::cross(b - a, c - a);
+        for (size_t j = 0; j < 3; j++) {
+            normals[indices[i + j]] += faceNormal;
+        }
+    }
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (vertices[i].normal == glm::vec4(0.0f) && glm::dot(normals[i], normals[i]) > 0.0f) {
+            vertices[i].normal = glm::vec4(glm::normalize(normals[i]), 0.0f);
+        }
+    }
+}
+
+static void loadObj(const std::filesystem::path& path, std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices) {
+    auto text = readTextFile(path);
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    // (position index, normal index) -> vertex, so corners sharing both share a vertex.
+    std::unordered_map<uint64_t, uint32_t> vertexIndices;
+
+    auto resolve = [&path](std::string_view token, size_t count) -> int64_t {
+        if (token.empty()) {
+            return -1;
+        }
+        auto index = parseNumber<int64_t>(token, path);
+        index = index < 0 ? static_cast<int64_t>(count) + index : index - 1;
+        if (index < 0 || index >= static_cast<int64_t>(count)) {
+            throw std::runtime_error("[Error] Index out of range in mesh '" + path.string() + "'");
+        }
+        return index;
+    };
+    auto getVertex = [&](std::string_view corner) {
+        auto positionToken = corner.substr(0, corner.find('/'));
+        std::string_view normalToken{};
+        if (auto slash = corner.rfind('/'); slash != std::string_view::npos && corner.find('/') != slash) {
+            normalToken = corner.substr(slash + 1);
+        }
+        auto position = resolve(positionToken, positions.size());
+        if (position < 0) {
+            throw std::runtime_error("[Error] Index out of range in mesh '" + path.string() + "'");
+        }
+        auto normal = resolve(normalToken, normals.size());
+        auto key = (static_cast<uint64_t>(position) << 32) | static_cast<uint32_t>(normal);
+        auto [ite, inserted] = vertexIndices.try_emplace(key, static_cast<uint32_t>(vertices.size()));
+        if (inserted) {
+            vertices.push_back({
+                .position = glm::vec4(positions[position], 1.0f),
+                .normal = normal < 0 ? glm::vec4(0.0f) : glm::vec4(normals[normal], 0.0f)
+            });
+        }
+        return ite->second;
+    };
+
+    std::array<std::string_view, 64> tokens{};
+    forEachLine(text, [&](std::string_view line) {
+        auto count = splitTokens(line, tokens, path);
+        if (count == 0) {
+            return;
+        }
+        if (tokens[0] == "v" && count >= 4) {
+            positions.emplace_back(parseNumber<float>(tokens[1], path), parseNumber<float>(tokens[2], path), parseNumber<float>(tokens[3], path));
+        }
+        else if (tokens[0] == "vn" && count >= 4) {
+            normals.emplace_back(parseNumber<float>(tokens[1], path), parseNumber<float>(tokens[2], path), parseNumber<float>(tokens[3], path));
+        }
+        else if (tokens[0] == "f" && count >= 4) {
+            auto first = getVertex(tokens[1]);
+            auto previous = getVertex(tokens[2]);
+            for (size_t i = 3; i < count; i++) {
+                auto current = getVertex(tokens[i]);
+                indices.insert(indices.end(), { first, previous, current });
+                previous = current;
+            }
+        }
+    });
+}
+
+static void loadPly(const std::filesystem::path& path, std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices) {
+    auto text = readTextFile(path);
+    auto fail = [&path](const std::string& reason) {
+        return std::runtime_error("[Error] Invalid PLY mesh '" + path.string() + "': " + reason);
+    };
+
+    struct Element {
+        std::string name;
+        size_t count;
+        std::vector<std::string> properties;
+    };
+    std::vector<Element> elements;
+    bool inHeader = true;
+    size_t elementIndex = 0;
+    size_t elementRow = 0;
+    std::array<std::string_view, 64> tokens{};
+
+    forEachLine(text, [&](std::string_view line) {
+        auto count = splitTokens(line, tokens, path);
+        if (count == 0) {
+            return;
+        }
+        if (inHeader) {
+            if (tokens[0] == "format" && count >= 2 && tokens[1] != "ascii") {
+                throw fail("only ASCII PLY is supported");
+            }
+            else if (tokens[0] == "element" && count >= 3) {
+                elements.push_back({ .name = std::string(tokens[1]), .count = parseNumber<size_t>(tokens[2], path) });
+            }
+            else if (tokens[0] == "property" && !elements.empty()) {
+                elements.back().properties.emplace_back(tokens[count - 1]);
+            }
+            else if (tokens[0] == "end_header") {
+                inHeader = false;
+            }
+            return;
+        }
+
+        while (elementIndex < elements.size() && elementRow == elements[elementIndex].count) {
+            elementIndex++;
+            elementRow = 0;
+        }
+        if (elementIndex == elements.size()) {
+            return;
+        }
+        auto& element = elements[elementIndex];
+        elementRow++;
+
+        if (element.name == "vertex") {
+            auto value = [&](std::string_view name, float fallback) {
+                auto ite = std::ranges::find(element.properties, name);
+                auto column = static_cast<size_t>(std::distance(element.properties.begin(), ite));
+                return column < count ? parseNumber<float>(tokens[column], path) : fallback;
+            };
+            vertices.push_back({
+                .position = glm::vec4(value("x", 0.0f), value("y", 0.0f), value("z", 0.0f), 1.0f),
+                .normal = glm::vec4(value("nx", 0.0f), value("ny", 0.0f), value("nz", 0.0f), 0.0f)
+            });
+        }
+        else if (element.name == "face") {
+            auto cornerCount = parseNumber<size_t>(tokens[0], path);
+            if (cornerCount < 3 || cornerCount + 1 > count) {
+                throw fail("bad face");
+            }
+            auto corner = [&](size_t i) {
+                auto index = parseNumber<uint32_t>(tokens[1 + i], path);
+                if (index >= vertices.size()) {
+                    throw fail("index out of range");
+                }
+                return index;
+            };
+            for (size_t i = 2; i < cornerCount; i++) {
+                indices.insert(indices.end(), { corner(0), corner(i - 1), corner(i) });
+            }
+        }
+    });
+    if (inHeader) {
+        throw fail("missing end_header");
+    }
+}
+
+uint32_t loadMesh(MeshScene& scene, const std::filesystem::path& path) {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    auto extension = path.extension().string();
+    std::ranges::transform(extension, extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (extension == ".obj") {
+        loadObj(path, vertices, indices);
+    }
+    else if (extension == ".ply") {
+        loadPly(path, vertices, indices);
+    }
+    else {
+        throw std::runtime_error("[Error] Unsupported mesh format '" + path.string() + "'!");
+    }
+    if (indices.empty()) {
+        throw std::runtime_error("[Error] Mesh '" + path.string() + "' has no triangles!");
+    }
+    computeMissingNormals(vertices, indices);
+
+    auto meshIndex = static_cast<uint32_t>(scene.meshes.size());
+    scene.meshes.push_back({
+        .firstVertex = static_cast<uint32_t>(scene.vertices.size()),
+        .vertexCount = static_cast<uint32_t>(vertices.size()),
+        .firstIndex = static_cast<uint32_t>(scene.indices.size()),
+        .indexCount = static_cast<uint32_t>(indices.size())
+    });
+    scene.meshPaths.push_back(path);
+    scene.vertices.insert(scene.vertices.end(), vertices.begin(), vertices.end());
+    scene.indices.insert(scene.indices.end(), indices.begin(), indices.end());
+    return meshIndex;
+}
+
+uint32_t addIcosphere(MeshScene& scene, uint32_t subdivision) {
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    std::vector<glm::vec3> positions = {
+        {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+        {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+        {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+    };
+    std::vector<uint32_t> indices = {
+        0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+        1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+        3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+        4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+    };
+    for (auto& position : positions) {
+        position = glm::normalize(position);
+    }
+
+    for (uint32_t level = 0; level < subdivision; level++) {
+        // Edge (smaller index, larger index) -> midpoint vertex, so neighbouring faces share it.
+        std::unordered_map<uint64_t, uint32_t> midpoints;
+        auto midpoint = [&positions, &midpoints](uint32_t a, uint32_t b) {
+            auto key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+            auto [ite, inserted] = midpoints.try_emplace(key, static_cast<uint32_t>(positions.size()));
+            if (inserted) {
+                auto p = positions[a] + positions[b];
+                positions.push_back(glm::normalize(p));
+            }
+            return ite->second;
+        };
+
+        std::vector<uint32_t> subdividedIndices;
+        subdividedIndices.reserve(indices.size() * 4);
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            auto a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            auto ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            subdividedIndices.insert(subdividedIndices.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+        }
+        indices = std::move(subdividedIndices);
+    }
+
+    auto meshIndex = static_cast<uint32_t>(scene.meshes.size());
+    scene.meshes.push_back({
+        .firstVertex = static_cast<uint32_t>(scene.vertices.size()),
+        .vertexCount = static_cast<uint32_t>(positions.size()),
+        .firstIndex = static_cast<uint32_t>(scene.indices.size()),
+        .indexCount = static_cast<uint32_t>(indices.size())
+    });
+    scene.meshPaths.push_back("<icosphere-" + std::to_string(subdivision) + ">");
+    std::ranges::transform(
+        positions,
+        std::back_inserter(scene.vertices),
+        [](auto& position) {
+            return MeshVertex{ .position = glm::vec4(position, 1.0f), .normal = glm::vec4(position, 0.0f) };
+        }
+    );
+    scene.indices.insert(scene.indices.end(), indices.begin(), indices.end());
+    return meshIndex;
+}
+
+void addMeshInstance(MeshScene& scene, std::string_view spec) {
+    auto at = spec.rfind('@');
+    auto path = std::filesystem::path(spec.substr(0, at));
+
+    glm::vec3 position(0.0f);
+    float scale = 1.0f;
+    if (at != std::string_view::npos) {
+        std::array<float, 4> values{ 0.0f, 0.0f, 0.0f, 1.0f };
+        auto placement = spec.substr(at + 1);
+        size_t valueCount = 0;
+        while (!placement.empty() && valueCount < values.size()) {
+            auto comma = placement.find(',');
+            values[valueCount++] = parseNumber<float>(placement.substr(0, comma), path);
+            placement = comma == std::string_view::npos ? std::string_view{} : placement.substr(comma + 1);
+        }
+        if (valueCount < 3) {
+            throw std::runtime_error("[Error] Mesh placement must be <path>@x,y,z[,scale], got '" + std::string(spec) + "'");
+        }
+        position = { values[0], values[1], values[2] };
+        scale = values[3];
+    }
+
+    auto ite = std::ranges::find(scene.meshPaths, path);
+    auto meshIndex = ite != scene.meshPaths.end()
+        ? static_cast<uint32_t>(std::distance(scene.meshPaths.begin(), ite))
+        : loadMesh(scene, path);
+
+    scene.instances.push_back({
+        .meshIndex = meshIndex,
+        .position = position,
+        .scale = scale,
+        .material = {
+            .materialType = MaterialType::DIFFUSE,
+            .textureType = TextureType::SOLID,
+            .colors = {glm::vec4(0.7f, 0.7f, 0.7f, 1.0f)},
+            .materialSpecificAttribute = 0.0f
+        }
+    });
+}
+
+std::vector<MeshInstanceInfo> getMeshInstanceInfos(const MeshScene& scene) {
+    std::vector<MeshInstanceInfo> infos(scene.instances.size());
+    std::ranges::transform(
+        scene.instances,
+        infos.begin(),
+        [&scene](auto& instance) {
+            auto& mesh = scene.meshes[instance.meshIndex];
+            return MeshInstanceInfo{
+                .firstVertex = mesh.firstVertex,
+                .firstIndex = mesh.firstIndex,
+                .material = instance.material
+            };
+        }
+    );
+    return infos;
+}
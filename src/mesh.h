@@ -0,0 +1,63 @@
+#pragma once
+
+#include "scene.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+// The position is read by the triangle BLAS build (R32G32B32 at offset 0),
+// the normal by the triangle hit shader. w of the normal is unused.
+struct MeshVertex {
+    alignas(16) glm::vec4 position;
+    alignas(16) glm::vec4 normal;
+};
+
+// Range of one mesh in the shared vertex and index arrays.
+struct Mesh {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+// One placement of a mesh in the scene, it becomes one TLAS instance.
+struct MeshInstance {
+    uint32_t meshIndex;
+    glm::vec3 position;
+    float scale;
+    Material material;
+};
+
+// Per-instance data read by the triangle hit shader through gl_InstanceCustomIndexEXT.
+struct MeshInstanceInfo {
+    alignas(4) uint32_t firstVertex;
+    alignas(4) uint32_t firstIndex;
+    alignas(4) uint32_t reserved[2];
+    alignas(16) Material material;
+};
+
+// All meshes share one vertex and one index array so each device needs a
+// single vertex and index buffer however many meshes are loaded.
+struct MeshScene {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Mesh> meshes;
+    std::vector<std::filesystem::path> meshPaths;
+    std::vector<MeshInstance> instances;
+};
+
+// Loads a Wavefront OBJ or ASCII PLY file and appends it as a new mesh.
+// Polygons are triangulated as fans, missing normals are computed from the faces.
+uint32_t loadMesh(MeshScene& scene, const std::filesystem::path& path);
+
+// Appends a unit icosphere whose 20 faces are split into 4 subdivision times
+// and returns its mesh index. Its vertex normals equal its positions.
+uint32_t addIcosphere(MeshScene& scene, uint32_t subdivision);
+
+// Places a mesh described by "<path>[@x,y,z[,scale]]". A path that was
+// already loaded is instanced again instead of being loaded twice.
+void addMeshInstance(MeshScene& scene, std::string_view spec);
+
+std::vector<MeshInstanceInfo> getMeshInstanceInfos(const MeshScene& scene);
@@ -0,0 +1,465 @@
+#include "offscreen_renderer.h"
+
+#include "vulkan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace offscreen {
+    struct renderer {
+        vk::Instance instance;
+        vk::PhysicalDevice physical_device;
+        vk::PhysicalDeviceMemoryProperties memory_properties;
+        uint32_t queue_family;
+        vk::Device device;
+        vk::Queue queue;
+        vk::CommandPool command_pool;
+        vk::detail::DispatchLoaderDynamic dispatch_loader;
+
+        vk::DescriptorSetLayout descriptor_set_layout;
+        vk::PipelineLayout pipeline_layout;
+        vk::Pipeline pipeline;
+        VulkanBuffer shader_binding_table_buffer;
+        vk::StridedDeviceAddressRegionKHR sbt_ray_gen_region;
+        vk::StridedDeviceAddressRegionKHR sbt_miss_region;
+        vk::StridedDeviceAddressRegionKHR sbt_hit_region;
+        VulkanBuffer render_call_info_buffer;
+        vk::DescriptorPool descriptor_pool;
+        // Written once there is both a scene and a resolution.
+        vk::DescriptorSet descriptor_set;
+
+        // The loaded scene.
+        bool has_scene;
+        VulkanBuffer aabb_buffer;
+        std::vector<VulkanAccelerationStructure> sphere_bottom_accels;
+        std::vector<VulkanAccelerationStructure> mesh_bottom_accels;
+        std::vector<VulkanAccelerationStructure> top_accels;
+        VulkanBuffer sphere_buffer;
+        VulkanBuffer sphere_material_index_buffer;
+        VulkanBuffer material_buffer;
+        VulkanBuffer mesh_vertex_buffer;
+        VulkanBuffer mesh_index_buffer;
+        VulkanBuffer mesh_instance_buffer;
+
+        // The images and buffers of the resolution, none while it is 0 x 0.
+        uint32_t width;
+        uint32_t height;
+        VulkanImage render_target_image;
+        VulkanImage summed_image;
+        VulkanBuffer readback_buffer;
+        VulkanBuffer row_cost_buffer;
+        // Samples summed into every row since the last clear.
+        std::vector<uint32_t> row_sample_counts;
+    };
+
+    namespace {
+        constexpr uint32_t max_samples_per_submission = 16;
+
+        // Every command of the renderer is a submission of its own that is waited for, this barrier
+        // at its start orders it after everything the earlier ones wrote.
+        void record_submission_barrier(vk::CommandBuffer command_buffer) {
+            command_buffer.pipelineBarrier2(
+                vk::DependencyInfo{}
+                .setMemoryBarriers(
+                    vk::MemoryBarrier2{}
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+                    .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite)
+                )
+            );
+        }
+
+        // The descriptor set references both the scene and the images of the resolution,
+        // so it is written again whenever one of them is replaced.
+        void update_descriptor_set(renderer& renderer) {
+            if (!renderer.has_scene || renderer.width == 0) {
+                return;
+            }
+            renderer.device.resetDescriptorPool(renderer.descriptor_pool);
+            renderer.descriptor_set = vulkan::create_descriptor_set(renderer.device, 1,
+                renderer.descriptor_set_layout, renderer.descriptor_pool,
+                std::array{ renderer.render_target_image },
+                std::array{ renderer.top_accels.front() },
+                std::array{ renderer.sphere_buffer },
+                std::array{ renderer.summed_image },
+                std::array{ renderer.render_call_info_buffer },
+                renderer.sphere_material_index_buffer, renderer.material_buffer,
+                renderer.mesh_vertex_buffer, renderer.mesh_index_buffer, renderer.mesh_instance_buffer,
+                std::array{ renderer.row_cost_buffer }).front();
+        }
+
+        void destroy_scene(renderer& renderer) {
+            if (!renderer.has_scene) {
+                return;
+            }
+            auto device = renderer.device;
+            for (auto* accels : { &renderer.top_accels, &renderer.sphere_bottom_accels, &renderer.mesh_bottom_accels }) {
+                std::ranges::for_each(
+                    *accels,
+                    [device, &renderer](auto& accel) {
+                        vulkan::destroy_acceleration_structure(device, accel, renderer.dispatch_loader);
+                    }
+                );
+                accels->clear();
+            }
+            for (auto* buffer : { &renderer.aabb_buffer, &renderer.sphere_buffer, &renderer.sphere_material_index_buffer,
+                &renderer.material_buffer, &renderer.mesh_vertex_buffer, &renderer.mesh_index_buffer, &renderer.mesh_instance_buffer }) {
+                vulkan::destroy_buffer(device, *buffer);
+                *buffer = {};
+            }
+            renderer.has_scene = false;
+        }
+
+        void destroy_resolution(renderer& renderer) {
+            if (renderer.width == 0) {
+                return;
+            }
+            auto device = renderer.device;
+            vulkan::destroy_image(device, renderer.render_target_image);
+            vulkan::destroy_image(device, renderer.summed_image);
+            vulkan::destroy_buffer(device, renderer.readback_buffer);
+            vulkan::destroy_buffer(device, renderer.row_cost_buffer);
+            renderer.render_target_image = {};
+            renderer.summed_image = {};
+            renderer.readback_buffer = {};
+            renderer.row_cost_buffer = {};
+            renderer.width = 0;
+            renderer.height = 0;
+            renderer.row_sample_counts.clear();
+        }
+    }
+
+    renderer* create_renderer(uint32_t gpu_index) {
+        auto renderer = new offscreen::renderer{};
+        try {
+            renderer->instance = vulkan::create_instance(Vulkan::get_required_instance_extensions());
+            auto device_extensions = Vulkan::get_required_headless_device_extensions();
+            auto [physical_devices, physical_device_picks] =
+                vulkan::pick_physical_devices(renderer->instance, device_extensions, UINT32_MAX);
+            if (gpu_index >= physical_devices.size()) {
+                throw std::runtime_error("[Error] no GPU " + std::to_string(gpu_index) + " with ray tracing support, "
+                    + std::to_string(physical_devices.size()) + " found");
+            }
+            renderer->physical_device = physical_devices[gpu_index];
+            renderer->memory_properties = renderer->physical_device.getMemoryProperties();
+            renderer->queue_family = vulkan::find_compute_queue_family(renderer->physical_device);
+
+            auto [device, compute_queue, present_queue, build_queue, trace_queues] = vulkan::create_device(renderer->instance,
+                renderer->physical_device, renderer->queue_family, renderer->queue_family, device_extensions);
+            renderer->device = device;
+            renderer->queue = compute_queue;
+            renderer->command_pool = device.createCommandPool(
+                {
+                        .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                        .queueFamilyIndex = renderer->queue_family
+                });
+            renderer->dispatch_loader = vk::detail::DispatchLoaderDynamic(renderer->instance, vkGetInstanceProcAddr, device);
+
+            vk::PhysicalDeviceRayTracingPipelinePropertiesKHR ray_tracing_properties = {};
+            vk::PhysicalDeviceProperties2 properties2 = {
+                    .pNext = &ray_tracing_properties
+            };
+            renderer->physical_device.getProperties2(&properties2);
+
+            renderer->descriptor_set_layout = vulkan::create_descriptor_set_layout(device);
+            renderer->pipeline_layout = vulkan::create_pipeline_layout(device, renderer->descriptor_set_layout);
+            renderer->pipeline = vulkan::create_rt_pipeline(device, ray_tracing_properties.maxRayRecursionDepth,
+                renderer->pipeline_layout, renderer->dispatch_loader);
+            auto [sbt_buffer, ray_gen_region, miss_region, hit_region] = vulkan::create_shader_binding_table_buffer(device,
+                renderer->pipeline, ray_tracing_properties, renderer->memory_properties, renderer->dispatch_loader);
+            renderer->shader_binding_table_buffer = sbt_buffer;
+            renderer->sbt_ray_gen_region = ray_gen_region;
+            renderer->sbt_miss_region = miss_region;
+            renderer->sbt_hit_region = hit_region;
+
+            renderer->render_call_info_buffer = vulkan::create_render_call_info_buffers(device, 1, renderer->memory_properties).front();
+            renderer->descriptor_pool = vulkan::create_descriptor_pool(device, 1);
+        }
+        catch (...) {
+            destroy_renderer(renderer);
+            throw;
+        }
+        return renderer;
+    }
+
+    void destroy_renderer(renderer* renderer) {
+        if (renderer == nullptr) {
+            return;
+        }
+        if (auto device = renderer->device) {
+            device.waitIdle();
+            destroy_scene(*renderer);
+            destroy_resolution(*renderer);
+            device.destroyDescriptorPool(renderer->descriptor_pool);
+            vulkan::destroy_buffer(device, renderer->render_call_info_buffer);
+            vulkan::destroy_buffer(device, renderer->shader_binding_table_buffer);
+            device.destroyPipeline(renderer->pipeline);
+            device.destroyPipelineLayout(renderer->pipeline_layout);
+            device.destroyDescriptorSetLayout(renderer->descriptor_set_layout);
+            device.destroyCommandPool(renderer->command_pool);
+            device.destroy();
+        }
+        if (renderer->instance) {
+            renderer->instance.destroy();
+        }
+        delete renderer;
+    }
+
+    void load_scene(renderer& renderer, const Scene& scene, const MeshScene& mesh_scene,
+        SphereMode sphere_mode, uint32_t icosphere_mesh_index, float time) {
+        destroy_scene(renderer);
+        // The scene owns whatever was created so far, so destroy_scene frees it when a step below throws.
+        renderer.has_scene = true;
+        try {
+            auto device = renderer.device;
+            auto& memory_properties = renderer.memory_properties;
+
+            auto spheres = std::vector<Sphere>(scene.spheres.begin(), scene.spheres.end());
+            for (auto& animation : scene.animations) {
+                spheres[animation.sphereIndex].geometry = evaluateSphereAnimation(animation, time);
+            }
+            auto sphere_amount = static_cast<uint32_t>(spheres.size());
+
+            renderer.sphere_buffer = vulkan::create_sphere_buffer(device, std::max(sphere_amount, 1u), memory_properties);
+            void* sphere_data = device.mapMemory(renderer.sphere_buffer.memory, 0, sizeof(Sphere) * sphere_amount);
+            memcpy(sphere_data, spheres.data(), sizeof(Sphere) * sphere_amount);
+            device.unmapMemory(renderer.sphere_buffer.memory);
+
+            auto [sphere_material_index_buffer, material_buffer] = vulkan::create_material_buffers(device,
+                scene.sphereMaterialIndices, scene.materials, memory_properties);
+            renderer.sphere_material_index_buffer = sphere_material_index_buffer;
+            renderer.material_buffer = material_buffer;
+
+            // The scene does not move until it is loaded again, so every BLAS is built once and compacted.
+            vk::AccelerationStructureGeometryKHR aabbs_geometry = {
+                    .geometryType = vk::GeometryTypeKHR::eAabbs,
+                    .flags = vk::GeometryFlagBitsKHR::eOpaque
+            };
+            if (sphere_mode == SphereMode::Aabb) {
+                std::vector<vk::AabbPositionsKHR> aabbs(sphere_amount);
+                std::ranges::transform(
+                    spheres,
+                    aabbs.begin(),
+                    [](auto& sphere) {
+                        auto& geometry = sphere.geometry;
+                        return vk::AabbPositionsKHR{
+                                .minX = geometry.x - geometry.w,
+                                .minY = geometry.y - geometry.w,
+                                .minZ = geometry.z - geometry.w,
+                                .maxX = geometry.x + geometry.w,
+                                .maxY = geometry.y + geometry.w,
+                                .maxZ = geometry.z + geometry.w
+                        };
+                    }
+                );
+                renderer.aabb_buffer = vulkan::create_aabb_buffer(device, sphere_amount, memory_properties);
+                void* aabb_data = device.mapMemory(renderer.aabb_buffer.memory, 0, sizeof(vk::AabbPositionsKHR) * sphere_amount);
+                memcpy(aabb_data, aabbs.data(), sizeof(vk::AabbPositionsKHR) * sphere_amount);
+                device.unmapMemory(renderer.aabb_buffer.memory);
+
+                auto [sphere_bottom_accel, build_info] = vulkan::createBottomAccelerationStructure(device, renderer.aabb_buffer, sphere_amount,
+                    aabbs_geometry, memory_properties, renderer.dispatch_loader,
+                    vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace | vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction);
+                renderer.sphere_bottom_accels = { sphere_bottom_accel };
+                vulkan::build_static_accels(device, renderer.queue, renderer.command_pool, renderer.sphere_bottom_accels,
+                    { build_info }, { vk::AccelerationStructureBuildRangeInfoKHR{ .primitiveCount = sphere_amount } }, renderer.dispatch_loader);
+                vulkan::compact_bottom_accels(device, renderer.queue, renderer.command_pool, renderer.sphere_bottom_accels,
+                    memory_properties, renderer.dispatch_loader);
+            }
+
+            auto [mesh_vertex_buffer, mesh_index_buffer, mesh_instance_buffer] = vulkan::create_mesh_buffers(device, mesh_scene, memory_properties);
+            renderer.mesh_vertex_buffer = mesh_vertex_buffer;
+            renderer.mesh_index_buffer = mesh_index_buffer;
+            renderer.mesh_instance_buffer = mesh_instance_buffer;
+            renderer.mesh_bottom_accels = vulkan::create_mesh_bottom_accels(device, renderer.queue, renderer.command_pool,
+                mesh_vertex_buffer, mesh_index_buffer, mesh_scene, memory_properties, renderer.dispatch_loader);
+            vulkan::compact_bottom_accels(device, renderer.queue, renderer.command_pool, renderer.mesh_bottom_accels,
+                memory_properties, renderer.dispatch_loader);
+
+            auto instances = vulkan::get_top_accel_instances(device, sphere_mode,
+                renderer.sphere_bottom_accels.empty() ? vk::AccelerationStructureKHR{} : renderer.sphere_bottom_accels.front().accelerationStructure,
+                spheres, icosphere_mesh_index, renderer.mesh_bottom_accels, mesh_scene, renderer.dispatch_loader);
+            vk::AccelerationStructureGeometryKHR instances_geometry = {
+                    .geometryType = vk::GeometryTypeKHR::eInstances,
+                    .flags = vk::GeometryFlagBitsKHR::eOpaque
+            };
+            auto [top_accel, top_build_info] = vulkan::createTopAccelerationStructure(device, instances, instances_geometry,
+                memory_properties, renderer.dispatch_loader);
+            renderer.top_accels = { top_accel };
+            vulkan::build_static_accels(device, renderer.queue, renderer.command_pool, renderer.top_accels,
+                { top_build_info }, { vk::AccelerationStructureBuildRangeInfoKHR{ .primitiveCount = static_cast<uint32_t>(instances.size()) } },
+                renderer.dispatch_loader);
+
+            update_descriptor_set(renderer);
+        }
+        catch (...) {
+            destroy_scene(renderer);
+            throw;
+        }
+    }
+
+    void set_resolution(renderer& renderer, uint32_t width, uint32_t height) {
+        if (width == renderer.width && height == renderer.height) {
+            return;
+        }
+        if (width == 0 || height == 0) {
+            throw std::runtime_error("[Error] resolution without pixels");
+        }
+        destroy_resolution(renderer);
+        auto device = renderer.device;
+        auto extent = vk::Extent3D{ width, height, 1 };
+        renderer.render_target_image = vulkan::create_image(device, extent, vk::Format::eR8G8B8A8Unorm,
+            vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc, renderer.memory_properties);
+        renderer.summed_image = vulkan::create_image(device, extent, vk::Format::eR32G32B32A32Sfloat,
+            vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc,
+            renderer.memory_properties);
+        renderer.readback_buffer = vulkan::create_readback_buffers(device, 1, width, height, sizeof(glm::vec4), renderer.memory_properties).front();
+        renderer.row_cost_buffer = vulkan::create_row_cost_buffers(device, 1, height, renderer.memory_properties).front();
+        renderer.width = width;
+        renderer.height = height;
+        renderer.row_sample_counts.assign(height, 0);
+
+        // Both images stay in the general layout from here on.
+        vulkan::execute_single_time_command(device, renderer.queue, renderer.command_pool,
+            [&renderer](const vk::CommandBuffer& command_buffer) {
+                auto image_barriers = std::array<vk::ImageMemoryBarrier2, 2>{};
+                std::ranges::transform(
+                    std::array{ renderer.render_target_image.image, renderer.summed_image.image },
+                    image_barriers.begin(),
+                    [](vk::Image image) {
+                        return vk::ImageMemoryBarrier2{}
+                            .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+                            .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite)
+                            .setOldLayout(vk::ImageLayout::eUndefined)
+                            .setNewLayout(vk::ImageLayout::eGeneral)
+                            .setImage(image)
+                            .setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+                    }
+                );
+                command_buffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(image_barriers));
+            });
+        clear_samples(renderer);
+        update_descriptor_set(renderer);
+    }
+
+    void clear_samples(renderer& renderer) {
+        if (renderer.width == 0) {
+            return;
+        }
+        vulkan::execute_single_time_command(renderer.device, renderer.queue, renderer.command_pool,
+            [&renderer](const vk::CommandBuffer& command_buffer) {
+                record_submission_barrier(command_buffer);
+                command_buffer.clearColorImage(renderer.summed_image.image, vk::ImageLayout::eGeneral,
+                    vk::ClearColorValue{ std::array{ 0.0f, 0.0f, 0.0f, 0.0f } },
+                    vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+            });
+        std::ranges::fill(renderer.row_sample_counts, 0);
+    }
+
+    void render(renderer& renderer, const camera& camera, uint32_t first_sample, uint32_t sample_count,
+        uint32_t first_row, uint32_t row_count) {
+        if (!renderer.has_scene || renderer.width == 0) {
+            throw std::runtime_error("[Error] render needs a scene and a resolution");
+        }
+        if (row_count == 0 || first_row >= renderer.height || row_count > renderer.height - first_row) {
+            throw std::runtime_error("[Error] rendered rows outside of the image");
+        }
+        if (sample_count == 0) {
+            throw std::runtime_error("[Error] render without samples");
+        }
+        auto device = renderer.device;
+
+        // The samples are traced in submissions of a bounded length, so many samples do not run into
+        // the driver timeout, and the rows are copied back after the last one.
+        for (uint32_t sample = 0; sample < sample_count; sample += max_samples_per_submission) {
+            auto submission_sample_count = std::min(max_samples_per_submission, sample_count - sample);
+            auto is_last_submission = sample + submission_sample_count == sample_count;
+            RenderCallInfo render_call_info = {
+                    .number = first_sample + sample,
+                    .samplesPerRenderCall = submission_sample_count,
+                    .offset = glm::uvec2(0),
+                    .image_size = glm::uvec2(renderer.width, renderer.height),
+                    .time = 0.0f,
+                    .record_row_cost = 0,
+                    .camera_pos = glm::vec4(camera.position, 0.0f),
+                    .camera_dir = glm::vec4(camera.direction, 0.0f)
+            };
+            void* render_call_info_data = device.mapMemory(renderer.render_call_info_buffer.memory, 0, sizeof(RenderCallInfo));
+            memcpy(render_call_info_data, &render_call_info, sizeof(RenderCallInfo));
+            device.unmapMemory(renderer.render_call_info_buffer.memory);
+
+            // The rows are traced where they lie in the image and only they are copied back.
+            vulkan::execute_single_time_command(device, renderer.queue, renderer.command_pool,
+                [&renderer, first_row, row_count, is_last_submission](const vk::CommandBuffer& command_buffer) {
+                    record_submission_barrier(command_buffer);
+                    vulkan::record_trace_rays(command_buffer, renderer.pipeline, renderer.descriptor_set, renderer.pipeline_layout,
+                        renderer.sbt_ray_gen_region, renderer.sbt_miss_region, renderer.sbt_hit_region,
+                        glm::uvec2(0, first_row), renderer.width, row_count, renderer.dispatch_loader);
+                    if (!is_last_submission) {
+                        return;
+                    }
+                    command_buffer.pipelineBarrier2(
+                        vk::DependencyInfo{}
+                        .setMemoryBarriers(
+                            vk::MemoryBarrier2{}
+                            .setSrcStageMask(vk::PipelineStageFlagBits2::eRayTracingShaderKHR)
+                            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+                            .setDstStageMask(vk::PipelineStageFlagBits2::eCopy)
+                            .setDstAccessMask(vk::AccessFlagBits2::eTransferRead)
+                        )
+                    );
+                    command_buffer.copyImageToBuffer(renderer.summed_image.image, vk::ImageLayout::eGeneral, renderer.readback_buffer.buffer,
+                        vk::BufferImageCopy{
+                                .bufferOffset = vk::DeviceSize{ first_row } * renderer.width * sizeof(glm::vec4),
+                                .imageSubresource = { vk::ImageAspectFlagBits::eColor, 0, 0, 1 },
+                                .imageOffset = { 0, static_cast<int32_t>(first_row), 0 },
+                                .imageExtent = { renderer.width, row_count, 1 }
+                        });
+                    command_buffer.pipelineBarrier2(
+                        vk::DependencyInfo{}
+                        .setMemoryBarriers(
+                            vk::MemoryBarrier2{}
+                            .setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+                            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+                            .setDstStageMask(vk::PipelineStageFlagBits2::eHost)
+                            .setDstAccessMask(vk::AccessFlagBits2::eHostRead)
+                        )
+                    );
+                });
+        }
+        for (auto row = first_row; row < first_row + row_count; row++) {
+            renderer.row_sample_counts[row] += sample_count;
+        }
+    }
+
+    void read_image(renderer& renderer, uint32_t first_row, uint32_t row_count, uint8_t* rgba) {
+        if (first_row >= renderer.height || row_count > renderer.height - first_row) {
+            throw std::runtime_error("[Error] read rows outside of the image");
+        }
+        auto row_texels = size_t{ renderer.width } * 4;
+        auto offset = vk::DeviceSize{ first_row } * row_texels * sizeof(float);
+        auto size = vk::DeviceSize{ row_count } * row_texels * sizeof(float);
+        auto sample_sums = static_cast<const float*>(renderer.device.mapMemory(renderer.readback_buffer.memory, offset, size));
+        for (uint32_t row = 0; row < row_count; row++) {
+            auto sample_count = static_cast<float>(std::max(renderer.row_sample_counts[first_row + row], 1u));
+            for (size_t texel = row * row_texels; texel < (row + 1) * row_texels; texel++) {
+                rgba[texel] = texel % 4 == 3
+                    ? 255
+                    : static_cast<uint8_t>(std::lround(std::clamp(std::sqrt(sample_sums[texel] / sample_count), 0.0f, 1.0f) * 255));
+            }
+        }
+        renderer.device.unmapMemory(renderer.readback_buffer.memory);
+    }
+
+    uint32_t get_width(const renderer& renderer) {
+        return renderer.width;
+    }
+
+    uint32_t get_height(const renderer& renderer) {
+        return renderer.height;
+    }
+}
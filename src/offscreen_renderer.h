@@ -0,0 +1,46 @@
+#pragma once
+
+#include "scene.h"
+#include "mesh.h"
+#include "vulkan_settings.h"
+
+#include <cstdint>
+
+namespace offscreen {
+    // One GPU with its ray tracing pipeline, kept for the whole life of the renderer, so a render
+    // costs neither device bring-up nor pipeline compilation. Nothing is presented: the samples are
+    // summed in an image of the current resolution and read back by the host.
+    struct renderer;
+
+    struct camera {
+        glm::vec3 position;
+        glm::vec3 direction;
+    };
+
+    // Brings up GPU gpu_index of the GPUs with ray tracing support, in the order of the GPU pick.
+    renderer* create_renderer(uint32_t gpu_index);
+    void destroy_renderer(renderer* renderer);
+
+    // Uploads the scene with its animations evaluated at time and builds its acceleration structures,
+    // replacing the scene loaded before. The scene is static until it is loaded again.
+    void load_scene(renderer& renderer, const Scene& scene, const MeshScene& mesh_scene,
+        SphereMode sphere_mode, uint32_t icosphere_mesh_index, float time);
+
+    // Reallocates the images and buffers of the resolution, only when it differs from the current one.
+    void set_resolution(renderer& renderer, uint32_t width, uint32_t height);
+
+    // Zeroes the summed samples.
+    void clear_samples(renderer& renderer);
+
+    // Adds sample_count samples per pixel, with sample indices from first_sample on, to the sums of
+    // row_count rows from first_row on, and reads the sums of those rows back.
+    void render(renderer& renderer, const camera& camera, uint32_t first_sample, uint32_t sample_count,
+        uint32_t first_row, uint32_t row_count);
+
+    // Writes row_count rows from first_row on as RGBA8 with the tone mapping of the ray generation
+    // shader, sqrt of the mean of the samples summed since the last clear.
+    void read_image(renderer& renderer, uint32_t first_row, uint32_t row_count, uint8_t* rgba);
+
+    uint32_t get_width(const renderer& renderer);
+    uint32_t get_height(const renderer& renderer);
+}
@@ -7,11 +7,22 @@
 #include "vulkan.h"
 
 #include "workload_tuner.hpp"
+#include "workload_cache.hpp"
+#include "device_worker.hpp"
+#include "startup_timeline.hpp"
 
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <execution>
+#include <future>
+#include <numeric>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
 
 template<typename Container, typename T>
 struct container {
@@ -39,13 +50,75 @@ constexpr auto same_size_container(const auto& c) {
     return container<std::remove_cvref_t<decltype(c)>, T>::init_with_size(c.size());
 }
 
+// A static scene has one copy of its scene buffers and acceleration structures
+// shared by every frame slot, an animated one has a copy per frame slot.
+uint32_t get_scene_copy_index(uint32_t frame_slot, uint32_t scene_copy_count) {
+    return frame_slot % scene_copy_count;
+}
+
+// Per frame slot view of the copies of a scene resource.
+template<typename T>
+auto get_per_frame_slot(const std::vector<T>& copies, uint32_t frame_slot_count) {
+    auto per_frame_slot = std::vector<T>(frame_slot_count);
+    for (uint32_t frame_slot = 0; frame_slot < frame_slot_count; frame_slot++) {
+        per_frame_slot[frame_slot] = copies[get_scene_copy_index(frame_slot, static_cast<uint32_t>(copies.size()))];
+    }
+    return per_frame_slot;
+}
+
+// Everything the balance between the devices depends on besides the devices and the resolution.
+// Material padding is skipped, a generated scene leaves it uninitialized.
+uint64_t fingerprint_scene(const Scene& scene, const MeshScene& mesh_scene, SphereMode sphere_mode) {
+    auto hash = tune::fingerprint(tune::fingerprint_basis, sphere_mode);
+    hash = tune::fingerprint(hash, std::span<const Sphere>{ scene.spheres });
+    hash = tune::fingerprint(hash, std::span<const uint32_t>{ scene.sphereMaterialIndices });
+    for (auto& material : scene.materials) {
+        hash = tune::fingerprint(hash, material.materialType);
+        hash = tune::fingerprint(hash, material.textureType);
+        hash = tune::fingerprint(hash, std::span<const glm::vec4>{ material.colors });
+        hash = tune::fingerprint(hash, material.materialSpecificAttribute);
+    }
+    hash = tune::fingerprint(hash, scene.animations.size());
+    hash = tune::fingerprint(hash, std::span<const MeshVertex>{ mesh_scene.vertices });
+    hash = tune::fingerprint(hash, std::span<const uint32_t>{ mesh_scene.indices });
+    for (auto& instance : mesh_scene.instances) {
+        hash = tune::fingerprint(hash, instance.meshIndex);
+        hash = tune::fingerprint(hash, instance.position);
+        hash = tune::fingerprint(hash, instance.scale);
+        hash = tune::fingerprint(hash, instance.material.materialType);
+    }
+    return hash;
+}
+
+// One frame of one device, pushed by the main thread to the worker of the device.
+struct frame_job {
+    uint64_t frame_value;
+    float animation_time;
+    // Next tile of the frame to take in tile mode, shared by the workers of all devices.
+    std::atomic<uint32_t>* next_tile;
+};
+
 void ray_trace_with_physical_devices(
     uint32_t samples,
+    bool store_render_result,
     uint32_t width,
     uint32_t height,
     window::window_system& window_system,
     vk::Instance instance,
-    const auto& physical_devices
+    const auto& physical_devices,
+    Scene& scene,
+    const MeshScene& mesh_scene,
+    SphereMode sphere_mode,
+    uint32_t icosphere_mesh_index,
+    uint32_t max_frames,
+    bool host_blas_builds,
+    uint32_t frames_in_flight,
+    uint32_t tile_count,
+    uint32_t queue_count,
+    bool sample_split,
+    bool cost_map,
+    const char* workload_cache_path,
+    uint64_t scene_fingerprint
 ) {
     auto physical_device_indices = same_size_container<uint32_t>(physical_devices);
     std::ranges::iota(physical_device_indices, 0);
@@ -71,38 +144,115 @@ void ray_trace_with_physical_devices(
     );
     auto view_window = physical_devices_window[test_physical_device_index];
 
+    // Tile mode cuts the image into tile_count tiles of whole rows instead of one strip per device,
+    // every device renders to a whole image and the devices take the tiles of a frame as they go.
+    auto tile_height = tile_count > 0 ? (height + tile_count - 1) / tile_count : 0;
+    if (tile_count > 0) {
+        tile_count = (height + tile_height - 1) / tile_height;
+        std::cout << "tiles: " << tile_count << " tiles of " << tile_height << " rows" << std::endl;
+    }
+    // Sample split mode has every device trace the whole image with its share of the samples instead.
+    // Only in the default strip mode does a device render some rows of the image and present them.
+    auto strip_mode = tile_count == 0 && !sample_split;
+
     auto physical_devices_render_extent = same_size_container<glm::u32vec2>(physical_devices);
     std::ranges::generate(
         physical_devices_render_extent,
-        [width, height, physical_device_count = physical_devices.size()]() {
+        [width, height, physical_device_count = strip_mode ? physical_devices.size() : 1]() {
             return glm::u32vec2{ width, height / physical_device_count };
         }
     );
-    physical_devices_render_extent[0].y += height - physical_devices.size() * (height / physical_devices.size());
+    if (strip_mode) {
+        physical_devices_render_extent[0].y += height - physical_devices.size() * (height / physical_devices.size());
+    }
+
+    // Samples of each device per frame in sample split mode, the remainder on the first device like the rows of the strips.
+    auto physical_devices_samples = same_size_container<uint32_t>(physical_devices);
+    if (sample_split) {
+        if (samples < physical_devices.size()) {
+            throw std::runtime_error("[Error] sample split needs at least one sample per GPU");
+        }
+        std::ranges::fill(physical_devices_samples, samples / physical_devices.size());
+        physical_devices_samples[0] += samples - physical_devices.size() * (samples / physical_devices.size());
+    }
 
+    // The tuner splits the rows of the strips, or the samples in sample split mode.
     tune::tuning_info tuning_info{};
-    tune::init_tuning_info(tuning_info, height, physical_devices.size());
+    tune::init_tuning_info(tuning_info, sample_split ? samples : height, physical_devices.size());
+    // The strips are split by the rays traced per row instead of by row count, tiles and samples need no cost map.
+    auto record_row_cost = cost_map && strip_mode;
+
+    // A distribution learned by an earlier run on the same devices, resolution and scene is balanced from the first frame.
+    auto physical_devices_identity = same_size_container<std::string>(physical_devices);
+    std::ranges::transform(
+        physical_devices,
+        physical_devices_identity.begin(),
+        [](auto physical_device) {
+            return vulkan::get_device_identity(physical_device);
+        }
+    );
+    auto use_workload_cache = workload_cache_path != nullptr && strip_mode && physical_devices.size() > 1;
+    auto workload_cache_key = tune::get_workload_cache_key(physical_devices_identity, width, height, scene_fingerprint);
+    if (use_workload_cache) {
+        if (auto cached = tune::load_cached_workload(workload_cache_path, workload_cache_key);
+            cached && tune::seed_tuning_info(tuning_info, cached.value())) {
+            std::ranges::transform(
+                cached.value().workload_distribution,
+                physical_devices_render_extent.begin(),
+                [width](auto rows) {
+                    return glm::u32vec2{ width, rows };
+                }
+            );
+            std::cout << "workload_cache: loaded from " << workload_cache_path << std::endl;
+        }
+    }
 
     uint32_t benchmark_frame_count = 100;
 
-    while (!window::should_window_close(view_window)) {
+    auto animation_start_time = std::chrono::steady_clock::now();
+
+    // The strips of all devices composited into one RGBA image on the host.
+    auto composite_image = std::vector<uint8_t>(size_t{ width } * height * 4);
+    // In sample split mode the summed images of all devices added up, and how many samples they hold.
+    auto sample_sums = std::vector<float>(sample_split ? size_t{ width } * height * 4 : 0);
+    uint32_t sample_sum_count = 0;
+
+    uint32_t rendered_frame_count = 0;
+    auto should_stop = [&view_window, &rendered_frame_count, max_frames]() {
+        return window::should_window_close(view_window) || (max_frames > 0 && rendered_frame_count >= max_frames);
+    };
+
+    while (!should_stop()) {
+        // The expensive bring-up stages run on one thread per device, each device
+        // records its stages so the time to its first frame can be broken down.
+        auto physical_devices_startup_timeline = same_size_container<startup::timeline>(physical_devices);
+        std::ranges::for_each(
+            physical_devices_startup_timeline,
+            [begin = startup::clock::now()](auto& timeline) {
+                startup::init_timeline(timeline, begin);
+            }
+        );
+
         auto physical_devices_render_offset = same_size_container<glm::u32vec2>(physical_devices);
         physical_devices_render_offset[0] = { 0, 0 };
-        for (int i = 1; i < physical_devices.size(); i++) {
+        for (int i = 1; i < physical_devices.size() && strip_mode; i++) {
             physical_devices_render_offset[i] = { 0, physical_devices_render_offset[i - 1].y + physical_devices_render_extent[i - 1].y };
 
         }
 
-        std::ranges::for_each(
-            physical_device_indices,
-            [&physical_devices_window, &physical_devices_render_offset, &physical_devices_render_extent](auto i) {
-                auto& window = physical_devices_window[i];
-                auto& offset = physical_devices_render_offset[i];
-                auto& extent = physical_devices_render_extent[i];
-                window::set_window_position(window, std::pair{ offset.x,offset.y });
-                window::set_window_size(window, std::pair{ extent.x, extent.y });
-            }
-        );
+        // Nothing is presented in tile and sample split mode, the windows keep their initial size.
+        if (strip_mode) {
+            std::ranges::for_each(
+                physical_device_indices,
+                [&physical_devices_window, &physical_devices_render_offset, &physical_devices_render_extent](auto i) {
+                    auto& window = physical_devices_window[i];
+                    auto& offset = physical_devices_render_offset[i];
+                    auto& extent = physical_devices_render_extent[i];
+                    window::set_window_position(window, std::pair{ offset.x,offset.y });
+                    window::set_window_size(window, std::pair{ extent.x, extent.y });
+                }
+            );
+        }
 
         auto physical_devices_surface = same_size_container<vk::SurfaceKHR>(physical_devices);
         std::ranges::transform(
@@ -119,24 +269,60 @@ void ray_trace_with_physical_devices(
             physical_device_indices,
             [&compute_queue_families, &present_queue_families, &physical_devices, &physical_devices_surface](auto i) {
                 auto [compute_queue_family, present_queue_family] = vulkan::find_queue_family(physical_devices[i], physical_devices_surface[i]);
+                compute_queue_families[i] = compute_queue_family;
+                present_queue_families[i] = present_queue_family;
             }
         );
 
 
+        // Static BLASes are built on the CPU cores when requested and the device can build on the host.
+        auto physical_devices_host_blas_builds = same_size_container<bool>(physical_devices);
+        std::ranges::transform(
+            physical_devices,
+            physical_devices_host_blas_builds.begin(),
+            [host_blas_builds](auto physical_device) {
+                return host_blas_builds && vulkan::supports_acceleration_structure_host_commands(physical_device);
+            }
+        );
+        std::ranges::for_each(
+            physical_device_indices,
+            [&physical_devices_host_blas_builds](auto i) {
+                std::cout << "host_blas_builds[" << i << "]: " << physical_devices_host_blas_builds[i] << std::endl;
+            }
+        );
+
         auto devices = same_size_container<vk::Device>(physical_devices);
         auto physical_devices_compute_queue = same_size_container<vk::Queue>(physical_devices);
         auto physical_devices_present_queue = same_size_container<vk::Queue>(physical_devices);
-
-        std::ranges::for_each(
-            physical_device_indices,
-            [&devices, &physical_devices_compute_queue, &physical_devices_present_queue, instance, &physical_devices, &compute_queue_families, &present_queue_families](auto i) {
-                auto [device, compute_queue, present_queue] = vulkan::create_device(instance, physical_devices[i], compute_queue_families[i], present_queue_families[i],
-                    Vulkan::get_required_device_extensions());
+        auto physical_devices_build_queue = same_size_container<vk::Queue>(physical_devices);
+        // In tile mode the tiles are spread over these queues of the compute family, the first one is the compute queue.
+        auto physical_devices_tile_queues = same_size_container<std::vector<vk::Queue>>(physical_devices);
+
+        std::for_each(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
+            [&devices, &physical_devices_compute_queue, &physical_devices_present_queue, &physical_devices_build_queue, &physical_devices_tile_queues,
+            instance, &physical_devices, &compute_queue_families, &present_queue_families, &physical_devices_host_blas_builds,
+            trace_queue_count = tile_count > 0 ? queue_count : 1,
+            &physical_devices_startup_timeline](auto i) {
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "device" };
+                auto [device, compute_queue, present_queue, build_queue, tile_queues] = vulkan::create_device(instance, physical_devices[i], compute_queue_families[i], present_queue_families[i],
+                    Vulkan::get_required_device_extensions(), physical_devices_host_blas_builds[i], trace_queue_count);
                 devices[i] = device;
                 physical_devices_compute_queue[i] = compute_queue;
                 physical_devices_present_queue[i] = present_queue;
+                physical_devices_build_queue[i] = build_queue;
+                physical_devices_tile_queues[i] = tile_queues;
             }
         );
+        if (tile_count > 0) {
+            std::ranges::for_each(
+                physical_device_indices,
+                [&physical_devices_tile_queues](auto i) {
+                    std::cout << "tile_queues[" << i << "]: " << physical_devices_tile_queues[i].size() << std::endl;
+                }
+            );
+        }
 
 
 
@@ -183,9 +369,11 @@ void ray_trace_with_physical_devices(
         std::ranges::transform(
             physical_device_indices,
             physical_devices_swapchain.begin(),
-            [&physical_devices, &physical_devices_surface, &devices, image_count, format, color_space, present_mode, &physical_devices_swapchain_extent, surface_transform](auto i) {
+            [&physical_devices, &physical_devices_surface, &devices, image_count, format, color_space, present_mode, &physical_devices_swapchain_extent, surface_transform,
+            &compute_queue_families, &present_queue_families](auto i) {
                 return vulkan::create_swapchain(physical_devices[i], physical_devices_surface[i], devices[i],
-                    image_count, format, color_space, present_mode, physical_devices_swapchain_extent[i], surface_transform);
+                    image_count, format, color_space, present_mode, physical_devices_swapchain_extent[i], surface_transform,
+                    compute_queue_families[i], present_queue_families[i]);
             }
         );
 
@@ -233,28 +421,38 @@ void ray_trace_with_physical_devices(
             }
         );
 
-        auto physical_devices_render_image_count = physical_devices_swapchain_image_count;
-        auto physical_devices_render_image_indices = same_size_container<std::vector<uint32_t>>(physical_devices);
+        // Per-frame resources belong to a frame slot instead of a swapchain image, so the number of
+        // frames in flight trades latency (fewer) against throughput (more) whatever the image count.
+        auto physical_devices_frame_slot_count = same_size_container<uint32_t>(physical_devices);
         std::ranges::transform(
-            physical_devices_render_image_count,
-            physical_devices_render_image_indices.begin(),
-            [](auto render_image_count) {
-                auto render_image_indices = std::vector<uint32_t>(render_image_count);
-                std::ranges::iota(render_image_indices, 0);
-                return render_image_indices;
+            physical_devices_swapchain_image_count,
+            physical_devices_frame_slot_count.begin(),
+            [frames_in_flight](auto swapchain_image_count) {
+                return frames_in_flight > 0 ? frames_in_flight : swapchain_image_count;
+            }
+        );
+        std::ranges::for_each(
+            physical_device_indices,
+            [&physical_devices_frame_slot_count](auto i) {
+                std::cout << "frames_in_flight[" << i << "]: " << physical_devices_frame_slot_count[i] << std::endl;
             }
         );
 
         auto physical_devices_render_target_images = same_size_container<std::vector<VulkanImage>>(devices);
         auto physical_devices_summed_images = same_size_container<std::vector<VulkanImage>>(devices);
 
-        std::ranges::for_each(
-            physical_device_indices,
-            [&physical_devices_render_target_images, &physical_devices_summed_images, physical_devices_render_image_count, physical_devices_swapchain_extent, &devices, &physical_devices_memory_properties](auto i) {
-                auto render_target_images = std::vector<VulkanImage>(physical_devices_render_image_count[i]);
-                auto summed_images = std::vector<VulkanImage>(physical_devices_render_image_count[i]);
+        std::for_each(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
+            [&physical_devices_render_target_images, &physical_devices_summed_images, &physical_devices_frame_slot_count, &physical_devices_swapchain_extent, &devices, &physical_devices_memory_properties,
+            &physical_devices_startup_timeline, strip_mode, width, height](auto i) {
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "render targets" };
+                auto render_target_images = std::vector<VulkanImage>(physical_devices_frame_slot_count[i]);
+                auto summed_images = std::vector<VulkanImage>(physical_devices_frame_slot_count[i]);
                 {
-                    auto extent = vk::Extent3D{ physical_devices_swapchain_extent[i].width, physical_devices_swapchain_extent[i].height, 1 };
+                    auto extent = strip_mode
+                        ? vk::Extent3D{ physical_devices_swapchain_extent[i].width, physical_devices_swapchain_extent[i].height, 1 }
+                        : vk::Extent3D{ width, height, 1 };
                     std::ranges::generate(
                         render_target_images,
                         [device = devices[i], extent, &memory_properties = physical_devices_memory_properties[i]]() {
@@ -267,7 +465,8 @@ void ray_trace_with_physical_devices(
                         summed_images,
                         [device = devices[i], extent, &memory_properties = physical_devices_memory_properties[i]]() {
                             return vulkan::create_image(
-                                device, extent, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst, memory_properties
+                                device, extent, vk::Format::eR32G32B32A32Sfloat,
+                                vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc, memory_properties
                             );
                         }
                     );
@@ -278,50 +477,118 @@ void ray_trace_with_physical_devices(
         auto render_target_images = physical_devices_render_target_images[test_physical_device_index];
         auto summed_images = physical_devices_summed_images[test_physical_device_index];
 
-        auto physical_devices_fences = same_size_container<std::vector<vk::Fence>>(physical_devices);
+        // The trace of frame n signals n, a frame slot is reused once the frame that last used it is done.
+        auto physical_devices_frame_timeline_semaphore = same_size_container<vk::Semaphore>(physical_devices);
+        std::ranges::transform(
+            devices,
+            physical_devices_frame_timeline_semaphore.begin(),
+            [](auto device) {
+                return vulkan::create_timeline_semaphore(device);
+            }
+        );
+
+        // Each tile submitted to a tile queue signals the next value of the queue's semaphore, so in tile
+        // mode a device waits for its own queued tiles before taking another one.
+        auto physical_devices_tile_timeline_semaphores = same_size_container<std::vector<vk::Semaphore>>(physical_devices);
         std::ranges::transform(
             physical_device_indices,
-            physical_devices_fences.begin(),
-            [&physical_devices_render_image_count, &devices](auto i) {
-                auto fences = vulkan::create_fences(devices[i], physical_devices_render_image_count[i]);
-                return fences;
+            physical_devices_tile_timeline_semaphores.begin(),
+            [&devices, &physical_devices_tile_queues](auto i) {
+                auto semaphores = std::vector<vk::Semaphore>(physical_devices_tile_queues[i].size());
+                std::ranges::generate(semaphores, [device = devices[i]]() { return vulkan::create_timeline_semaphore(device); });
+                return semaphores;
+            }
+        );
+        // The start of frame n in tile mode signals n, the tiles on the other tile queues wait for it.
+        auto physical_devices_tile_start_semaphore = same_size_container<vk::Semaphore>(physical_devices);
+        std::ranges::transform(
+            devices,
+            physical_devices_tile_start_semaphore.begin(),
+            [](auto device) {
+                return vulkan::create_timeline_semaphore(device);
             }
         );
 
-        auto physical_devices_next_image_semaphores = same_size_container<std::vector<vk::Semaphore>>(physical_devices);
+        auto physical_devices_acquire_image_semaphores = same_size_container<std::vector<vk::Semaphore>>(physical_devices);
         std::ranges::transform(
             physical_device_indices,
-            physical_devices_next_image_semaphores.begin(),
-            [&physical_devices_render_image_count, &devices](auto i) {
-                auto next_image_semaphores = vulkan::create_semaphores(devices[i], physical_devices_render_image_count[i] + 1);
-                return next_image_semaphores;
+            physical_devices_acquire_image_semaphores.begin(),
+            [&physical_devices_frame_slot_count, &devices](auto i) {
+                return vulkan::create_semaphores(devices[i], physical_devices_frame_slot_count[i]);
             }
         );
 
+        // Presentation holds on to the semaphore of its image, so these stay per swapchain image.
         auto physical_devices_render_image_semaphores = same_size_container<std::vector<vk::Semaphore>>(physical_devices);
         std::ranges::transform(
             physical_device_indices,
             physical_devices_render_image_semaphores.begin(),
-            [&physical_devices_render_image_count, &devices](auto i) {
-                auto render_image_semaphores = vulkan::create_semaphores(devices[i], physical_devices_render_image_count[i]);
+            [&physical_devices_swapchain_image_count, &devices](auto i) {
+                auto render_image_semaphores = vulkan::create_semaphores(devices[i], physical_devices_swapchain_image_count[i]);
                 return render_image_semaphores;
             }
         );
 
-        auto scene = generateRandomScene();
+        auto sphere_amount = static_cast<uint32_t>(scene.spheres.size());
+        auto animation_amount = static_cast<uint32_t>(scene.animations.size());
+        auto spheres = scene.spheres;
+
+        // Without animations nothing in the scene is written after startup.
+        auto static_scene = animation_amount == 0;
+        auto physical_devices_scene_copy_count = same_size_container<uint32_t>(physical_devices);
+        std::ranges::transform(
+            physical_devices_frame_slot_count,
+            physical_devices_scene_copy_count.begin(),
+            [static_scene](auto frame_slot_count) {
+                return static_scene ? 1 : frame_slot_count;
+            }
+        );
+        auto physical_devices_scene_copy_indices = same_size_container<std::vector<uint32_t>>(physical_devices);
+        std::ranges::transform(
+            physical_devices_scene_copy_count,
+            physical_devices_scene_copy_indices.begin(),
+            [](auto scene_copy_count) {
+                auto scene_copy_indices = std::vector<uint32_t>(scene_copy_count);
+                std::ranges::iota(scene_copy_indices, 0);
+                return scene_copy_indices;
+            }
+        );
 
-        auto sphere_amount = scene.sphereAmount;
+        // Only the AABB sphere mode builds a sphere BLAS.
+        auto sphere_blas_primitive_count = sphere_mode == SphereMode::Aabb ? sphere_amount : 0;
+        std::vector<vk::AabbPositionsKHR> aabbs(sphere_blas_primitive_count);
+        std::ranges::transform(
+            spheres.first(sphere_blas_primitive_count),
+            aabbs.begin(),
+            [](auto& sphere) {
+                auto getAABBFromSphere = [](const glm::vec4& geometry) {
+                    return vk::AabbPositionsKHR{
+                            .minX = geometry.x - geometry.w,
+                            .minY = geometry.y - geometry.w,
+                            .minZ = geometry.z - geometry.w,
+                            .maxX = geometry.x + geometry.w,
+                            .maxY = geometry.y + geometry.w,
+                            .maxZ = geometry.z + geometry.w
+                    };
+                    };
+                return getAABBFromSphere(sphere.geometry);
+            }
+        );
 
         auto physical_devices_aabb_buffers = same_size_container<std::vector<VulkanBuffer>>(physical_devices);
         std::ranges::transform(
             physical_device_indices,
             physical_devices_aabb_buffers.begin(),
-            [sphere_amount, &physical_devices_render_image_count, &devices, &physical_devices_memory_properties](auto i) {
-                auto aabb_buffers = std::vector<VulkanBuffer>(physical_devices_render_image_count[i]);
+            [sphere_amount, sphere_mode, &aabbs, &physical_devices_scene_copy_count, &devices, &physical_devices_memory_properties](auto i) {
+                auto aabb_buffers = std::vector<VulkanBuffer>(sphere_mode == SphereMode::Aabb ? physical_devices_scene_copy_count[i] : 0);
+                // Every copy is written once here, before any BLAS build reads it. The animation pass
+                // moves the AABBs of the animated spheres on the GPU, so frames upload nothing.
                 std::ranges::generate(
                     aabb_buffers,
-                    [device = devices[i], sphere_amount, &memory_properties = physical_devices_memory_properties[i]]() {
-                        return vulkan::create_aabb_buffer(device, sphere_amount, memory_properties);
+                    [device = devices[i], sphere_amount, &aabbs, &memory_properties = physical_devices_memory_properties[i]]() {
+                        auto aabb_buffer = vulkan::create_aabb_buffer(device, sphere_amount, memory_properties);
+                        vulkan::update_aabb_data(device, aabbs, aabb_buffer);
+                        return aabb_buffer;
                     }
                 );
                 return aabb_buffers;
@@ -329,8 +596,6 @@ void ray_trace_with_physical_devices(
         );
         auto aabb_buffers = physical_devices_aabb_buffers[test_physical_device_index];
 
-        std::vector<vk::AabbPositionsKHR> aabbs(sphere_amount);
-
         auto physical_devices_dynamic_dispatch_loader = same_size_container<vk::detail::DispatchLoaderDynamic>(physical_devices);
         std::ranges::transform(
             devices,
@@ -341,34 +606,213 @@ void ray_trace_with_physical_devices(
         );
         auto dynamicDispatchLoader = physical_devices_dynamic_dispatch_loader[test_physical_device_index];
 
+        auto physical_devices_rt_descriptor_set_layout = same_size_container<vk::DescriptorSetLayout>(physical_devices);
+        std::ranges::transform(
+            devices,
+            physical_devices_rt_descriptor_set_layout.begin(),
+            [](auto device) { return vulkan::create_descriptor_set_layout(device); }
+        );
+        auto rt_descriptor_set_layout = physical_devices_rt_descriptor_set_layout[test_physical_device_index];
+
+        auto physical_devices_animation_descriptor_set_layout = same_size_container<vk::DescriptorSetLayout>(physical_devices);
+        std::ranges::transform(
+            devices,
+            physical_devices_animation_descriptor_set_layout.begin(),
+            [](auto device) { return vulkan::create_animation_descriptor_set_layout(device); }
+        );
+
+        auto physical_devices_animation_pipeline_layout = same_size_container<vk::PipelineLayout>(physical_devices);
+        std::ranges::transform(
+            physical_device_indices,
+            physical_devices_animation_pipeline_layout.begin(),
+            [&devices, &physical_devices_animation_descriptor_set_layout](auto i) {
+                return vulkan::create_pipeline_layout(devices[i], physical_devices_animation_descriptor_set_layout[i]);
+            }
+        );
+
+        auto physical_devices_rt_pipeline_layout = same_size_container<vk::PipelineLayout>(physical_devices);
+        std::ranges::transform(
+            physical_device_indices,
+            physical_devices_rt_pipeline_layout.begin(),
+            [&devices, &physical_devices_rt_descriptor_set_layout](auto i) {
+                return vulkan::create_pipeline_layout(devices[i], physical_devices_rt_descriptor_set_layout[i]);
+            }
+        );
+        auto rt_pipeline_layout = physical_devices_rt_pipeline_layout[test_physical_device_index];
+
+        auto physical_devices_ray_tracing_pipeline_properties = same_size_container<vk::PhysicalDeviceRayTracingPipelinePropertiesKHR>(physical_devices);
+        std::ranges::transform(
+            physical_devices,
+            physical_devices_ray_tracing_pipeline_properties.begin(),
+            [](auto physical_device) {
+                vk::PhysicalDeviceRayTracingPipelinePropertiesKHR rayTracingPipelinePropertiesKhr = {};
+
+                vk::PhysicalDeviceProperties2 physicalDeviceProperties2 = {
+                        .pNext = &rayTracingPipelinePropertiesKhr
+                };
+
+                physical_device.getProperties2(&physicalDeviceProperties2);
+                return rayTracingPipelinePropertiesKhr;
+            }
+        );
+        auto rayTracingPipelinePropertiesKhr = physical_devices_ray_tracing_pipeline_properties[test_physical_device_index];
+
+        auto max_ray_recursion_depth = std::ranges::min(physical_devices_ray_tracing_pipeline_properties,
+            std::ranges::less{},
+            [](auto& props) {
+                return props.maxRayRecursionDepth;
+            }).maxRayRecursionDepth;
+
+        // Shader compilation does not depend on the scene, so the pipelines of each device are
+        // compiled on their own thread while its buffers and acceleration structures are built.
+        auto physical_devices_pipelines = same_size_container<std::future<std::tuple<vk::Pipeline, vk::Pipeline, startup::stage>>>(physical_devices);
+        std::ranges::transform(
+            physical_device_indices,
+            physical_devices_pipelines.begin(),
+            [&devices, max_ray_recursion_depth, &physical_devices_rt_pipeline_layout, &physical_devices_animation_pipeline_layout, sphere_mode,
+            &physical_devices_dynamic_dispatch_loader](auto i) {
+                return std::async(std::launch::async,
+                    [device = devices[i], max_ray_recursion_depth, rt_pipeline_layout = physical_devices_rt_pipeline_layout[i],
+                    animation_pipeline_layout = physical_devices_animation_pipeline_layout[i], sphere_mode,
+                    &dynamicDispatchLoader = physical_devices_dynamic_dispatch_loader[i]]() {
+                        auto begin_time = startup::clock::now();
+                        auto rt_pipeline = vulkan::create_rt_pipeline(device, max_ray_recursion_depth, rt_pipeline_layout, dynamicDispatchLoader);
+                        auto animation_pipeline = vulkan::create_animation_pipeline(device, animation_pipeline_layout, sphere_mode);
+                        return std::tuple{ rt_pipeline, animation_pipeline, startup::stage{ "pipelines", begin_time, startup::clock::now() } };
+                    });
+            }
+        );
+
         auto physical_devices_aabbs_geometries = same_size_container<std::vector<vk::AccelerationStructureGeometryKHR>>(physical_devices);
         auto physical_devices_bottom_accels = same_size_container<std::vector<VulkanAccelerationStructure>>(physical_devices);
         auto physical_devices_bottom_accel_build_infos = same_size_container<std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>>(physical_devices);
-        std::ranges::for_each(
-            physical_device_indices,
-            [&physical_devices_aabbs_geometries, &physical_devices_bottom_accels, &physical_devices_bottom_accel_build_infos, &physical_devices_render_image_count, &physical_devices_render_image_indices,
-            &devices, sphere_amount, &physical_devices_aabb_buffers, &physical_devices_memory_properties, &physical_devices_dynamic_dispatch_loader](auto i) {
-                auto render_image_count = physical_devices_render_image_count[i];
+        std::for_each(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
+            [&physical_devices_aabbs_geometries, &physical_devices_bottom_accels, &physical_devices_bottom_accel_build_infos, &physical_devices_scene_copy_count, &physical_devices_scene_copy_indices,
+            &devices, sphere_amount, sphere_mode, static_scene, &physical_devices_aabb_buffers,
+            &physical_devices_compute_queue, &physical_devices_command_pool,
+            &physical_devices_memory_properties, &physical_devices_dynamic_dispatch_loader, &physical_devices_startup_timeline](auto i) {
+                if (sphere_mode != SphereMode::Aabb) {
+                    return;
+                }
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "sphere blas" };
+                auto flags = vk::BuildAccelerationStructureFlagsKHR{ vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace };
+                if (static_scene) {
+                    flags |= vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction;
+                }
+                auto scene_copy_count = physical_devices_scene_copy_count[i];
                 auto& aabbs_geometries = physical_devices_aabbs_geometries[i];
-                aabbs_geometries.resize(render_image_count);
+                aabbs_geometries.resize(scene_copy_count);
                 std::ranges::fill(aabbs_geometries, vk::AccelerationStructureGeometryKHR{ .geometryType = vk::GeometryTypeKHR::eAabbs, .flags = vk::GeometryFlagBitsKHR::eOpaque });
 
-                auto bottom_accels = std::vector<VulkanAccelerationStructure>(render_image_count);
-                auto bottom_accel_build_infos = std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>(render_image_count);
+                auto bottom_accels = std::vector<VulkanAccelerationStructure>(scene_copy_count);
+                auto bottom_accel_build_infos = std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>(scene_copy_count);
                 std::ranges::for_each(
-                    physical_devices_render_image_indices[i],
+                    physical_devices_scene_copy_indices[i],
                     [&bottom_accels, &bottom_accel_build_infos, &aabbs_geometries,
-                    device = devices[i], &aabb_buffers = physical_devices_aabb_buffers[i], sphere_amount,
+                    device = devices[i], &aabb_buffers = physical_devices_aabb_buffers[i], sphere_amount, flags,
                     &memory_properties = physical_devices_memory_properties[i], &dynamicDispatchLoader = physical_devices_dynamic_dispatch_loader[i]](uint32_t i) {
-                        auto [bottom_accel, bottom_accel_build_info] = vulkan::createBottomAccelerationStructure(device, aabb_buffers[i], sphere_amount, aabbs_geometries[i], memory_properties, dynamicDispatchLoader);
+                        auto [bottom_accel, bottom_accel_build_info] = vulkan::createBottomAccelerationStructure(device, aabb_buffers[i], sphere_amount, aabbs_geometries[i], memory_properties, dynamicDispatchLoader, flags);
                         bottom_accels[i] = bottom_accel;
                         bottom_accel_build_infos[i] = bottom_accel_build_info;
                     }
                 );
+                // Without animations the spheres never move: build the shared BLAS once
+                // here, the command buffers skip the build when there are no build infos.
+                if (static_scene) {
+                    auto build_range_infos = std::vector<vk::AccelerationStructureBuildRangeInfoKHR>(scene_copy_count,
+                        { .primitiveCount = sphere_amount, .primitiveOffset = 0, .firstVertex = 0, .transformOffset = 0 });
+                    vulkan::build_static_accels(devices[i], physical_devices_compute_queue[i], physical_devices_command_pool[i],
+                        bottom_accels, bottom_accel_build_infos, build_range_infos, physical_devices_dynamic_dispatch_loader[i]);
+                    bottom_accel_build_infos.clear();
+                }
                 physical_devices_bottom_accels[i] = bottom_accels;
                 physical_devices_bottom_accel_build_infos[i] = bottom_accel_build_infos;
             }
         );
+        auto physical_devices_mesh_vertex_buffer = same_size_container<VulkanBuffer>(physical_devices);
+        auto physical_devices_mesh_index_buffer = same_size_container<VulkanBuffer>(physical_devices);
+        auto physical_devices_mesh_instance_buffer = same_size_container<VulkanBuffer>(physical_devices);
+        std::for_each(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
+            [&devices, &physical_devices_memory_properties, &mesh_scene,
+            &physical_devices_mesh_vertex_buffer, &physical_devices_mesh_index_buffer, &physical_devices_mesh_instance_buffer,
+            &physical_devices_startup_timeline](auto i) {
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "mesh buffers" };
+                auto [vertex_buffer, index_buffer, instance_buffer] = vulkan::create_mesh_buffers(devices[i], mesh_scene, physical_devices_memory_properties[i]);
+                physical_devices_mesh_vertex_buffer[i] = vertex_buffer;
+                physical_devices_mesh_index_buffer[i] = index_buffer;
+                physical_devices_mesh_instance_buffer[i] = instance_buffer;
+            }
+        );
+
+        auto physical_devices_mesh_bottom_accels = same_size_container<std::vector<VulkanAccelerationStructure>>(physical_devices);
+        auto physical_devices_static_blas_build_time = same_size_container<std::chrono::steady_clock::duration>(physical_devices);
+        std::transform(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
+            physical_devices_mesh_bottom_accels.begin(),
+            [&devices, &physical_devices_compute_queue, &physical_devices_command_pool, &mesh_scene,
+            &physical_devices_mesh_vertex_buffer, &physical_devices_mesh_index_buffer,
+            &physical_devices_memory_properties, &physical_devices_dynamic_dispatch_loader, &physical_devices_host_blas_builds,
+            &physical_devices_static_blas_build_time, &physical_devices_startup_timeline](auto i) {
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "mesh blas" };
+                auto build_begin_time = std::chrono::steady_clock::now();
+                auto mesh_bottom_accels = physical_devices_host_blas_builds[i]
+                    ? vulkan::create_mesh_bottom_accels_on_host(devices[i], mesh_scene,
+                        physical_devices_memory_properties[i], physical_devices_dynamic_dispatch_loader[i])
+                    : vulkan::create_mesh_bottom_accels(devices[i], physical_devices_compute_queue[i], physical_devices_command_pool[i],
+                        physical_devices_mesh_vertex_buffer[i], physical_devices_mesh_index_buffer[i], mesh_scene,
+                        physical_devices_memory_properties[i], physical_devices_dynamic_dispatch_loader[i]);
+                physical_devices_static_blas_build_time[i] = std::chrono::steady_clock::now() - build_begin_time;
+                return mesh_bottom_accels;
+            }
+        );
+        std::ranges::for_each(
+            physical_device_indices,
+            [&physical_devices_static_blas_build_time](auto i) {
+                std::cout << "static_blas_build_time[" << i << "]: "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(physical_devices_static_blas_build_time[i]) << std::endl;
+            }
+        );
+
+        // Static BLASes are compacted once built, the copies typically need about half the memory.
+        auto physical_devices_static_blas_bytes = same_size_container<std::pair<vk::DeviceSize, vk::DeviceSize>>(physical_devices);
+        std::for_each(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
+            [&devices, &physical_devices_compute_queue, &physical_devices_command_pool, static_scene,
+            &physical_devices_bottom_accels, &physical_devices_mesh_bottom_accels, &physical_devices_static_blas_bytes,
+            &physical_devices_memory_properties, &physical_devices_dynamic_dispatch_loader, &physical_devices_startup_timeline](auto i) {
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "blas compaction" };
+                auto& sphere_bottom_accels = physical_devices_bottom_accels[i];
+                auto& mesh_bottom_accels = physical_devices_mesh_bottom_accels[i];
+                auto get_static_bytes = [static_scene, &sphere_bottom_accels, &mesh_bottom_accels]() {
+                    return (static_scene ? vulkan::get_acceleration_structure_memory(sphere_bottom_accels) : 0)
+                        + vulkan::get_acceleration_structure_memory(mesh_bottom_accels);
+                };
+                auto uncompacted_bytes = get_static_bytes();
+                if (static_scene) {
+                    vulkan::compact_bottom_accels(devices[i], physical_devices_compute_queue[i], physical_devices_command_pool[i],
+                        sphere_bottom_accels, physical_devices_memory_properties[i], physical_devices_dynamic_dispatch_loader[i]);
+                }
+                vulkan::compact_bottom_accels(devices[i], physical_devices_compute_queue[i], physical_devices_command_pool[i],
+                    mesh_bottom_accels, physical_devices_memory_properties[i], physical_devices_dynamic_dispatch_loader[i]);
+                physical_devices_static_blas_bytes[i] = { uncompacted_bytes, get_static_bytes() };
+            }
+        );
+        std::ranges::for_each(
+            physical_device_indices,
+            [&physical_devices_static_blas_bytes](auto i) {
+                auto [uncompacted_bytes, compacted_bytes] = physical_devices_static_blas_bytes[i];
+                std::cout << "static_blas_bytes[" << i << "]: " << uncompacted_bytes << " before compaction, " << compacted_bytes << " after" << std::endl;
+            }
+        );
+        auto sphere_instance_count = sphere_mode == SphereMode::Aabb ? 1 : sphere_amount;
+        auto top_accel_instance_count = static_cast<uint32_t>(sphere_instance_count + mesh_scene.instances.size());
+
         auto& aabbs_geometries = physical_devices_aabbs_geometries[test_physical_device_index];
         auto& bottom_accels = physical_devices_bottom_accels[test_physical_device_index];
         auto& bottom_accel_build_infos = physical_devices_bottom_accel_build_infos[test_physical_device_index];
@@ -377,28 +821,44 @@ void ray_trace_with_physical_devices(
         auto physical_devices_instances_geometries = same_size_container<std::vector<vk::AccelerationStructureGeometryKHR>>(physical_devices);
         auto physical_devices_top_accels = same_size_container<std::vector<VulkanAccelerationStructure>>(physical_devices);
         auto physical_devices_top_accel_build_infos = same_size_container<std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>>(physical_devices);
-        std::ranges::for_each(
-            physical_device_indices,
+        std::for_each(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
             [&physical_devices_instances_geometries, &physical_devices_top_accels, &physical_devices_top_accel_build_infos,
-            &physical_devices_render_image_indices, &physical_devices_render_image_count,
-            &devices, &physical_devices_memory_properties, &physical_devices_bottom_accels, &physical_devices_dynamic_dispatch_loader](auto i) {
-                auto render_image_count = physical_devices_render_image_count[i];
+            &physical_devices_scene_copy_indices, &physical_devices_scene_copy_count, static_scene, top_accel_instance_count,
+            &physical_devices_compute_queue, &physical_devices_command_pool,
+            &devices, &physical_devices_memory_properties, &physical_devices_bottom_accels, &physical_devices_mesh_bottom_accels, &mesh_scene,
+            sphere_mode, &spheres, icosphere_mesh_index, &physical_devices_dynamic_dispatch_loader, &physical_devices_startup_timeline](auto i) {
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "tlas" };
+                auto scene_copy_count = physical_devices_scene_copy_count[i];
                 auto& instances_geometries = physical_devices_instances_geometries[i];
-                instances_geometries.resize(render_image_count);
+                instances_geometries.resize(scene_copy_count);
                 std::ranges::fill(instances_geometries, vk::AccelerationStructureGeometryKHR{ .geometryType = vk::GeometryTypeKHR::eInstances, .flags = vk::GeometryFlagBitsKHR::eOpaque });
 
-                auto top_accels = std::vector<VulkanAccelerationStructure>(render_image_count);
-                auto top_accel_build_infos = std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>(render_image_count);
+                auto top_accels = std::vector<VulkanAccelerationStructure>(scene_copy_count);
+                auto top_accel_build_infos = std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>(scene_copy_count);
                 std::ranges::for_each(
-                    physical_devices_render_image_indices[i],
+                    physical_devices_scene_copy_indices[i],
                     [&top_accels, &top_accel_build_infos, &instances_geometries,
-                    device = devices[i], &bottom_accels = physical_devices_bottom_accels[i],
+                    device = devices[i], &bottom_accels = physical_devices_bottom_accels[i], &mesh_bottom_accels = physical_devices_mesh_bottom_accels[i], &mesh_scene,
+                    sphere_mode, &spheres, icosphere_mesh_index,
                     &memory_properties = physical_devices_memory_properties[i], &dynamicDispatchLoader = physical_devices_dynamic_dispatch_loader[i]](uint32_t i) {
-                        auto [top_accel, top_accel_build_info] = vulkan::createTopAccelerationStructure(device, bottom_accels[i].accelerationStructure, instances_geometries[i], memory_properties, dynamicDispatchLoader);
+                        auto sphere_bottom_accel = bottom_accels.empty() ? vk::AccelerationStructureKHR{} : bottom_accels[i].accelerationStructure;
+                        auto instances = vulkan::get_top_accel_instances(device, sphere_mode, sphere_bottom_accel, spheres, icosphere_mesh_index,
+                            mesh_bottom_accels, mesh_scene, dynamicDispatchLoader);
+                        auto [top_accel, top_accel_build_info] = vulkan::createTopAccelerationStructure(device, instances, instances_geometries[i], memory_properties, dynamicDispatchLoader);
                         top_accels[i] = top_accel;
                         top_accel_build_infos[i] = top_accel_build_info;
                     }
                 );
+                // The instances of a static scene never change either, so its TLAS is built once too.
+                if (static_scene) {
+                    auto build_range_infos = std::vector<vk::AccelerationStructureBuildRangeInfoKHR>(scene_copy_count,
+                        { .primitiveCount = top_accel_instance_count, .primitiveOffset = 0, .firstVertex = 0, .transformOffset = 0 });
+                    vulkan::build_static_accels(devices[i], physical_devices_compute_queue[i], physical_devices_command_pool[i],
+                        top_accels, top_accel_build_infos, build_range_infos, physical_devices_dynamic_dispatch_loader[i]);
+                    top_accel_build_infos.clear();
+                }
                 physical_devices_top_accels[i] = top_accels;
                 physical_devices_top_accel_build_infos[i] = top_accel_build_infos;
             });
@@ -406,19 +866,11 @@ void ray_trace_with_physical_devices(
         auto top_accels = physical_devices_top_accels[test_physical_device_index];
         auto top_accel_build_infos = physical_devices_top_accel_build_infos[test_physical_device_index];
 
-        auto physical_devices_rt_descriptor_set_layout = same_size_container<vk::DescriptorSetLayout>(physical_devices);
-        std::ranges::transform(
-            devices,
-            physical_devices_rt_descriptor_set_layout.begin(),
-            [](auto device) { return vulkan::create_descriptor_set_layout(device); }
-        );
-        auto rt_descriptor_set_layout = physical_devices_rt_descriptor_set_layout[test_physical_device_index];
-
         auto physical_devices_rt_descriptor_pool = same_size_container<vk::DescriptorPool>(physical_devices);
         std::ranges::transform(
             physical_device_indices,
             physical_devices_rt_descriptor_pool.begin(),
-            [&physical_devices_render_image_count, &devices](auto i) { return vulkan::create_descriptor_pool(devices[i], physical_devices_render_image_count[i]); }
+            [&physical_devices_frame_slot_count, &devices](auto i) { return vulkan::create_descriptor_pool(devices[i], physical_devices_frame_slot_count[i]); }
         );
         auto rt_descriptor_pool = physical_devices_rt_descriptor_pool[test_physical_device_index];
 
@@ -426,79 +878,136 @@ void ray_trace_with_physical_devices(
         std::ranges::transform(
             physical_device_indices,
             physical_devices_sphere_buffers.begin(),
-            [&devices, &physical_devices_memory_properties, &physical_devices_render_image_count](auto i) {
-                auto sphere_buffers = std::vector<VulkanBuffer>(physical_devices_render_image_count[i]);
+            [&devices, &physical_devices_memory_properties, &physical_devices_scene_copy_count, sphere_amount, &spheres](auto i) {
+                auto sphere_buffers = std::vector<VulkanBuffer>(physical_devices_scene_copy_count[i]);
+                // Like the AABBs, every copy is written once. The TLAS instances of icosphere mode already
+                // got the sphere transforms when the TLAS was created.
                 std::ranges::generate(
                     sphere_buffers,
-                    [device = devices[i], &memory_properties = physical_devices_memory_properties[i]]() { return vulkan::create_sphere_buffer(device, memory_properties); }
+                    [device = devices[i], sphere_amount, &spheres, &memory_properties = physical_devices_memory_properties[i]]() {
+                        auto sphere_buffer = vulkan::create_sphere_buffer(device, sphere_amount, memory_properties);
+                        vulkan::update_sphere_data(device, sphere_buffer, spheres);
+                        return sphere_buffer;
+                    }
                 );
                 return sphere_buffers;
             }
         );
         auto sphere_buffers = physical_devices_sphere_buffers[test_physical_device_index];
 
+        auto physical_devices_sphere_material_index_buffer = same_size_container<VulkanBuffer>(physical_devices);
+        auto physical_devices_material_buffer = same_size_container<VulkanBuffer>(physical_devices);
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_memory_properties, &physical_devices_sphere_material_index_buffer, &physical_devices_material_buffer, &scene](auto i) {
+                auto [sphere_material_index_buffer, material_buffer] = vulkan::create_material_buffers(devices[i],
+                    scene.sphereMaterialIndices, scene.materials, physical_devices_memory_properties[i]);
+                physical_devices_sphere_material_index_buffer[i] = sphere_material_index_buffer;
+                physical_devices_material_buffer[i] = material_buffer;
+            }
+        );
+
+        auto physical_devices_animation_buffer = same_size_container<VulkanBuffer>(physical_devices);
+        if (animation_amount > 0) {
+            std::ranges::transform(
+                physical_device_indices,
+                physical_devices_animation_buffer.begin(),
+                [&devices, &physical_devices_memory_properties, animations = scene.animations](auto i) {
+                    return vulkan::create_animation_buffer(devices[i], animations, physical_devices_memory_properties[i]);
+                }
+            );
+        }
+
         auto physical_devices_render_call_info_buffers = same_size_container<std::vector<VulkanBuffer>>(physical_devices);
         std::ranges::transform(
             physical_device_indices,
             physical_devices_render_call_info_buffers.begin(),
-            [&devices, &physical_devices_memory_properties, &physical_devices_render_image_count](auto i) {
-                return vulkan::create_render_call_info_buffers(devices[i], physical_devices_render_image_count[i], physical_devices_memory_properties[i]);
+            [&devices, &physical_devices_memory_properties, &physical_devices_frame_slot_count](auto i) {
+                return vulkan::create_render_call_info_buffers(devices[i], physical_devices_frame_slot_count[i], physical_devices_memory_properties[i]);
             });
         auto render_call_info_buffers = physical_devices_render_call_info_buffers[test_physical_device_index];
 
-        auto physical_devices_rt_descriptor_sets = same_size_container<std::vector<vk::DescriptorSet>>(physical_devices);
+        auto physical_devices_readback_buffers = same_size_container<std::vector<VulkanBuffer>>(physical_devices);
         std::ranges::transform(
             physical_device_indices,
-            physical_devices_rt_descriptor_sets.begin(),
-            [&devices, &physical_devices_render_image_count, &physical_devices_rt_descriptor_set_layout,
-            &physical_devices_rt_descriptor_pool, &physical_devices_render_target_images,
-            &physical_devices_top_accels, &physical_devices_sphere_buffers, &physical_devices_summed_images,
-            &physical_devices_render_call_info_buffers](auto i) {
-                return vulkan::create_descriptor_set(devices[i], physical_devices_render_image_count[i],
-                    physical_devices_rt_descriptor_set_layout[i], physical_devices_rt_descriptor_pool[i], physical_devices_render_target_images[i],
-                    physical_devices_top_accels[i], physical_devices_sphere_buffers[i], physical_devices_summed_images[i], physical_devices_render_call_info_buffers[i]);
+            physical_devices_readback_buffers.begin(),
+            [&devices, &physical_devices_memory_properties, &physical_devices_frame_slot_count, &physical_devices_render_extent, sample_split](auto i) {
+                // Sample split mode reads back the RGBA32F summed image, the other modes the RGBA8 render target.
+                return vulkan::create_readback_buffers(devices[i], physical_devices_frame_slot_count[i],
+                    physical_devices_render_extent[i].x, physical_devices_render_extent[i].y, sample_split ? 16 : 4, physical_devices_memory_properties[i]);
             });
-        auto rt_descriptor_sets = physical_devices_rt_descriptor_sets[test_physical_device_index];
 
-        auto physical_devices_rt_pipeline_layout = same_size_container<vk::PipelineLayout>(physical_devices);
+        auto physical_devices_row_cost_buffers = same_size_container<std::vector<VulkanBuffer>>(physical_devices);
         std::ranges::transform(
             physical_device_indices,
-            physical_devices_rt_pipeline_layout.begin(),
-            [&devices, &physical_devices_rt_descriptor_set_layout](auto i) {
-                return vulkan::create_pipeline_layout(devices[i], physical_devices_rt_descriptor_set_layout[i]);
-            }
-        );
-        auto rt_pipeline_layout = physical_devices_rt_pipeline_layout[test_physical_device_index];
+            physical_devices_row_cost_buffers.begin(),
+            [&devices, &physical_devices_memory_properties, &physical_devices_frame_slot_count, &physical_devices_render_extent](auto i) {
+                return vulkan::create_row_cost_buffers(devices[i], physical_devices_frame_slot_count[i],
+                    physical_devices_render_extent[i].y, physical_devices_memory_properties[i]);
+            });
 
-        auto physical_devices_ray_tracing_pipeline_properties = same_size_container<vk::PhysicalDeviceRayTracingPipelinePropertiesKHR>(physical_devices);
+        auto physical_devices_animation_descriptor_pool = same_size_container<vk::DescriptorPool>(physical_devices);
         std::ranges::transform(
-            physical_devices,
-            physical_devices_ray_tracing_pipeline_properties.begin(),
-            [](auto physical_device) {
-                vk::PhysicalDeviceRayTracingPipelinePropertiesKHR rayTracingPipelinePropertiesKhr = {};
-
-                vk::PhysicalDeviceProperties2 physicalDeviceProperties2 = {
-                        .pNext = &rayTracingPipelinePropertiesKhr
-                };
-
-                physical_device.getProperties2(&physicalDeviceProperties2);
-                return rayTracingPipelinePropertiesKhr;
-            }
+            physical_device_indices,
+            physical_devices_animation_descriptor_pool.begin(),
+            [&physical_devices_frame_slot_count, &devices](auto i) { return vulkan::create_animation_descriptor_pool(devices[i], physical_devices_frame_slot_count[i]); }
         );
-        auto rayTracingPipelinePropertiesKhr = physical_devices_ray_tracing_pipeline_properties[test_physical_device_index];
 
-        auto max_ray_recursion_depth = std::ranges::min(physical_devices_ray_tracing_pipeline_properties,
-            std::ranges::less{},
-            [](auto& props) {
-                return props.maxRayRecursionDepth;
-            }).maxRayRecursionDepth;
+        auto physical_devices_animation_descriptor_sets = same_size_container<std::vector<vk::DescriptorSet>>(physical_devices);
+        if (animation_amount > 0) {
+            std::ranges::transform(
+                physical_device_indices,
+                physical_devices_animation_descriptor_sets.begin(),
+                [&devices, &physical_devices_frame_slot_count, &physical_devices_animation_descriptor_set_layout, &physical_devices_animation_descriptor_pool,
+                &physical_devices_animation_buffer, animation_amount, &physical_devices_sphere_buffers, &physical_devices_aabb_buffers,
+                sphere_mode, &physical_devices_top_accels, &physical_devices_render_call_info_buffers](auto i) {
+                    // The animation writes AABBs for the procedural BLAS, or the
+                    // transforms of the sphere instances at the start of each TLAS instance buffer.
+                    auto geometry_output_buffers = physical_devices_aabb_buffers[i];
+                    if (sphere_mode == SphereMode::Icosphere) {
+                        geometry_output_buffers.resize(physical_devices_top_accels[i].size());
+                        std::ranges::transform(physical_devices_top_accels[i], geometry_output_buffers.begin(),
+                            [](auto& top_accel) { return top_accel.instancesBuffer; });
+                    }
+                    return vulkan::create_animation_descriptor_sets(devices[i], physical_devices_frame_slot_count[i],
+                        physical_devices_animation_descriptor_set_layout[i], physical_devices_animation_descriptor_pool[i],
+                        physical_devices_animation_buffer[i], animation_amount, physical_devices_sphere_buffers[i],
+                        geometry_output_buffers, physical_devices_render_call_info_buffers[i]);
+                });
+        }
+
+        auto physical_devices_rt_descriptor_sets = same_size_container<std::vector<vk::DescriptorSet>>(physical_devices);
+        std::transform(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
+            physical_devices_rt_descriptor_sets.begin(),
+            [&devices, &physical_devices_frame_slot_count, &physical_devices_rt_descriptor_set_layout,
+            &physical_devices_rt_descriptor_pool, &physical_devices_render_target_images,
+            &physical_devices_top_accels, &physical_devices_sphere_buffers, &physical_devices_summed_images,
+            &physical_devices_render_call_info_buffers, &physical_devices_sphere_material_index_buffer, &physical_devices_material_buffer,
+            &physical_devices_mesh_vertex_buffer, &physical_devices_mesh_index_buffer, &physical_devices_mesh_instance_buffer,
+            &physical_devices_row_cost_buffers, &physical_devices_startup_timeline](auto i) {
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "descriptor sets" };
+                auto frame_slot_count = physical_devices_frame_slot_count[i];
+                return vulkan::create_descriptor_set(devices[i], frame_slot_count,
+                    physical_devices_rt_descriptor_set_layout[i], physical_devices_rt_descriptor_pool[i], physical_devices_render_target_images[i],
+                    get_per_frame_slot(physical_devices_top_accels[i], frame_slot_count), get_per_frame_slot(physical_devices_sphere_buffers[i], frame_slot_count),
+                    physical_devices_summed_images[i], physical_devices_render_call_info_buffers[i],
+                    physical_devices_sphere_material_index_buffer[i], physical_devices_material_buffer[i],
+                    physical_devices_mesh_vertex_buffer[i], physical_devices_mesh_index_buffer[i], physical_devices_mesh_instance_buffer[i],
+                    physical_devices_row_cost_buffers[i]);
+            });
+        auto rt_descriptor_sets = physical_devices_rt_descriptor_sets[test_physical_device_index];
 
         auto physical_devices_rt_pipeline = same_size_container<vk::Pipeline>(physical_devices);
-        std::ranges::transform(
+        auto physical_devices_animation_pipeline = same_size_container<vk::Pipeline>(physical_devices);
+        std::ranges::for_each(
             physical_device_indices,
-            physical_devices_rt_pipeline.begin(),
-            [&devices, max_ray_recursion_depth, &physical_devices_rt_pipeline_layout, &physical_devices_dynamic_dispatch_loader](auto i) {
-                return vulkan::create_rt_pipeline(devices[i], max_ray_recursion_depth, physical_devices_rt_pipeline_layout[i], physical_devices_dynamic_dispatch_loader[i]);
+            [&physical_devices_pipelines, &physical_devices_rt_pipeline, &physical_devices_animation_pipeline, &physical_devices_startup_timeline](auto i) {
+                auto [rt_pipeline, animation_pipeline, stage] = physical_devices_pipelines[i].get();
+                physical_devices_rt_pipeline[i] = rt_pipeline;
+                physical_devices_animation_pipeline[i] = animation_pipeline;
+                startup::add_stage(physical_devices_startup_timeline[i], stage);
             }
         );
         auto rt_pipeline = physical_devices_rt_pipeline[test_physical_device_index];
@@ -507,11 +1016,13 @@ void ray_trace_with_physical_devices(
         auto physical_devices_sbt_ray_gen_address_region = same_size_container<vk::StridedDeviceAddressRegionKHR>(physical_devices);
         auto physical_devices_sbt_miss_address_region = same_size_container<vk::StridedDeviceAddressRegionKHR>(physical_devices);
         auto physical_devices_sbt_hit_address_region = same_size_container<vk::StridedDeviceAddressRegionKHR>(physical_devices);
-        std::ranges::for_each(
-            physical_device_indices,
+        std::for_each(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
             [&physical_devices_shader_binding_table_buffer, &physical_devices_sbt_ray_gen_address_region, &physical_devices_sbt_miss_address_region, &physical_devices_sbt_hit_address_region,
             &devices, &physical_devices_rt_pipeline, &physical_devices_ray_tracing_pipeline_properties,
-            &physical_devices_memory_properties, &physical_devices_dynamic_dispatch_loader](auto i) {
+            &physical_devices_memory_properties, &physical_devices_dynamic_dispatch_loader, &physical_devices_startup_timeline](auto i) {
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "shader binding table" };
                 auto [shader_binding_table_buffer, sbtRayGenAddressRegion, sbtMissAddressRegion, sbtHitAddressRegion] =
                     vulkan::create_shader_binding_table_buffer(devices[i], physical_devices_rt_pipeline[i], physical_devices_ray_tracing_pipeline_properties[i],
                         physical_devices_memory_properties[i], physical_devices_dynamic_dispatch_loader[i]);
@@ -526,23 +1037,109 @@ void ray_trace_with_physical_devices(
         auto sbtMissAddressRegion = physical_devices_sbt_miss_address_region[test_physical_device_index];
         auto sbtHitAddressRegion = physical_devices_sbt_hit_address_region[test_physical_device_index];
 
+        auto physical_devices_timestamp_query_pool = same_size_container<vk::QueryPool>(physical_devices);
+        std::ranges::transform(
+            physical_device_indices,
+            physical_devices_timestamp_query_pool.begin(),
+            [&devices, &physical_devices_frame_slot_count](auto i) {
+                return vulkan::create_timestamp_query_pool(devices[i], physical_devices_frame_slot_count[i]);
+            }
+        );
+        auto physical_devices_timestamp_period = same_size_container<float>(physical_devices);
+        std::ranges::transform(
+            physical_devices,
+            physical_devices_timestamp_period.begin(),
+            [](auto physical_device) {
+                return physical_device.getProperties().limits.timestampPeriod;
+            }
+        );
 
+        std::ranges::for_each(
+            physical_device_indices,
+            [&physical_devices_bottom_accels, &physical_devices_mesh_bottom_accels, &physical_devices_top_accels,
+            &physical_devices_aabb_buffers, &physical_devices_sphere_buffers, &physical_devices_sphere_material_index_buffer, &physical_devices_material_buffer,
+            &physical_devices_mesh_vertex_buffer, &physical_devices_mesh_index_buffer, &physical_devices_mesh_instance_buffer, &physical_devices_animation_buffer,
+            &physical_devices_render_call_info_buffers, &physical_devices_render_target_images, &physical_devices_summed_images,
+            &physical_devices_scene_copy_count](auto i) {
+                auto acceleration_structure_bytes = vulkan::get_acceleration_structure_memory(physical_devices_bottom_accels[i])
+                    + vulkan::get_acceleration_structure_memory(physical_devices_mesh_bottom_accels[i])
+                    + vulkan::get_acceleration_structure_memory(physical_devices_top_accels[i]);
+                auto acceleration_structure_build_bytes = vulkan::get_acceleration_structure_build_memory(physical_devices_bottom_accels[i])
+                    + vulkan::get_acceleration_structure_build_memory(physical_devices_mesh_bottom_accels[i])
+                    + vulkan::get_acceleration_structure_build_memory(physical_devices_top_accels[i]);
+                auto scene_bytes = vulkan::get_resources_memory(physical_devices_aabb_buffers[i])
+                    + vulkan::get_resources_memory(physical_devices_sphere_buffers[i])
+                    + vulkan::get_resources_memory(std::array{ physical_devices_sphere_material_index_buffer[i], physical_devices_material_buffer[i],
+                        physical_devices_mesh_vertex_buffer[i], physical_devices_mesh_index_buffer[i], physical_devices_mesh_instance_buffer[i],
+                        physical_devices_animation_buffer[i] });
+                auto per_frame_bytes = vulkan::get_resources_memory(physical_devices_render_call_info_buffers[i])
+                    + vulkan::get_resources_memory(physical_devices_render_target_images[i])
+                    + vulkan::get_resources_memory(physical_devices_summed_images[i]);
+                std::cout << "acceleration_structure_bytes[" << i << "]: " << acceleration_structure_bytes << std::endl;
+                std::cout << "memory_bytes[" << i << "]: "
+                    << acceleration_structure_bytes << " acceleration structures, "
+                    << acceleration_structure_build_bytes << " acceleration structure build inputs, "
+                    << scene_bytes << " scene, "
+                    << per_frame_bytes << " per frame, "
+                    << physical_devices_scene_copy_count[i] << " scene copies" << std::endl;
+            }
+        );
 
-        auto physical_devices_command_buffers = same_size_container<std::vector<vk::CommandBuffer>>(physical_devices);
+        // Per-frame builds go to the build queue when the device has one, so the builds of
+        // the next frame overlap the trace of the current one.
+        auto physical_devices_async_builds = same_size_container<bool>(physical_devices);
         std::ranges::transform(
+            physical_devices_build_queue,
+            physical_devices_async_builds.begin(),
+            [static_scene](auto build_queue) {
+                return build_queue && !static_scene;
+            }
+        );
+        std::ranges::for_each(
             physical_device_indices,
+            [&physical_devices_async_builds](auto i) {
+                std::cout << "async_acceleration_structure_builds[" << i << "]: " << physical_devices_async_builds[i] << std::endl;
+            }
+        );
+
+        auto physical_devices_command_buffers = same_size_container<std::vector<vk::CommandBuffer>>(physical_devices);
+        std::transform(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
             physical_devices_command_buffers.begin(),
-            [&devices, &physical_devices_command_pool, &physical_devices_render_image_count, &physical_devices_swapchain_images, compute_queue_families,
-            &physical_devices_render_target_images, &physical_devices_summed_images, &physical_devices_rt_pipeline, &physical_devices_rt_descriptor_sets, &physical_devices_rt_pipeline_layout,
+            [&devices, &physical_devices_command_pool, &physical_devices_frame_slot_count, &physical_devices_swapchain_images, compute_queue_families,
+            &physical_devices_render_target_images, &physical_devices_summed_images, &physical_devices_readback_buffers, &physical_devices_row_cost_buffers, &physical_devices_rt_pipeline, &physical_devices_rt_descriptor_sets, &physical_devices_rt_pipeline_layout,
+            &physical_devices_animation_pipeline, &physical_devices_animation_descriptor_sets, &physical_devices_animation_pipeline_layout, animation_amount,
             &aabbs, &physical_devices_bottom_accel_build_infos, &physical_devices_bottom_accels,
-            &physical_devices_top_accel_build_infos, &physical_devices_top_accels,
-            &physical_devices_sbt_ray_gen_address_region, &physical_devices_sbt_miss_address_region, &physical_devices_sbt_hit_address_region,
-            &physical_devices_render_extent, &physical_devices_swapchain_extent, &physical_devices_dynamic_dispatch_loader](auto i) {
+            &physical_devices_top_accel_build_infos, &physical_devices_top_accels, top_accel_instance_count, &physical_devices_timestamp_query_pool,
+            &physical_devices_async_builds, &physical_devices_sbt_ray_gen_address_region, &physical_devices_sbt_miss_address_region, &physical_devices_sbt_hit_address_region,
+            &physical_devices_render_extent, &physical_devices_swapchain_extent, &physical_devices_dynamic_dispatch_loader,
+            &physical_devices_startup_timeline, tile_count, sample_split](auto i) {
+                if (tile_count > 0) {
+                    return std::vector<vk::CommandBuffer>{};
+                }
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "command buffers" };
+                if (sample_split) {
+                    return vulkan::create_sample_split_command_buffers(
+                        devices[i], physical_devices_command_pool[i], physical_devices_frame_slot_count[i], compute_queue_families[i],
+                        physical_devices_render_target_images[i], physical_devices_summed_images[i], physical_devices_readback_buffers[i],
+                        physical_devices_rt_pipeline[i], physical_devices_rt_descriptor_sets[i], physical_devices_rt_pipeline_layout[i],
+                        physical_devices_animation_pipeline[i], physical_devices_animation_descriptor_sets[i], physical_devices_animation_pipeline_layout[i], animation_amount,
+                        aabbs, physical_devices_bottom_accel_build_infos[i], physical_devices_bottom_accels[i],
+                        physical_devices_top_accel_build_infos[i], get_per_frame_slot(physical_devices_top_accels[i], physical_devices_frame_slot_count[i]), top_accel_instance_count,
+                        physical_devices_timestamp_query_pool[i], !physical_devices_async_builds[i],
+                        physical_devices_sbt_ray_gen_address_region[i], physical_devices_sbt_miss_address_region[i], physical_devices_sbt_hit_address_region[i],
+                        physical_devices_render_extent[i].x, physical_devices_render_extent[i].y,
+                        physical_devices_dynamic_dispatch_loader[i]);
+                }
                 return vulkan::create_command_buffers(
-                    devices[i], physical_devices_command_pool[i], physical_devices_render_image_count[i], physical_devices_swapchain_images[i], compute_queue_families[i],
-                    physical_devices_render_target_images[i], physical_devices_summed_images[i], physical_devices_rt_pipeline[i], physical_devices_rt_descriptor_sets[i], physical_devices_rt_pipeline_layout[i],
+                    devices[i], physical_devices_command_pool[i], physical_devices_frame_slot_count[i], physical_devices_swapchain_images[i], compute_queue_families[i],
+                    physical_devices_render_target_images[i], physical_devices_summed_images[i], physical_devices_readback_buffers[i], physical_devices_row_cost_buffers[i],
+                    physical_devices_rt_pipeline[i], physical_devices_rt_descriptor_sets[i], physical_devices_rt_pipeline_layout[i],
+                    physical_devices_animation_pipeline[i], physical_devices_animation_descriptor_sets[i], physical_devices_animation_pipeline_layout[i], animation_amount,
                     aabbs, physical_devices_bottom_accel_build_infos[i], physical_devices_bottom_accels[i],
-                    physical_devices_top_accel_build_infos[i], physical_devices_top_accels[i],
+                    physical_devices_top_accel_build_infos[i], get_per_frame_slot(physical_devices_top_accels[i], physical_devices_frame_slot_count[i]), top_accel_instance_count,
+                    physical_devices_timestamp_query_pool[i], !physical_devices_async_builds[i],
                     physical_devices_sbt_ray_gen_address_region[i], physical_devices_sbt_miss_address_region[i], physical_devices_sbt_hit_address_region[i],
                     physical_devices_render_extent[i].x, physical_devices_render_extent[i].y,
                     physical_devices_swapchain_extent[i],
@@ -550,203 +1147,517 @@ void ray_trace_with_physical_devices(
             }
         );
 
-        auto physical_devices_next_image_semaphores_indices = same_size_container<std::vector<uint32_t>>(physical_devices);
+        // Tile mode has a command buffer per frame slot starting the frame and one per frame slot and tile instead.
+        auto physical_devices_tile_frame_command_buffers = same_size_container<std::vector<vk::CommandBuffer>>(physical_devices);
+        auto physical_devices_tile_command_buffers = same_size_container<std::vector<vk::CommandBuffer>>(physical_devices);
+        if (tile_count > 0) {
+            std::for_each(
+                std::execution::par,
+                physical_device_indices.begin(), physical_device_indices.end(),
+                [&devices, &physical_devices_command_pool, &physical_devices_frame_slot_count, compute_queue_families,
+                &physical_devices_render_target_images, &physical_devices_summed_images, &physical_devices_readback_buffers,
+                &physical_devices_rt_pipeline, &physical_devices_rt_descriptor_sets, &physical_devices_rt_pipeline_layout,
+                &physical_devices_animation_pipeline, &physical_devices_animation_descriptor_sets, &physical_devices_animation_pipeline_layout, animation_amount,
+                &aabbs, &physical_devices_bottom_accel_build_infos, &physical_devices_bottom_accels,
+                &physical_devices_top_accel_build_infos, &physical_devices_top_accels, top_accel_instance_count, &physical_devices_timestamp_query_pool,
+                &physical_devices_async_builds, &physical_devices_sbt_ray_gen_address_region, &physical_devices_sbt_miss_address_region, &physical_devices_sbt_hit_address_region,
+                &physical_devices_tile_frame_command_buffers, &physical_devices_tile_command_buffers, tile_count, tile_height, width, height,
+                &physical_devices_dynamic_dispatch_loader, &physical_devices_startup_timeline](auto i) {
+                    auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "command buffers" };
+                    physical_devices_tile_frame_command_buffers[i] = vulkan::create_tile_frame_command_buffers(
+                        devices[i], physical_devices_command_pool[i], physical_devices_frame_slot_count[i], compute_queue_families[i],
+                        physical_devices_render_target_images[i], physical_devices_summed_images[i],
+                        physical_devices_animation_pipeline[i], physical_devices_animation_descriptor_sets[i], physical_devices_animation_pipeline_layout[i], animation_amount,
+                        aabbs, physical_devices_bottom_accel_build_infos[i], physical_devices_bottom_accels[i],
+                        physical_devices_top_accel_build_infos[i], get_per_frame_slot(physical_devices_top_accels[i], physical_devices_frame_slot_count[i]), top_accel_instance_count,
+                        physical_devices_timestamp_query_pool[i], !physical_devices_async_builds[i],
+                        physical_devices_dynamic_dispatch_loader[i]);
+                    physical_devices_tile_command_buffers[i] = vulkan::create_tile_command_buffers(
+                        devices[i], physical_devices_command_pool[i], physical_devices_frame_slot_count[i],
+                        tile_count, tile_height, width, height,
+                        compute_queue_families[i], physical_devices_render_target_images[i], physical_devices_readback_buffers[i],
+                        physical_devices_rt_pipeline[i], physical_devices_rt_descriptor_sets[i], physical_devices_rt_pipeline_layout[i],
+                        physical_devices_sbt_ray_gen_address_region[i], physical_devices_sbt_miss_address_region[i], physical_devices_sbt_hit_address_region[i],
+                        physical_devices_dynamic_dispatch_loader[i]);
+                }
+            );
+        }
+
+        auto physical_devices_build_command_buffers = same_size_container<std::vector<vk::CommandBuffer>>(physical_devices);
+        auto physical_devices_build_semaphores = same_size_container<std::vector<vk::Semaphore>>(physical_devices);
+        std::for_each(
+            std::execution::par,
+            physical_device_indices.begin(), physical_device_indices.end(),
+            [&devices, &physical_devices_async_builds, &physical_devices_command_pool, &physical_devices_frame_slot_count, compute_queue_families,
+            &physical_devices_animation_pipeline, &physical_devices_animation_descriptor_sets, &physical_devices_animation_pipeline_layout, animation_amount,
+            &aabbs, &physical_devices_bottom_accel_build_infos, &physical_devices_bottom_accels,
+            &physical_devices_top_accel_build_infos, &physical_devices_top_accels, top_accel_instance_count, &physical_devices_timestamp_query_pool,
+            &physical_devices_build_command_buffers, &physical_devices_build_semaphores, &physical_devices_dynamic_dispatch_loader,
+            &physical_devices_startup_timeline](auto i) {
+                if (!physical_devices_async_builds[i]) {
+                    return;
+                }
+                auto stage = startup::scoped_stage{ physical_devices_startup_timeline[i], "build command buffers" };
+                physical_devices_build_command_buffers[i] = vulkan::create_build_command_buffers(
+                    devices[i], physical_devices_command_pool[i], physical_devices_frame_slot_count[i], compute_queue_families[i],
+                    physical_devices_animation_pipeline[i], physical_devices_animation_descriptor_sets[i], physical_devices_animation_pipeline_layout[i], animation_amount,
+                    aabbs, physical_devices_bottom_accel_build_infos[i], physical_devices_bottom_accels[i],
+                    physical_devices_top_accel_build_infos[i], get_per_frame_slot(physical_devices_top_accels[i], physical_devices_frame_slot_count[i]), top_accel_instance_count,
+                    physical_devices_timestamp_query_pool[i], physical_devices_dynamic_dispatch_loader[i]);
+                physical_devices_build_semaphores[i] = vulkan::create_semaphores(devices[i], physical_devices_frame_slot_count[i]);
+            }
+        );
+
+        // Written by the device workers, read by the main thread once they are idle.
+        auto physical_devices_present_time = same_size_container<std::chrono::steady_clock::time_point>(physical_devices);
+        auto physical_devices_duration_of_gpu = same_size_container<std::chrono::steady_clock::duration>(physical_devices);
+        auto physical_devices_as_build_duration = same_size_container<std::chrono::nanoseconds>(physical_devices);
+        auto physical_devices_gather_duration = same_size_container<std::chrono::steady_clock::duration>(physical_devices);
+        // Rays traced per row of the strip of each device in the frames of the current segment gathered so far.
+        auto physical_devices_row_cost = same_size_container<std::vector<uint64_t>>(physical_devices);
         std::ranges::transform(
-            physical_device_indices,
-            physical_devices_next_image_semaphores_indices.begin(),
-            [&physical_devices_render_image_count](auto i) {
-                auto next_image_semaphores_indices = std::vector<uint32_t>(physical_devices_render_image_count[i]);
-                std::ranges::iota(next_image_semaphores_indices, 0);
-                return next_image_semaphores_indices;
+            physical_devices_render_extent,
+            physical_devices_row_cost.begin(),
+            [](auto& extent) {
+                return std::vector<uint64_t>(extent.y);
             }
         );
 
-        auto physical_devices_next_image_free_semaphore_index = same_size_container<uint32_t>(physical_devices);
-        physical_devices_next_image_free_semaphore_index = physical_devices_render_image_count;
+        // Tiles of each frame slot a device took in tile mode, and how many it took in the current segment.
+        auto physical_devices_slot_tiles = same_size_container<std::vector<std::vector<uint32_t>>>(physical_devices);
+        std::ranges::transform(
+            physical_devices_frame_slot_count,
+            physical_devices_slot_tiles.begin(),
+            [](auto frame_slot_count) {
+                return std::vector<std::vector<uint32_t>>(frame_slot_count);
+            }
+        );
+        auto physical_devices_taken_tile_count = same_size_container<uint32_t>(physical_devices);
 
-        while (!window::should_window_close(view_window)) {
-            auto physical_devices_present_time = same_size_container<std::chrono::steady_clock::time_point>(physical_devices);
-            std::ranges::generate(
-                physical_devices_present_time,
-                []() {
-                    return std::chrono::steady_clock::now();
+        // Samples each device rendered in each frame slot in sample split mode.
+        auto physical_devices_slot_samples = same_size_container<std::vector<uint32_t>>(physical_devices);
+        std::ranges::transform(
+            physical_devices_frame_slot_count,
+            physical_devices_slot_samples.begin(),
+            [](auto frame_slot_count) {
+                return std::vector<uint32_t>(frame_slot_count);
+            }
+        );
+
+        // Copies the strip, or the tiles, that device i read back in frame_slot to their rows of the
+        // composited image. The devices write disjoint rows, so their workers gather concurrently.
+        // In sample split mode it adds the summed image of the device to the sample sums instead,
+        // which only the main thread does once the frames are done.
+        auto gather_frame =
+            [&devices, &physical_devices_readback_buffers, &physical_devices_render_offset, &physical_devices_render_extent,
+            &physical_devices_slot_tiles, &composite_image, width, height, tile_count, tile_height,
+            sample_split, &sample_sums, &sample_sum_count, &physical_devices_slot_samples](uint32_t i, uint32_t frame_slot) {
+                auto& readback_buffer = physical_devices_readback_buffers[i][frame_slot];
+                auto data = static_cast<const uint8_t*>(devices[i].mapMemory(readback_buffer.memory, 0, vk::WholeSize));
+                // Row r of the image is row r - offset.y of the readback buffer.
+                auto copy_rows =
+                    [&composite_image, data, row_bytes = size_t{ width } * 4, first_buffer_row = physical_devices_render_offset[i].y](uint32_t first_row, uint32_t row_count) {
+                        memcpy(composite_image.data() + first_row * row_bytes, data + (first_row - first_buffer_row) * row_bytes, row_count * row_bytes);
+                    };
+                if (sample_split) {
+                    auto sums = reinterpret_cast<const float*>(data);
+                    std::transform(sample_sums.begin(), sample_sums.end(), sums, sample_sums.begin(), std::plus<float>{});
+                    sample_sum_count += physical_devices_slot_samples[i][frame_slot];
                 }
-            );
-            auto physical_devices_duration_of_gpu = same_size_container<std::chrono::steady_clock::duration>(physical_devices);
-            auto begin_time = std::chrono::steady_clock::now();
-            uint32_t frame_index = 0;
+                else if (tile_count == 0) {
+                    copy_rows(physical_devices_render_offset[i].y, physical_devices_render_extent[i].y);
+                }
+                else {
+                    std::ranges::for_each(
+                        physical_devices_slot_tiles[i][frame_slot],
+                        [&copy_rows, tile_height, height](auto tile_index) {
+                            copy_rows(tile_index * tile_height, vulkan::get_tile_row_count(tile_index, tile_height, height));
+                        }
+                    );
+                }
+                devices[i].unmapMemory(readback_buffer.memory);
+            };
 
-            while (!window::should_window_close(view_window)
-                && frame_index++ < benchmark_frame_count) {
-                auto cursor_pos = window::get_window_cursor_position(view_window);
-                scene = generateRandomScene();
-                std::ranges::transform(
-                    std::span{ scene.spheres, scene.sphereAmount },
-                    aabbs.begin(),
-                    [](auto& sphere) {
-                        auto getAABBFromSphere = [](const glm::vec4& geometry) {
-                            return vk::AabbPositionsKHR{
-                                    .minX = geometry.x - geometry.w,
-                                    .minY = geometry.y - geometry.w,
-                                    .minZ = geometry.z - geometry.w,
-                                    .maxX = geometry.x + geometry.w,
-                                    .maxY = geometry.y + geometry.w,
-                                    .maxZ = geometry.z + geometry.w
-                            };
-                            };
-                        return getAABBFromSphere(sphere.geometry);
+        // Adds the rays device i traced per row in frame_slot to its row costs.
+        auto gather_row_cost =
+            [&devices, &physical_devices_row_cost_buffers, &physical_devices_row_cost](uint32_t i, uint32_t frame_slot) {
+                auto& row_cost_buffer = physical_devices_row_cost_buffers[i][frame_slot];
+                auto& row_cost = physical_devices_row_cost[i];
+                auto data = static_cast<const uint32_t*>(devices[i].mapMemory(row_cost_buffer.memory, 0, vk::WholeSize));
+                std::transform(row_cost.begin(), row_cost.end(), data, row_cost.begin(), std::plus<uint64_t>{});
+                devices[i].unmapMemory(row_cost_buffer.memory);
+            };
+
+        // Tile mode: starts the frame in frame_slot, then takes tiles of the frame until none are left,
+        // queueing at most tiles_in_flight of them per tile queue, so a faster device takes more tiles of the same frame.
+        // Each tile goes to the tile queue with the fewest tiles pending.
+        constexpr uint64_t tiles_in_flight = 2;
+        // Tiles submitted to each tile queue of each device, the value the queue's tile timeline semaphore reaches.
+        auto physical_devices_tile_values = same_size_container<std::vector<uint64_t>>(physical_devices);
+        std::ranges::transform(
+            physical_devices_tile_queues,
+            physical_devices_tile_values.begin(),
+            [](auto& tile_queues) {
+                return std::vector<uint64_t>(tile_queues.size());
+            }
+        );
+        auto submit_tiles =
+            [&devices, &physical_devices_tile_queues, &physical_devices_tile_frame_command_buffers, &physical_devices_tile_command_buffers,
+            &physical_devices_tile_timeline_semaphores, &physical_devices_tile_values, &physical_devices_tile_start_semaphore,
+            &physical_devices_frame_timeline_semaphore,
+            &physical_devices_slot_tiles, &physical_devices_taken_tile_count, tile_count](uint32_t i, const frame_job& job, uint32_t frame_slot,
+                const std::vector<vk::Semaphore>& wait_semaphores, const std::vector<vk::PipelineStageFlags>& wait_stage_masks) {
+                auto& tile_queues = physical_devices_tile_queues[i];
+                auto& tile_semaphores = physical_devices_tile_timeline_semaphores[i];
+                auto& tile_values = physical_devices_tile_values[i];
+                auto& queue = tile_queues[0];
+
+                // The frame rebuilds what the tiles of the previous frame on the other tile queues may still read,
+                // so it waits for them, and signals the tiles of this frame on the other queues to start.
+                auto frame_wait_semaphores = wait_semaphores;
+                auto frame_wait_stage_masks = wait_stage_masks;
+                auto frame_wait_values = std::vector<uint64_t>(wait_semaphores.size());
+                for (uint32_t q = 1; q < tile_queues.size(); q++) {
+                    frame_wait_semaphores.push_back(tile_semaphores[q]);
+                    frame_wait_stage_masks.push_back(vk::PipelineStageFlagBits::eAllCommands);
+                    frame_wait_values.push_back(tile_values[q]);
+                }
+                auto frame_timeline_semaphore_submit_info = vk::TimelineSemaphoreSubmitInfo{}
+                    .setWaitSemaphoreValues(frame_wait_values)
+                    .setSignalSemaphoreValues(job.frame_value);
+                auto frame_submit_info = vk::SubmitInfo{}
+                    .setPNext(&frame_timeline_semaphore_submit_info)
+                    .setCommandBuffers(physical_devices_tile_frame_command_buffers[i][frame_slot])
+                    .setWaitSemaphores(frame_wait_semaphores)
+                    .setWaitDstStageMask(frame_wait_stage_masks)
+                    .setSignalSemaphores(physical_devices_tile_start_semaphore[i]);
+                if (queue.submit(1, &frame_submit_info, nullptr) != vk::Result::eSuccess) {
+                    throw std::runtime_error{ "failed to submit" };
+                }
+
+                auto& slot_tiles = physical_devices_slot_tiles[i][frame_slot];
+                slot_tiles.clear();
+                while (true) {
+                    // Only take a tile once a tile queue is down to one queued tile, the others are left to faster devices.
+                    auto q = vulkan::wait_least_busy_queue(devices[i], tile_semaphores, tile_values, tiles_in_flight);
+                    auto tile_index = job.next_tile->fetch_add(1, std::memory_order_relaxed);
+                    if (tile_index >= tile_count) {
+                        break;
                     }
-                );
+                    tile_values[q]++;
+                    auto timeline_semaphore_submit_info = vk::TimelineSemaphoreSubmitInfo{}
+                        .setSignalSemaphoreValues(tile_values[q]);
+                    auto tile_submit_info = vk::SubmitInfo{}
+                        .setPNext(&timeline_semaphore_submit_info)
+                        .setCommandBuffers(physical_devices_tile_command_buffers[i][frame_slot * tile_count + tile_index])
+                        .setSignalSemaphores(tile_semaphores[q]);
+                    // The first tile queue runs the tiles after the start of the frame anyway, the others wait for it.
+                    vk::PipelineStageFlags tile_wait_stage_mask = vk::PipelineStageFlagBits::eRayTracingShaderKHR;
+                    if (q > 0) {
+                        timeline_semaphore_submit_info.setWaitSemaphoreValues(job.frame_value);
+                        tile_submit_info
+                            .setWaitSemaphores(physical_devices_tile_start_semaphore[i])
+                            .setWaitDstStageMask(tile_wait_stage_mask);
+                    }
+                    if (tile_queues[q].submit(1, &tile_submit_info, nullptr) != vk::Result::eSuccess) {
+                        throw std::runtime_error{ "failed to submit" };
+                    }
+                    slot_tiles.push_back(tile_index);
+                }
+                physical_devices_taken_tile_count[i] += static_cast<uint32_t>(slot_tiles.size());
+
+                // Signaled once every earlier submission of the first tile queue and every tile on the others, so every tile of the frame, is done.
+                auto end_wait_semaphores = std::vector<vk::Semaphore>(tile_semaphores.begin() + 1, tile_semaphores.end());
+                auto end_wait_stage_masks = std::vector<vk::PipelineStageFlags>(end_wait_semaphores.size(), vk::PipelineStageFlagBits::eAllCommands);
+                auto end_wait_values = std::vector<uint64_t>(tile_values.begin() + 1, tile_values.end());
+                auto timeline_semaphore_submit_info = vk::TimelineSemaphoreSubmitInfo{}
+                    .setWaitSemaphoreValues(end_wait_values)
+                    .setSignalSemaphoreValues(job.frame_value);
+                auto end_submit_info = vk::SubmitInfo{}
+                    .setPNext(&timeline_semaphore_submit_info)
+                    .setWaitSemaphores(end_wait_semaphores)
+                    .setWaitDstStageMask(end_wait_stage_masks)
+                    .setSignalSemaphores(physical_devices_frame_timeline_semaphore[i]);
+                if (queue.submit(1, &end_submit_info, nullptr) != vk::Result::eSuccess) {
+                    throw std::runtime_error{ "failed to submit" };
+                }
+            };
+
+        // Everything a device does for a frame, from waiting for its frame slot to presenting.
+        // It runs on the worker of the device, which owns the device's queues from here on.
+        auto render_frame =
+            [&devices, &physical_devices_frame_slot_count, &physical_devices_frame_timeline_semaphore,
+            &physical_devices_timestamp_query_pool, &physical_devices_timestamp_period,
+            &physical_devices_acquire_image_semaphores, &physical_devices_swapchain, &physical_devices_swapchain_images,
+            samples, width, height, &physical_devices_render_offset, &physical_devices_render_call_info_buffers,
+            &physical_devices_compute_queue, &physical_devices_command_buffers,
+            &physical_devices_build_queue, &physical_devices_build_command_buffers, &physical_devices_build_semaphores,
+            &physical_devices_render_image_semaphores, &physical_devices_present_queue,
+            &physical_devices_present_time, &physical_devices_duration_of_gpu, &physical_devices_as_build_duration,
+            &physical_devices_startup_timeline,
+            &gather_frame, &physical_devices_gather_duration, &submit_tiles, tile_count,
+            &gather_row_cost, record_row_cost, strip_mode, sample_split, &physical_devices_samples, &physical_devices_slot_samples](uint32_t i, const frame_job& job) {
+                auto frame_begin_time = std::chrono::steady_clock::now();
+                auto frame_value = job.frame_value;
+                auto frame_slot_count = physical_devices_frame_slot_count[i];
+                auto frame_slot = static_cast<uint32_t>((frame_value - 1) % frame_slot_count);
+
+                // Wait for the frame that last used the slot, after which its acquire semaphore,
+                // command buffers, scene copy and timestamps are free again.
+                if (frame_value > frame_slot_count) {
+                    vulkan::wait_timeline_semaphore(devices[i], physical_devices_frame_timeline_semaphore[i], frame_value - frame_slot_count);
+                    auto build_duration = vulkan::get_acceleration_structure_build_duration(devices[i],
+                        physical_devices_timestamp_query_pool[i], frame_slot, physical_devices_timestamp_period[i]);
+                    physical_devices_as_build_duration[i] += build_duration.value_or(std::chrono::nanoseconds{ 0 });
+
+                    // The GPU works on the other frame slots meanwhile. Only the last frame is
+                    // gathered in sample split mode, as the samples of all devices add up to it.
+                    if (!sample_split) {
+                        auto gather_begin_time = std::chrono::steady_clock::now();
+                        gather_frame(i, frame_slot);
+                        physical_devices_gather_duration[i] += std::chrono::steady_clock::now() - gather_begin_time;
+                    }
+                    if (record_row_cost) {
+                        gather_row_cost(i, frame_slot);
+                    }
+                }
 
-                auto [x, y] = cursor_pos;
-                x /= 500.0;
-                y /= 500.0;
-                auto camera_dir = glm::vec3{ sin(x) * cos(y), -sin(y), cos(x) * cos(y) };
+                uint32_t swapchain_image_index = 0;
+                auto acquire_image_semaphore = physical_devices_acquire_image_semaphores[i][frame_slot];
+                // Tiles and sample splits are only composited on the host, nothing is acquired or presented.
+                if (strip_mode) {
+                    if (auto [result, index] = devices[i].acquireNextImageKHR(physical_devices_swapchain[i], UINT64_MAX, acquire_image_semaphore);
+                        result == vk::Result::eSuccess || result == vk::Result::eSuboptimalKHR) {
+                        swapchain_image_index = index;
+                    }
+                    else {
+                        throw std::runtime_error{ "failed to acquire next image" };
+                    }
+                }
+                physical_devices_duration_of_gpu[i] += std::chrono::steady_clock::now() - physical_devices_present_time[i];
 
                 {
-                    auto spheres = std::span{ scene.spheres, scene.sphereAmount };
-
-                    auto physical_devices_acquire_image_time = same_size_container<std::chrono::steady_clock::time_point>(physical_devices);
-                    auto physical_devices_swapchain_image_index = same_size_container<uint32_t>(physical_devices);
-                    auto physical_devices_acquire_image_semaphore = same_size_container<vk::Semaphore>(physical_devices);
-                    std::for_each(
-                        std::execution::par_unseq,
-                        physical_device_indices.begin(), physical_device_indices.end(),
-                        [&physical_devices_swapchain_image_index,
-                        &physical_devices_acquire_image_semaphore,
-                        &devices,
-                        &physical_devices_next_image_semaphores, &physical_devices_swapchain,
-                        &physical_devices_next_image_free_semaphore_index, &physical_devices_next_image_semaphores_indices,
-                        &physical_devices_acquire_image_time](auto i) {
-                            uint32_t swapchain_image_index = 0;
-                            auto acquire_image_semaphore = physical_devices_next_image_semaphores[i][physical_devices_next_image_free_semaphore_index[i]];
-                            if (auto [result, index] = devices[i].acquireNextImageKHR(physical_devices_swapchain[i], UINT64_MAX, acquire_image_semaphore);
-                                result == vk::Result::eSuccess || result == vk::Result::eSuboptimalKHR) {
-                                swapchain_image_index = index;
-                            }
-                            else {
-                                throw std::runtime_error{ "failed to acquire next image" };
-                            }
-                            physical_devices_acquire_image_time[i] = std::chrono::steady_clock::now();
-                            std::swap(physical_devices_next_image_free_semaphore_index[i], physical_devices_next_image_semaphores_indices[i][swapchain_image_index]);
-                            physical_devices_acquire_image_semaphore[i] = acquire_image_semaphore;
-                            physical_devices_swapchain_image_index[i] = swapchain_image_index;
-                        }
-                    );
-                    std::ranges::for_each(
-                        physical_device_indices,
-                        [&physical_devices_acquire_image_time,
-                        &physical_devices_present_time,
-                        &physical_devices_duration_of_gpu](auto i) {
-                            auto duration = physical_devices_acquire_image_time[i] - physical_devices_present_time[i];
-                            physical_devices_duration_of_gpu[i] += duration;
-                        }
-                    );
+                    // In sample split mode the devices take consecutive ranges of the samples of every pixel.
+                    auto first_sample = std::accumulate(physical_devices_samples.begin(), physical_devices_samples.begin() + i, 0u);
+                    physical_devices_slot_samples[i][frame_slot] = sample_split ? physical_devices_samples[i] : samples;
+                    RenderCallInfo renderCallInfo = {
+                        .number = sample_split ? first_sample : 0,
+                        .samplesPerRenderCall = physical_devices_slot_samples[i][frame_slot],
+                        .offset = physical_devices_render_offset[i],
+                        .image_size = {width, height},
+                        .time = job.animation_time,
+                        .record_row_cost = record_row_cost,
+                        .camera_pos = {13.0f, 11.0f, -3.0f, 0},
+                        .camera_dir = {-13.0f, -11.0f, 3.0f, 0},
+                    };
+                    auto& render_call_info_buffer = physical_devices_render_call_info_buffers[i][frame_slot];
+                    void* data = devices[i].mapMemory(render_call_info_buffer.memory, 0, sizeof(RenderCallInfo));
+                    memcpy(data, &renderCallInfo, sizeof(RenderCallInfo));
+                    devices[i].unmapMemory(render_call_info_buffer.memory);
+                }
 
-                    std::ranges::for_each(
-                        physical_device_indices,
-                        [&devices, &physical_devices_fences, &physical_devices_swapchain_image_index](auto i) {
-                            auto fence = physical_devices_fences[i][physical_devices_swapchain_image_index[i]];
-                            {
-                                vk::Result res = devices[i].waitForFences(fence, true, UINT64_MAX);
-                                if (res != vk::Result::eSuccess) {
-                                    throw std::runtime_error{ "failed to wait fences" };
-                                }
-                            }
-                            devices[i].resetFences(fence);
-                        }
-                    );
+                auto render_image_semaphore = physical_devices_render_image_semaphores[i][swapchain_image_index];
+                {
+                    auto wait_semaphores = std::vector<vk::Semaphore>{};
+                    auto wait_stage_masks = std::vector<vk::PipelineStageFlags>{};
+                    if (strip_mode) {
+                        wait_semaphores.push_back(acquire_image_semaphore);
+                        wait_stage_masks.push_back(vk::PipelineStageFlagBits::eAllCommands);
+                    }
 
-                    std::ranges::for_each(
-                        physical_device_indices,
-                        [&devices, &physical_devices_swapchain_image_index, samples, width, height, &physical_devices_render_offset,
-                        &physical_devices_render_call_info_buffers, &camera_dir](auto i) {
-                            RenderCallInfo renderCallInfo = {
-                                .number = 0,
-                                .samplesPerRenderCall = samples,
-                                .offset = physical_devices_render_offset[i],
-                                .image_size = {width, height},
-                                .camera_pos = {13.0f, 11.0f, -3.0f, 0},
-                                .camera_dir = {-13.0f, -11.0f, 3.0f, 0},
-                            };
-                            void* data = devices[i].mapMemory(physical_devices_render_call_info_buffers[i][physical_devices_swapchain_image_index[i]].memory, 0, sizeof(RenderCallInfo));
-                            memcpy(data, &renderCallInfo, sizeof(RenderCallInfo));
-                            devices[i].unmapMemory(physical_devices_render_call_info_buffers[i][physical_devices_swapchain_image_index[i]].memory);
+                    // The builds of this frame run on the build queue, overlapping the trace of
+                    // the previous frame, and only the trace waits for them.
+                    if (!physical_devices_build_command_buffers[i].empty()) {
+                        auto build_semaphore = physical_devices_build_semaphores[i][frame_slot];
+                        auto build_submit_info = vk::SubmitInfo{}
+                            .setCommandBuffers(physical_devices_build_command_buffers[i][frame_slot])
+                            .setSignalSemaphores(build_semaphore);
+                        auto res = physical_devices_build_queue[i].submit(1, &build_submit_info, nullptr);
+                        if (res != vk::Result::eSuccess) {
+                            throw std::runtime_error{ "failed to submit" };
                         }
-                    );
+                        wait_semaphores.push_back(build_semaphore);
+                        wait_stage_masks.push_back(vk::PipelineStageFlagBits::eRayTracingShaderKHR);
+                    }
 
-                    std::ranges::for_each(
-                        physical_device_indices,
-                        [&devices, &aabbs, &physical_devices_aabb_buffers, &physical_devices_swapchain_image_index, &physical_devices_sphere_buffers, &spheres](auto i) {
-                            vulkan::update_accel_structures_data(devices[i],
-                                aabbs, physical_devices_aabb_buffers[i][physical_devices_swapchain_image_index[i]],
-                                physical_devices_sphere_buffers[i][physical_devices_swapchain_image_index[i]], spheres.size_bytes(), spheres);
+                    if (tile_count > 0) {
+                        submit_tiles(i, job, frame_slot, wait_semaphores, wait_stage_masks);
+                    }
+                    else if (sample_split) {
+                        auto timeline_semaphore_submit_info = vk::TimelineSemaphoreSubmitInfo{}
+                            .setSignalSemaphoreValues(frame_value);
+                        auto submitInfo = vk::SubmitInfo{}
+                            .setPNext(&timeline_semaphore_submit_info)
+                            .setCommandBuffers(physical_devices_command_buffers[i][frame_slot])
+                            .setWaitSemaphores(wait_semaphores)
+                            .setWaitDstStageMask(wait_stage_masks)
+                            .setSignalSemaphores(physical_devices_frame_timeline_semaphore[i]);
+                        if (physical_devices_compute_queue[i].submit(1, &submitInfo, nullptr) != vk::Result::eSuccess) {
+                            throw std::runtime_error{ "failed to submit" };
                         }
-                    );
-
-                    std::for_each(
-                        std::execution::par_unseq,
-                        physical_device_indices.begin(), physical_device_indices.end(),
-                        [&physical_devices_compute_queue, &physical_devices_command_buffers,
-                        &physical_devices_render_image_semaphores, &physical_devices_swapchain_image_index,
-                        &physical_devices_acquire_image_semaphore, &physical_devices_fences](auto i) {
-                            auto swapchain_image_index = physical_devices_swapchain_image_index[i];
-                            auto render_image_semaphore = physical_devices_render_image_semaphores[i][swapchain_image_index];
-
-                            auto wait_semaphores = std::array{ physical_devices_acquire_image_semaphore[i] };
-                            auto  wait_stage_masks =
-                                std::array<vk::PipelineStageFlags, 1>{ vk::PipelineStageFlagBits::eAllCommands };
-                            auto signal_semaphores = std::array{ render_image_semaphore };
-                            auto submitInfo = vk::SubmitInfo{}
-                                .setCommandBuffers(physical_devices_command_buffers[i][swapchain_image_index])
-                                .setWaitSemaphores(wait_semaphores)
-                                .setWaitDstStageMask(wait_stage_masks)
-                                .setSignalSemaphores(signal_semaphores);
-
-                            auto res = physical_devices_compute_queue[i].submit(1, &submitInfo, physical_devices_fences[i][swapchain_image_index]);
-                            if (res != vk::Result::eSuccess) {
-                                throw std::runtime_error{ "failed to submit" };
-                            }
+                    }
+                    else {
+                        // The value of the binary present semaphore is ignored.
+                        auto signal_semaphores = std::array{ render_image_semaphore, physical_devices_frame_timeline_semaphore[i] };
+                        auto signal_semaphore_values = std::array<uint64_t, 2>{ 0, frame_value };
+                        auto timeline_semaphore_submit_info = vk::TimelineSemaphoreSubmitInfo{}
+                            .setSignalSemaphoreValues(signal_semaphore_values);
+                        auto swapchain_image_count = static_cast<uint32_t>(physical_devices_swapchain_images[i].size());
+                        auto submitInfo = vk::SubmitInfo{}
+                            .setPNext(&timeline_semaphore_submit_info)
+                            .setCommandBuffers(physical_devices_command_buffers[i][frame_slot * swapchain_image_count + swapchain_image_index])
+                            .setWaitSemaphores(wait_semaphores)
+                            .setWaitDstStageMask(wait_stage_masks)
+                            .setSignalSemaphores(signal_semaphores);
+
+                        auto res = physical_devices_compute_queue[i].submit(1, &submitInfo, nullptr);
+                        if (res != vk::Result::eSuccess) {
+                            throw std::runtime_error{ "failed to submit" };
                         }
-                    );
+                    }
+                }
 
-                    std::for_each(
-                        std::execution::par_unseq,
-                        physical_device_indices.begin(), physical_device_indices.end(),
-                        [&physical_devices_present_queue,
-                        &physical_devices_render_image_semaphores, &physical_devices_swapchain, &physical_devices_swapchain_image_index,
-                        &physical_devices_present_time](auto i) {
-                            auto present_queue = physical_devices_present_queue[i];
-                            auto swapchain_image_index = physical_devices_swapchain_image_index[i];
-                            vk::PresentInfoKHR presentInfo = {
-                                    .waitSemaphoreCount = 1,
-                                    .pWaitSemaphores = &physical_devices_render_image_semaphores[i][swapchain_image_index],
-                                    .swapchainCount = 1,
-                                    .pSwapchains = &physical_devices_swapchain[i],
-                                    .pImageIndices = &swapchain_image_index
-                            };
-
-                            auto res = present_queue.presentKHR(presentInfo);
-                            if (res != vk::Result::eSuccess) {
-                                std::cerr << "present return: " << res << std::endl;
-                            }
-                            physical_devices_present_time[i] = std::chrono::steady_clock::now();
-                        }
-                    );
+                if (strip_mode) {
+                    vk::PresentInfoKHR presentInfo = {
+                            .waitSemaphoreCount = 1,
+                            .pWaitSemaphores = &render_image_semaphore,
+                            .swapchainCount = 1,
+                            .pSwapchains = &physical_devices_swapchain[i],
+                            .pImageIndices = &swapchain_image_index
+                    };
+
+                    auto res = physical_devices_present_queue[i].presentKHR(presentInfo);
+                    if (res != vk::Result::eSuccess) {
+                        std::cerr << "present return: " << res << std::endl;
+                    }
+                }
+                physical_devices_present_time[i] = std::chrono::steady_clock::now();
+                if (frame_value == 1) {
+                    startup::add_stage(physical_devices_startup_timeline[i], { "first frame", frame_begin_time, physical_devices_present_time[i] });
+                }
+            };
+
+        // One worker per device, so a slow device does not delay the frames of the others
+        // until it falls device_worker::queue_capacity frames behind.
+        auto physical_devices_worker = same_size_container<device_worker::worker<frame_job>>(physical_devices);
+        std::ranges::for_each(
+            physical_device_indices,
+            [&physical_devices_worker, &render_frame](uint32_t i) {
+                device_worker::start<frame_job>(physical_devices_worker[i],
+                    [&render_frame, i](const frame_job& job) {
+                        render_frame(i, job);
+                    });
+            }
+        );
+
+        uint64_t submitted_frame_count = 0;
+        bool startup_reported = false;
+        // Tile counters of the frames in flight. Workers are at most device_worker::queue_capacity + 1
+        // frames apart, so a counter is free again when its frame comes round.
+        auto next_tiles = std::array<std::atomic<uint32_t>, 2 * device_worker::queue_capacity>{};
+
+        while (!should_stop()) {
+            std::ranges::generate(
+                physical_devices_present_time,
+                []() {
+                    return std::chrono::steady_clock::now();
                 }
+            );
+            std::ranges::fill(physical_devices_duration_of_gpu, std::chrono::steady_clock::duration{ 0 });
+            std::ranges::fill(physical_devices_as_build_duration, std::chrono::nanoseconds{ 0 });
+            std::ranges::fill(physical_devices_gather_duration, std::chrono::steady_clock::duration{ 0 });
+            std::ranges::fill(physical_devices_taken_tile_count, 0);
+            std::ranges::for_each(physical_devices_row_cost, [](auto& row_cost) { std::ranges::fill(row_cost, 0); });
+            auto begin_time = std::chrono::steady_clock::now();
+            uint32_t frame_index = 0;
+
+            while (!should_stop()
+                && frame_index++ < benchmark_frame_count) {
+                rendered_frame_count++;
+                auto animation_time = std::chrono::duration<float>(std::chrono::steady_clock::now() - animation_start_time).count();
+
+                ++submitted_frame_count;
+                auto& next_tile = next_tiles[submitted_frame_count % next_tiles.size()];
+                next_tile.store(0, std::memory_order_relaxed);
+                auto job = frame_job{
+                    .frame_value = submitted_frame_count,
+                    .animation_time = animation_time,
+                    .next_tile = &next_tile
+                };
+                std::ranges::for_each(
+                    physical_devices_worker,
+                    [&job](auto& worker) {
+                        device_worker::push(worker, job);
+                    }
+                );
 
                 window::poll_events(window_system);
             }
+            std::ranges::for_each(
+                physical_devices_worker,
+                [](auto& worker) {
+                    device_worker::wait_idle(worker);
+                }
+            );
+            if (!startup_reported) {
+                std::ranges::for_each(
+                    physical_device_indices,
+                    [&physical_devices_startup_timeline](auto i) {
+                        std::cout << "startup[" << i << "]: ";
+                        startup::print_timeline(std::cout, physical_devices_startup_timeline[i]);
+                        std::cout << std::endl;
+                    }
+                );
+                startup_reported = true;
+            }
 
             auto end_time = std::chrono::steady_clock::now();
             auto duration = end_time - begin_time;
             auto frame_count = frame_index;
             auto duration_per_frame = duration / frame_count;
             std::cout << "duration_per_frame: " << duration_per_frame << std::endl;
+            // Primary rays only, secondary bounces depend on the scene.
+            auto seconds_per_frame = std::chrono::duration<double>(duration_per_frame).count();
+            std::cout << "primary_rays_per_second: " << static_cast<uint64_t>(double(width) * height * samples / seconds_per_frame) << std::endl;
+            std::ranges::for_each(
+                physical_device_indices,
+                [&physical_devices_as_build_duration, frame_count](auto i) {
+                    std::cout << "as_build_time_per_frame[" << i << "]: "
+                        << std::chrono::duration_cast<std::chrono::microseconds>(physical_devices_as_build_duration[i] / frame_count) << std::endl;
+                }
+            );
+            std::ranges::for_each(
+                physical_device_indices,
+                [&physical_devices_gather_duration, frame_count](auto i) {
+                    std::cout << "gather_time_per_frame[" << i << "]: "
+                        << std::chrono::duration_cast<std::chrono::microseconds>(physical_devices_gather_duration[i] / frame_count) << std::endl;
+                }
+            );
+            if (tile_count > 0) {
+                std::ranges::for_each(
+                    physical_device_indices,
+                    [&physical_devices_taken_tile_count, frame_count](auto i) {
+                        std::cout << "tiles_per_frame[" << i << "]: " << static_cast<double>(physical_devices_taken_tile_count[i]) / frame_count << std::endl;
+                    }
+                );
+            }
+            if (sample_split) {
+                std::ranges::for_each(
+                    physical_device_indices,
+                    [&physical_devices_samples](auto i) {
+                        std::cout << "samples_per_frame[" << i << "]: " << physical_devices_samples[i] << std::endl;
+                    }
+                );
+            }
 
             using namespace std::literals;
             benchmark_frame_count = (4s + 50 * duration_per_frame) / duration_per_frame;
 
+            // Tiles balance the devices within every frame, there are no strips to tune.
+            if (tile_count > 0) {
+                continue;
+            }
+
             auto frame_info = tune::frame_info{
                 .workload_distribution = std::vector<uint32_t>(physical_devices.size()),
                 .duration = duration_per_frame,
@@ -754,15 +1665,33 @@ void ray_trace_with_physical_devices(
             };
             std::ranges::for_each(
                 physical_device_indices,
-                [&frame_info, &physical_devices_render_extent, &physical_devices_duration_of_gpu, frame_count](auto i) {
-                    frame_info.workload_distribution[i] = physical_devices_render_extent[i].y;
+                [&frame_info, &physical_devices_render_extent, &physical_devices_duration_of_gpu, frame_count, sample_split, &physical_devices_samples](auto i) {
+                    frame_info.workload_distribution[i] = sample_split ? physical_devices_samples[i] : physical_devices_render_extent[i].y;
                     frame_info.estimated_gpu_duration[i] = physical_devices_duration_of_gpu[i] / frame_count;
                 }
             );
+            if (record_row_cost) {
+                auto row_cost = std::vector<double>(height);
+                std::ranges::for_each(
+                    physical_device_indices,
+                    [&row_cost, &physical_devices_row_cost, &physical_devices_render_offset](auto i) {
+                        std::ranges::copy(physical_devices_row_cost[i], row_cost.begin() + physical_devices_render_offset[i].y);
+                    }
+                );
+                tune::set_row_cost(tuning_info, std::move(row_cost));
+                if (!tuning_info.row_cost.empty()) {
+                    auto [min_cost, max_cost] = std::ranges::minmax(tuning_info.row_cost);
+                    std::cout << "row_cost: " << min_cost << " to " << max_cost << " of the mean" << std::endl;
+                }
+            }
             tune::add_frame_info(tuning_info, std::move(frame_info));
 
             auto opt_next_workload_distribution = tune::get_workload(tuning_info);
-            if (opt_next_workload_distribution) {
+            // The samples only go into the render call infos, so the frames go on without rebuilding anything.
+            if (opt_next_workload_distribution && sample_split) {
+                std::ranges::copy(opt_next_workload_distribution.value(), physical_devices_samples.begin());
+            }
+            else if (opt_next_workload_distribution) {
                 auto& next_workload_distribution = opt_next_workload_distribution.value();
                 std::ranges::transform(
                     next_workload_distribution,
@@ -775,6 +1704,13 @@ void ray_trace_with_physical_devices(
             }
         }
 
+        std::ranges::for_each(
+            physical_devices_worker,
+            [](auto& worker) {
+                device_worker::stop(worker);
+            }
+        );
+
         std::ranges::for_each(
             devices,
             [](auto& device) {
@@ -782,6 +1718,33 @@ void ray_trace_with_physical_devices(
             }
         );
 
+        // The last frame was not gathered by the workers yet.
+        if (submitted_frame_count > 0) {
+            std::ranges::fill(sample_sums, 0.0f);
+            sample_sum_count = 0;
+            std::ranges::for_each(
+                physical_device_indices,
+                [&gather_frame, &physical_devices_frame_slot_count, submitted_frame_count](auto i) {
+                    gather_frame(i, static_cast<uint32_t>((submitted_frame_count - 1) % physical_devices_frame_slot_count[i]));
+                }
+            );
+        }
+        // The same tone mapping as the ray generation shader, over the samples of all devices.
+        if (sample_split && sample_sum_count > 0) {
+            for (size_t texel = 0; texel < sample_sums.size(); texel++) {
+                composite_image[texel] = texel % 4 == 3
+                    ? 255
+                    : static_cast<uint8_t>(std::lround(std::clamp(std::sqrt(sample_sums[texel] / sample_sum_count), 0.0f, 1.0f) * 255));
+            }
+        }
+
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_readback_buffers, &physical_devices_row_cost_buffers](auto i) {
+                std::ranges::for_each(physical_devices_readback_buffers[i], [device = devices[i]](auto buffer) {vulkan::destroy_buffer(device, buffer); });
+                std::ranges::for_each(physical_devices_row_cost_buffers[i], [device = devices[i]](auto buffer) {vulkan::destroy_buffer(device, buffer); });
+            });
+
         std::ranges::for_each(
             physical_device_indices,
             [&devices, &physical_devices_shader_binding_table_buffer](auto i) {
@@ -799,6 +1762,45 @@ void ray_trace_with_physical_devices(
                 devices[i].destroyPipelineLayout(physical_devices_rt_pipeline_layout[i]);
             });
 
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_animation_pipeline](auto i) {
+                devices[i].destroyPipeline(physical_devices_animation_pipeline[i]);
+            });
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_animation_pipeline_layout](auto i) {
+                devices[i].destroyPipelineLayout(physical_devices_animation_pipeline_layout[i]);
+            });
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_timestamp_query_pool](auto i) {
+                devices[i].destroyQueryPool(physical_devices_timestamp_query_pool[i]);
+            });
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_animation_descriptor_pool](auto i) {
+                devices[i].destroyDescriptorPool(physical_devices_animation_descriptor_pool[i]);
+            });
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_animation_descriptor_set_layout](auto i) {
+                devices[i].destroyDescriptorSetLayout(physical_devices_animation_descriptor_set_layout[i]);
+            });
+        if (animation_amount > 0) {
+            std::ranges::for_each(
+                physical_device_indices,
+                [&devices, &physical_devices_animation_buffer](auto i) {
+                    vulkan::destroy_buffer(devices[i], physical_devices_animation_buffer[i]);
+                });
+        }
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_sphere_material_index_buffer, &physical_devices_material_buffer](auto i) {
+                vulkan::destroy_buffer(devices[i], physical_devices_sphere_material_index_buffer[i]);
+                vulkan::destroy_buffer(devices[i], physical_devices_material_buffer[i]);
+            });
+
         std::ranges::for_each(
             physical_device_indices,
             [&devices, &physical_devices_render_call_info_buffers](auto i) {
@@ -841,6 +1843,22 @@ void ray_trace_with_physical_devices(
                     });
             });
 
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_mesh_bottom_accels, &physical_devices_dynamic_dispatch_loader](auto i) {
+                std::ranges::for_each(physical_devices_mesh_bottom_accels[i],
+                    [device = devices[i], &dynamicDispatchLoader = physical_devices_dynamic_dispatch_loader[i]](auto bottom_accel) {
+                        vulkan::destroy_acceleration_structure(device, bottom_accel, dynamicDispatchLoader);
+                    });
+            });
+        std::ranges::for_each(
+            physical_device_indices,
+            [&devices, &physical_devices_mesh_vertex_buffer, &physical_devices_mesh_index_buffer, &physical_devices_mesh_instance_buffer](auto i) {
+                vulkan::destroy_buffer(devices[i], physical_devices_mesh_vertex_buffer[i]);
+                vulkan::destroy_buffer(devices[i], physical_devices_mesh_index_buffer[i]);
+                vulkan::destroy_buffer(devices[i], physical_devices_mesh_instance_buffer[i]);
+            });
+
         std::ranges::for_each(
             physical_device_indices,
             [&devices, &physical_devices_aabb_buffers](auto i) {
@@ -852,10 +1870,13 @@ void ray_trace_with_physical_devices(
 
         std::ranges::for_each(
             physical_device_indices,
-            [&physical_devices_next_image_semaphores, &devices](auto i) {
-                auto& next_image_semaphores = physical_devices_next_image_semaphores[i];
-                auto& device = devices[i];
-                std::ranges::for_each(next_image_semaphores, [device](auto semaphore) {device.destroySemaphore(semaphore); });
+            [&physical_devices_acquire_image_semaphores, &devices](auto i) {
+                std::ranges::for_each(physical_devices_acquire_image_semaphores[i], [device = devices[i]](auto semaphore) {device.destroySemaphore(semaphore); });
+            });
+        std::ranges::for_each(
+            physical_device_indices,
+            [&physical_devices_build_semaphores, &devices](auto i) {
+                std::ranges::for_each(physical_devices_build_semaphores[i], [device = devices[i]](auto semaphore) {device.destroySemaphore(semaphore); });
             });
         std::ranges::for_each(
             physical_device_indices,
@@ -866,10 +1887,10 @@ void ray_trace_with_physical_devices(
             });
         std::ranges::for_each(
             physical_device_indices,
-            [&physical_devices_fences, &devices](auto i) {
-                auto& fences = physical_devices_fences[i];
-                auto& device = devices[i];
-                std::ranges::for_each(fences, [device](auto fence) {device.destroyFence(fence); });
+            [&physical_devices_frame_timeline_semaphore, &physical_devices_tile_timeline_semaphores, &physical_devices_tile_start_semaphore, &devices](auto i) {
+                devices[i].destroySemaphore(physical_devices_frame_timeline_semaphore[i]);
+                std::ranges::for_each(physical_devices_tile_timeline_semaphores[i], [device = devices[i]](auto semaphore) {device.destroySemaphore(semaphore); });
+                devices[i].destroySemaphore(physical_devices_tile_start_semaphore[i]);
             });
 
         std::ranges::for_each(
@@ -917,6 +1938,19 @@ void ray_trace_with_physical_devices(
 
     window::destroy_window(view_window);
 
+    if (use_workload_cache) {
+        if (auto cached = tune::get_cached_workload(tuning_info)) {
+            tune::store_cached_workload(workload_cache_path, workload_cache_key, cached.value());
+            std::cout << "workload_cache: stored to " << workload_cache_path << std::endl;
+        }
+    }
+
+    if (store_render_result) {
+        if (!stbi_write_png("render_result.png", static_cast<int>(width), static_cast<int>(height), 4, composite_image.data(), static_cast<int>(width * 4))) {
+            throw std::runtime_error("[Error] failed to store render_result.png");
+        }
+        std::cout << "stored: render_result.png" << std::endl;
+    }
 }
 
 extern "C"
@@ -928,8 +1962,50 @@ void ray_trace(
     bool storeRenderResult,
     uint32_t width,
     uint32_t height,
-    uint32_t gpu_count
+    uint32_t gpu_count,
+    const char* scene_path,
+    const char* const* mesh_specs,
+    uint32_t mesh_spec_count,
+    uint32_t sphere_mode,
+    uint32_t icosphere_subdivision,
+    uint32_t max_frames,
+    bool host_blas_builds,
+    uint32_t frames_in_flight,
+    uint32_t tiles,
+    const char* workload_cache_path,
+    bool cost_map,
+    bool sample_split,
+    uint32_t queues
 ) {
+    auto scene_load_begin_time = std::chrono::steady_clock::now();
+    auto scene = scene_path ? loadScene(scene_path) : generateRandomScene();
+    std::cout << "scene: " << scene.spheres.size() << " spheres, " << scene.materials.size() << " materials, " << scene.animations.size() << " animations, loaded in "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - scene_load_begin_time) << std::endl;
+
+    auto mesh_scene = MeshScene{};
+    std::for_each(mesh_specs, mesh_specs + mesh_spec_count, [&mesh_scene](auto spec) { addMeshInstance(mesh_scene, spec); });
+    if (mesh_spec_count > 0) {
+        std::cout << "meshes: " << mesh_scene.meshes.size() << " meshes, " << mesh_scene.instances.size() << " instances, "
+            << mesh_scene.indices.size() / 3 << " triangles" << std::endl;
+    }
+    if (sphere_mode > static_cast<uint32_t>(SphereMode::Icosphere)) {
+        throw std::runtime_error("[Error] unknown sphere mode");
+    }
+    auto mode = static_cast<SphereMode>(sphere_mode);
+    uint32_t icosphere_mesh_index = 0;
+    if (mode == SphereMode::Icosphere) {
+        icosphere_mesh_index = addIcosphere(mesh_scene, icosphere_subdivision);
+        std::cout << "icosphere: " << mesh_scene.meshes[icosphere_mesh_index].indexCount / 3 << " triangles per sphere" << std::endl;
+    }
+
+    auto scene_fingerprint = fingerprint_scene(scene, mesh_scene, mode);
+    if (tiles > 0 && sample_split) {
+        throw std::runtime_error("[Error] tiles and sample split exclude each other");
+    }
+    if (queues == 0) {
+        throw std::runtime_error("[Error] need at least one queue per GPU");
+    }
+
     auto window_system = window::init_window_system();
 
     // SETUP
@@ -950,21 +2026,26 @@ void ray_trace(
 
     auto instance = vulkan::create_instance(required_extensions);
 
-    auto physical_devices = vulkan::pick_physical_devices(instance, Vulkan::get_required_device_extensions());
-    if (physical_devices.size() > gpu_count) {
-        physical_devices.resize(gpu_count);
+    auto [physical_devices, physical_device_picks] = vulkan::pick_physical_devices(instance, Vulkan::get_required_device_extensions(), gpu_count);
+    for (uint32_t i = 0; i < physical_device_picks.size(); i++) {
+        auto& pick = physical_device_picks[i];
+        std::cout << "gpu[" << i << "]: " << pick.name << " " << pick.identity;
+        if (pick.group_size > 1) {
+            std::cout << " in device group " << pick.group << " of " << pick.group_size << " linked GPUs";
+        }
+        std::cout << (pick.skip_reason.empty() ? ", picked" : ", skipped: " + pick.skip_reason) << std::endl;
     }
     if (physical_devices.size() == 0) {
         throw std::runtime_error{ "No GPUs with required extensions" };
     }
     if (physical_devices.size() == 1) {
-        ray_trace_with_physical_devices(samples, width, height, window_system, instance, std::array{ physical_devices[0] });
+        ray_trace_with_physical_devices(samples, storeRenderResult, width, height, window_system, instance, std::array{ physical_devices[0] }, scene, mesh_scene, mode, icosphere_mesh_index, max_frames, host_blas_builds, frames_in_flight, tiles, queues, sample_split, cost_map, workload_cache_path, scene_fingerprint);
     }
     else if (physical_devices.size() == 2) {
-        ray_trace_with_physical_devices(samples, width, height, window_system, instance, std::array{ physical_devices[0], physical_devices[1] });
+        ray_trace_with_physical_devices(samples, storeRenderResult, width, height, window_system, instance, std::array{ physical_devices[0], physical_devices[1] }, scene, mesh_scene, mode, icosphere_mesh_index, max_frames, host_blas_builds, frames_in_flight, tiles, queues, sample_split, cost_map, workload_cache_path, scene_fingerprint);
     }
     else {
-        ray_trace_with_physical_devices(samples, width, height, window_system, instance, physical_devices);
+        ray_trace_with_physical_devices(samples, storeRenderResult, width, height, window_system, instance, physical_devices, scene, mesh_scene, mode, icosphere_mesh_index, max_frames, host_blas_builds, frames_in_flight, tiles, queues, sample_split, cost_map, workload_cache_path, scene_fingerprint);
     }
 
     instance.destroy();
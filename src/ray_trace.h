@@ -11,5 +11,18 @@ void ray_trace(
     bool storeRenderResult = false,
     uint32_t width = 1920,
     uint32_t height = 1080,
-    uint32_t gpu_count = 1
+    uint32_t gpu_count = 1,
+    const char* scene_path = nullptr,
+    const char* const* mesh_specs = nullptr,
+    uint32_t mesh_spec_count = 0,
+    uint32_t sphere_mode = 0,
+    uint32_t icosphere_subdivision = 2,
+    uint32_t max_frames = 0,
+    bool host_blas_builds = false,
+    uint32_t frames_in_flight = 0,
+    uint32_t tiles = 0,
+    const char* workload_cache_path = nullptr,
+    bool cost_map = false,
+    bool sample_split = false,
+    uint32_t queues = 1
 );
@@ -0,0 +1,209 @@
+#include "ray_trace_renderer.h"
+
+#include "offscreen_renderer.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+struct ray_trace_renderer {
+    offscreen::renderer* renderer;
+    bool has_scene;
+    Scene scene;
+    MeshScene mesh_scene;
+    SphereMode sphere_mode;
+    uint32_t icosphere_mesh_index;
+    offscreen::camera camera;
+    ray_trace_renderer_stats stats;
+};
+
+namespace {
+    thread_local std::string last_error;
+
+    // Exceptions must not cross the C interface, they become a false return and the last error.
+    template<typename F>
+    bool call(F&& f) {
+        try {
+            f();
+            return true;
+        }
+        catch (std::exception& e) {
+            last_error = e.what();
+            return false;
+        }
+    }
+
+    // A NULL handle, e.g. of a failed ray_trace_renderer_create(), fails the call instead of crashing it.
+    template<typename T>
+    T& get_renderer(T* renderer) {
+        if (renderer == nullptr) {
+            throw std::runtime_error("[Error] renderer is NULL");
+        }
+        return *renderer;
+    }
+
+    double get_milliseconds(std::chrono::steady_clock::time_point begin) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    void clear_image(ray_trace_renderer& renderer) {
+        offscreen::clear_samples(*renderer.renderer);
+        renderer.stats.samples = 0;
+    }
+
+    void load_scene(ray_trace_renderer& renderer, float time) {
+        auto begin = std::chrono::steady_clock::now();
+        offscreen::load_scene(*renderer.renderer, renderer.scene, renderer.mesh_scene, renderer.sphere_mode, renderer.icosphere_mesh_index, time);
+        renderer.has_scene = true;
+        clear_image(renderer);
+        renderer.stats.scene_ms = get_milliseconds(begin);
+    }
+}
+
+ray_trace_renderer* ray_trace_renderer_create(uint32_t gpu_index) {
+    ray_trace_renderer* renderer = nullptr;
+    call([gpu_index, &renderer]() {
+        auto begin = std::chrono::steady_clock::now();
+        renderer = new ray_trace_renderer{
+            .renderer = offscreen::create_renderer(gpu_index),
+            .has_scene = false,
+            // The camera of the ray generation shader.
+            .camera = {
+                .position = glm::vec3(13.0f, 2.0f, -3.0f),
+                .direction = glm::vec3(-13.0f, -2.0f, 3.0f)
+            }
+        };
+        renderer->stats.startup_ms = get_milliseconds(begin);
+    });
+    return renderer;
+}
+
+void ray_trace_renderer_destroy(ray_trace_renderer* renderer) {
+    if (renderer == nullptr) {
+        return;
+    }
+    offscreen::destroy_renderer(renderer->renderer);
+    delete renderer;
+}
+
+bool ray_trace_renderer_load_scene(ray_trace_renderer* renderer, const char* scene_path,
+    const char* const* mesh_specs, uint32_t mesh_spec_count, uint32_t sphere_mode, uint32_t icosphere_subdivision, float time) {
+    return call([=]() {
+        auto& renderer_state = get_renderer(renderer);
+        if (sphere_mode > static_cast<uint32_t>(SphereMode::Icosphere)) {
+            throw std::runtime_error("[Error] unknown sphere mode");
+        }
+        if (mesh_spec_count > 0 && mesh_specs == nullptr) {
+            throw std::runtime_error("[Error] mesh specs are NULL");
+        }
+        auto scene = scene_path ? loadScene(scene_path) : generateRandomScene();
+        auto mesh_scene = MeshScene{};
+        for (uint32_t i = 0; i < mesh_spec_count; i++) {
+            addMeshInstance(mesh_scene, mesh_specs[i]);
+        }
+        auto mode = static_cast<SphereMode>(sphere_mode);
+        uint32_t icosphere_mesh_index = 0;
+        if (mode == SphereMode::Icosphere) {
+            icosphere_mesh_index = addIcosphere(mesh_scene, icosphere_subdivision);
+        }
+
+        renderer_state.has_scene = false;
+        renderer_state.scene = std::move(scene);
+        renderer_state.mesh_scene = std::move(mesh_scene);
+        renderer_state.sphere_mode = mode;
+        renderer_state.icosphere_mesh_index = icosphere_mesh_index;
+        load_scene(renderer_state, time);
+    });
+}
+
+bool ray_trace_renderer_update_scene(ray_trace_renderer* renderer, float time) {
+    return call([=]() {
+        auto& renderer_state = get_renderer(renderer);
+        if (!renderer_state.has_scene) {
+            throw std::runtime_error("[Error] no scene loaded");
+        }
+        load_scene(renderer_state, time);
+    });
+}
+
+bool ray_trace_renderer_set_resolution(ray_trace_renderer* renderer, uint32_t width, uint32_t height) {
+    return call([=]() {
+        auto& stats = get_renderer(renderer).stats;
+        // The stats take the size of the renderer, which is 0 x 0 after a failed resize.
+        auto update_size = [&stats, renderer]() {
+            auto new_width = offscreen::get_width(*renderer->renderer);
+            auto new_height = offscreen::get_height(*renderer->renderer);
+            if (new_width != stats.width || new_height != stats.height) {
+                stats.samples = 0;
+            }
+            stats.width = new_width;
+            stats.height = new_height;
+        };
+        try {
+            offscreen::set_resolution(*renderer->renderer, width, height);
+        }
+        catch (...) {
+            update_size();
+            throw;
+        }
+        update_size();
+    });
+}
+
+bool ray_trace_renderer_set_camera(ray_trace_renderer* renderer, const float position[3], const float direction[3]) {
+    return call([=]() {
+        auto& renderer_state = get_renderer(renderer);
+        if (position == nullptr || direction == nullptr) {
+            throw std::runtime_error("[Error] camera position or direction is NULL");
+        }
+        renderer_state.camera = {
+            .position = glm::vec3(position[0], position[1], position[2]),
+            .direction = glm::vec3(direction[0], direction[1], direction[2])
+        };
+        clear_image(renderer_state);
+    });
+}
+
+bool ray_trace_renderer_render(ray_trace_renderer* renderer, uint32_t samples) {
+    return call([=]() {
+        auto& stats = get_renderer(renderer).stats;
+        auto begin = std::chrono::steady_clock::now();
+        // Sample indices go on from the samples already summed, so rendering 2 x n samples gives the image of 2n.
+        offscreen::render(*renderer->renderer, renderer->camera, stats.samples, samples, 0, stats.height);
+        stats.last_render_ms = get_milliseconds(begin);
+        stats.total_render_ms += stats.last_render_ms;
+        stats.samples += samples;
+        stats.render_count++;
+        stats.total_samples += uint64_t{ stats.width } * stats.height * samples;
+    });
+}
+
+bool ray_trace_renderer_read_image(ray_trace_renderer* renderer, uint8_t* rgba, size_t rgba_size) {
+    return call([=]() {
+        auto& stats = get_renderer(renderer).stats;
+        if (stats.width == 0 || stats.height == 0) {
+            throw std::runtime_error("[Error] no resolution set");
+        }
+        if (stats.samples == 0) {
+            throw std::runtime_error("[Error] no samples rendered since the image was cleared");
+        }
+        if (rgba == nullptr || rgba_size < size_t{ stats.width } * stats.height * 4) {
+            throw std::runtime_error("[Error] image buffer smaller than width * height * 4 bytes");
+        }
+        offscreen::read_image(*renderer->renderer, 0, stats.height, rgba);
+    });
+}
+
+bool ray_trace_renderer_get_stats(const ray_trace_renderer* renderer, ray_trace_renderer_stats* stats) {
+    return call([=]() {
+        if (stats == nullptr) {
+            throw std::runtime_error("[Error] stats are NULL");
+        }
+        *stats = get_renderer(renderer).stats;
+    });
+}
+
+const char* ray_trace_get_last_error(void) {
+    return last_error.c_str();
+}
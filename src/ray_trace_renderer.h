@@ -0,0 +1,71 @@
+#pragma once
+
+// C interface of a renderer that is kept between calls, for applications and ctypes drivers that render
+// many images: the device, pipeline and scene are set up once instead of by every ray_trace() call.
+// Functions returning bool return false on failure, ray_trace_get_last_error() then tells why. They also fail
+// for a NULL renderer, which ray_trace_renderer_destroy() ignores.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if WIN32
+#ifdef RAY_TRACE_BUILD
+#define RAY_TRACE_API __declspec(dllexport)
+#else
+#define RAY_TRACE_API __declspec(dllimport)
+#endif
+#else
+#define RAY_TRACE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ray_trace_renderer ray_trace_renderer;
+
+typedef struct ray_trace_renderer_stats {
+    uint32_t width;
+    uint32_t height;
+    // Samples per pixel summed into the image since it was last cleared.
+    uint32_t samples;
+    uint32_t render_count;
+    // Samples of all pixels over all renders.
+    uint64_t total_samples;
+    double startup_ms;
+    // Of the last scene load or update.
+    double scene_ms;
+    double last_render_ms;
+    double total_render_ms;
+} ray_trace_renderer_stats;
+
+// Brings up GPU gpu_index of the GPUs with ray tracing support, NULL on failure.
+RAY_TRACE_API ray_trace_renderer* ray_trace_renderer_create(uint32_t gpu_index);
+RAY_TRACE_API void ray_trace_renderer_destroy(ray_trace_renderer* renderer);
+
+// The scene and meshes as for ray_trace(), a NULL scene_path is the generated random scene.
+// Animated spheres are placed at time.
+RAY_TRACE_API bool ray_trace_renderer_load_scene(ray_trace_renderer* renderer, const char* scene_path,
+    const char* const* mesh_specs, uint32_t mesh_spec_count, uint32_t sphere_mode, uint32_t icosphere_subdivision, float time);
+// Moves the animated spheres of the loaded scene to time.
+RAY_TRACE_API bool ray_trace_renderer_update_scene(ray_trace_renderer* renderer, float time);
+
+// Images are only reallocated when the resolution changes. A failed call leaves the renderer at 0 x 0.
+RAY_TRACE_API bool ray_trace_renderer_set_resolution(ray_trace_renderer* renderer, uint32_t width, uint32_t height);
+RAY_TRACE_API bool ray_trace_renderer_set_camera(ray_trace_renderer* renderer, const float position[3], const float direction[3]);
+
+// Adds samples per pixel to the image. Loading or updating the scene, resizing and moving the camera clear it.
+RAY_TRACE_API bool ray_trace_renderer_render(ray_trace_renderer* renderer, uint32_t samples);
+// Writes the image as width * height RGBA8 texels, rgba_size must be at least that many bytes.
+// Fails before the first render after the image was cleared.
+RAY_TRACE_API bool ray_trace_renderer_read_image(ray_trace_renderer* renderer, uint8_t* rgba, size_t rgba_size);
+
+RAY_TRACE_API bool ray_trace_renderer_get_stats(const ray_trace_renderer* renderer, ray_trace_renderer_stats* stats);
+
+// The reason the last failed call of this thread failed.
+RAY_TRACE_API const char* ray_trace_get_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,7 +7,9 @@ struct RenderCallInfo {
     uint32_t samplesPerRenderCall;
     glm::uvec2 offset;
     glm::uvec2 image_size;
-    uint32_t t[2];
+    float time;
+    // Nonzero to add the rays traced per row to the row cost buffer.
+    uint32_t record_row_cost;
     glm::vec4 camera_pos;
     glm::vec4 camera_dir;
 };
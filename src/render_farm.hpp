@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace farm {
+	// The coordinator and its workers run on the same host, so messages are the structs below in
+	// host byte order, each behind a header with its type and payload size.
+	enum class message_type : uint32_t {
+		// worker -> coordinator, once after connecting: hello.
+		hello = 1,
+		// coordinator -> worker: job, followed by the scene path.
+		job = 2,
+		// worker -> coordinator: rows, followed by row_count * width RGBA8 texels.
+		rows = 3,
+		// worker -> coordinator: the error text of a job that fails on every worker, like a scene that does not load.
+		error = 4,
+		// coordinator -> worker, no payload.
+		shutdown = 5,
+		// worker -> coordinator: the error text of a render or device failure, the worker exits after it.
+		failed = 6
+	};
+
+	struct message_header {
+		message_type type;
+		uint32_t size;
+	};
+
+	struct hello {
+		uint32_t worker;
+	};
+
+	// Rows of one frame, rendered by a worker that keeps its renderer and scene across jobs.
+	// An empty scene path is the generated random scene.
+	struct job {
+		uint32_t frame;
+		uint32_t first_row;
+		uint32_t row_count;
+		uint32_t width;
+		uint32_t height;
+		uint32_t samples;
+		float time;
+		float camera_position[3];
+		float camera_direction[3];
+	};
+
+	struct rows {
+		uint32_t frame;
+		uint32_t first_row;
+		uint32_t row_count;
+		uint32_t width;
+	};
+
+	struct message {
+		message_type type;
+		std::vector<std::byte> payload;
+	};
+
+	constexpr uint32_t max_payload_size = 1u << 30;
+
+	// False when the peer is gone, a lost worker or coordinator is not an error.
+	inline bool write_all(int fd, const void* data, size_t size) {
+		auto bytes = static_cast<const std::byte*>(data);
+		while (size > 0) {
+			auto written = send(fd, bytes, size, MSG_NOSIGNAL);
+			if (written < 0 && errno == EINTR) {
+				continue;
+			}
+			if (written <= 0) {
+				return false;
+			}
+			bytes += written;
+			size -= written;
+		}
+		return true;
+	}
+
+	inline bool read_all(int fd, void* data, size_t size) {
+		auto bytes = static_cast<std::byte*>(data);
+		while (size > 0) {
+			auto read = recv(fd, bytes, size, 0);
+			if (read < 0 && errno == EINTR) {
+				continue;
+			}
+			if (read <= 0) {
+				return false;
+			}
+			bytes += read;
+			size -= read;
+		}
+		return true;
+	}
+
+	inline bool send_message(int fd, message_type type, std::span<const std::byte> head, std::span<const std::byte> tail = {}) {
+		auto header = message_header{ .type = type, .size = static_cast<uint32_t>(head.size() + tail.size()) };
+		return write_all(fd, &header, sizeof(header)) && write_all(fd, head.data(), head.size()) && write_all(fd, tail.data(), tail.size());
+	}
+
+	template<typename T>
+		requires std::is_trivially_copyable_v<T>
+	inline bool send_message(int fd, message_type type, const T& head, std::span<const std::byte> tail = {}) {
+		return send_message(fd, type, std::as_bytes(std::span{ &head, 1 }), tail);
+	}
+
+	// Nothing when the peer is gone or sent a message that cannot be one of the protocol.
+	inline std::optional<message> receive_message(int fd) {
+		auto header = message_header{};
+		if (!read_all(fd, &header, sizeof(header)) || header.size > max_payload_size) {
+			return std::nullopt;
+		}
+		auto received = message{ .type = header.type, .payload = std::vector<std::byte>(header.size) };
+		if (!read_all(fd, received.payload.data(), header.size)) {
+			return std::nullopt;
+		}
+		return received;
+	}
+
+	// The struct a payload starts with, nothing when the payload is too short for it.
+	template<typename T>
+		requires std::is_trivially_copyable_v<T>
+	inline std::optional<T> get_payload_head(const message& message) {
+		if (message.payload.size() < sizeof(T)) {
+			return std::nullopt;
+		}
+		T head;
+		memcpy(&head, message.payload.data(), sizeof(T));
+		return head;
+	}
+
+	template<typename T>
+	inline std::span<const std::byte> get_payload_tail(const message& message) {
+		return std::span{ message.payload }.subspan(sizeof(T));
+	}
+
+	inline sockaddr_un get_socket_address(const std::string& path) {
+		auto address = sockaddr_un{ .sun_family = AF_UNIX, .sun_path = {} };
+		if (path.size() >= sizeof(address.sun_path)) {
+			throw std::runtime_error("[Error] socket path too long: " + path);
+		}
+		memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		return address;
+	}
+
+	inline int listen_unix_socket(const std::string& path, int backlog) {
+		auto address = get_socket_address(path);
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0) {
+			throw std::runtime_error("[Error] failed to create socket: " + std::string{ strerror(errno) });
+		}
+		unlink(path.c_str());
+		if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, backlog) != 0) {
+			auto error = std::string{ strerror(errno) };
+			close(fd);
+			throw std::runtime_error("[Error] failed to listen on " + path + ": " + error);
+		}
+		return fd;
+	}
+
+	inline int connect_unix_socket(const std::string& path) {
+		auto address = get_socket_address(path);
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0) {
+			throw std::runtime_error("[Error] failed to create socket: " + std::string{ strerror(errno) });
+		}
+		if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+			auto error = std::string{ strerror(errno) };
+			close(fd);
+			throw std::runtime_error("[Error] failed to connect to " + path + ": " + error);
+		}
+		return fd;
+	}
+}
@@ -0,0 +1,342 @@
+#include "scene.h"
+
+#include <random>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <map>
+#include <cstring>
+#include <stdexcept>
+#include <bit>
+#include <algorithm>
+
+#if WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::endian::native == std::endian::little, "scene files are little-endian");
+
+struct SceneData {
+    std::vector<Sphere> spheres;
+    std::vector<uint32_t> sphereMaterialIndices;
+    std::vector<Material> materials;
+    std::vector<SphereAnimation> animations;
+    std::map<std::array<float, 11>, uint32_t> materialIndices;
+};
+
+inline float randomFloat(std::mt19937& engine, float min, float max) {
+    std::uniform_real_distribution<float> distribution(min, max);
+    return distribution(engine);
+}
+
+inline float randomFloat(std::mt19937& engine) {
+    return randomFloat(engine, 0.0f, 1.0f);
+}
+
+// https://www.codespeedy.com/hsv-to-rgb-in-cpp/
+inline glm::vec4 getRandomColor(std::mt19937& engine) {
+    float h = std::floor(randomFloat(engine, 0.0f, 360.0f));
+    float s = 0.75f, v = 0.45f;
+
+    float C = s * v;
+    float X = C * (1.0f - std::fabs(std::fmod(h / 60.0f, 2.0f) - 1.0f));
+    float m = v - C;
+
+    float r, g, b;
+
+    if (h >= 0 && h < 60) {
+        r = C, g = X, b = 0;
+    }
+    else if (h >= 60 && h < 120) {
+        r = X, g = C, b = 0;
+    }
+    else if (h >= 120 && h < 180) {
+        r = 0, g = C, b = X;
+    }
+    else if (h >= 180 && h < 240) {
+        r = 0, g = X, b = C;
+    }
+    else if (h >= 240 && h < 300) {
+        r = X, g = 0, b = C;
+    }
+    else {
+        r = C, g = 0, b = X;
+    }
+
+    return { r + m, g + m, b + m, 1.0f };
+}
+
+// Returns the index of material in the table, appending it only if no
+// identical material is present yet.
+static uint32_t addMaterial(SceneData& data, const Material& material) {
+    auto key = std::array<float, 11>{
+        static_cast<float>(material.materialType), static_cast<float>(material.textureType),
+        material.colors[0].x, material.colors[0].y, material.colors[0].z, material.colors[0].w,
+        material.colors[1].x, material.colors[1].y, material.colors[1].z, material.colors[1].w,
+        material.materialSpecificAttribute
+    };
+    auto [ite, inserted] = data.materialIndices.try_emplace(key, static_cast<uint32_t>(data.materials.size()));
+    if (inserted) {
+        data.materials.push_back(material);
+    }
+    return ite->second;
+}
+
+Scene generateRandomScene(int32_t gridHalfExtent) {
+    auto data = std::make_shared<SceneData>();
+    auto& spheres = data->spheres;
+    auto& sphereMaterialIndices = data->sphereMaterialIndices;
+    auto& animations = data->animations;
+    spheres.resize(4 + 4 * gridHalfExtent * gridHalfExtent);
+    sphereMaterialIndices.resize(spheres.size());
+    animations.resize(3);
+
+    spheres[0] = { .geometry = glm::vec4(0.0f, -1000.0f, 1.0f, 1000.0f) };
+    sphereMaterialIndices[0] = addMaterial(*data, {
+            .materialType = MaterialType::DIFFUSE,
+            .textureType = TextureType::CHECKERED,
+            .colors = {glm::vec4(0.05f, 0.05f, 0.05f, 1.0f), glm::vec4(0.95f, 0.95f, 0.95f, 1.0f)},
+            .materialSpecificAttribute = 0.0f
+    });
+
+    sphereMaterialIndices[1] = addMaterial(*data, {
+            .materialType = MaterialType::DIFFUSE,
+            .textureType = TextureType::SOLID,
+            .colors = {glm::vec4(0.6f, 0.3f, 0.1f, 1.0f)},
+            .materialSpecificAttribute = 0.0f
+    });
+    animations[0] = {
+            .center = glm::vec4(-4.0f, 1.0f, 0.0f, 1.0f),
+            .amplitude = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+            .angularFrequency = glm::vec4(0.0f, 0.0f, 2.0f, 0.0f),
+            .phase = glm::vec4(0.0f),
+            .sphereIndex = 1
+    };
+
+    sphereMaterialIndices[2] = addMaterial(*data, {
+            .materialType = MaterialType::METAL,
+            .textureType = TextureType::SOLID,
+            .colors = {glm::vec4(0.8f, 0.8f, 0.8f, 1.0f)},
+            .materialSpecificAttribute = 0.0f
+    });
+    animations[1] = {
+            .center = glm::vec4(4.0f, 1.0f, 0.0f, 1.0f),
+            .amplitude = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+            .angularFrequency = glm::vec4(0.0f, 0.0f, 3.0f, 0.0f),
+            .phase = glm::vec4(0.0f),
+            .sphereIndex = 2
+    };
+
+    sphereMaterialIndices[3] = addMaterial(*data, {
+            .materialType = MaterialType::REFRACTIVE,
+            .textureType = TextureType::SOLID,
+            .colors = {glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)},
+            .materialSpecificAttribute = 1.5f
+    });
+    animations[2] = {
+            .center = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f),
+            .amplitude = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+            .angularFrequency = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+            .phase = glm::vec4(0.0f),
+            .sphereIndex = 3
+    };
+
+    for (auto& animation : animations) {
+        spheres[animation.sphereIndex].geometry = evaluateSphereAnimation(animation, 0.0f);
+    }
+
+    uint32_t sphereIndex = 4;
+
+    std::mt19937 engine{};
+
+    for (int a = -gridHalfExtent; a < gridHalfExtent; a++) {
+        for (int b = -gridHalfExtent; b < gridHalfExtent; b++) {
+            spheres[sphereIndex].geometry =
+                glm::vec4(float(a) + 0.9f * randomFloat(engine), 0.2f, float(b) + 0.9f * randomFloat(engine), 0.2f);
+
+            const float materialProbability = randomFloat(engine);
+
+            Material material = {};
+            if (materialProbability < 0.7) {
+                material.materialType = MaterialType::DIFFUSE;
+                material.textureType = TextureType::SOLID;
+                material.colors[0] = getRandomColor(engine);
+                material.materialSpecificAttribute = 0.0f;
+
+            }
+            else if (materialProbability < 0.85) {
+                material.materialType = MaterialType::METAL;
+                material.textureType = TextureType::SOLID;
+                material.colors[0] = glm::vec4(randomFloat(engine, 0.5f, 1.0f), randomFloat(engine, 0.5f, 1.0f),
+                    randomFloat(engine, 0.5f, 1.0f), 1.0f);
+                material.materialSpecificAttribute = 0.0f;
+
+            }
+            else {
+                material.materialType = MaterialType::REFRACTIVE;
+                material.textureType = TextureType::SOLID;
+                material.colors[0] = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+                material.materialSpecificAttribute = 1.5f;
+            }
+            sphereMaterialIndices[sphereIndex] = addMaterial(*data, material);
+
+            sphereIndex++;
+        }
+    }
+
+    return Scene{
+        .spheres = data->spheres,
+        .sphereMaterialIndices = data->sphereMaterialIndices,
+        .materials = data->materials,
+        .animations = data->animations,
+        .storage = data
+    };
+}
+
+// Maps the whole file copy-on-write: the scene arrays are used in place and
+// host edits never reach the file.
+static std::shared_ptr<void> mapFile(const std::filesystem::path& path, size_t& size) {
+#if WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("[Error] Failed to open scene at '" + path.string() + "'!");
+    }
+    LARGE_INTEGER fileSize{};
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        throw std::runtime_error("[Error] Failed to map scene at '" + path.string() + "'!");
+    }
+    void* base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (base == nullptr) {
+        throw std::runtime_error("[Error] Failed to map scene at '" + path.string() + "'!");
+    }
+    return std::shared_ptr<void>(base, [](void* base) { UnmapViewOfFile(base); });
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("[Error] Failed to open scene at '" + path.string() + "'!");
+    }
+    struct stat fileStat{};
+    fstat(fd, &fileStat);
+    size = static_cast<size_t>(fileStat.st_size);
+
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("[Error] Failed to map scene at '" + path.string() + "'!");
+    }
+    // The arrays are read front to back exactly once, by the initial upload.
+    madvise(base, size, MADV_SEQUENTIAL);
+    return std::shared_ptr<void>(base, [size](void* base) { munmap(base, size); });
+#endif
+}
+
+Scene loadScene(const std::filesystem::path& path) {
+    size_t size = 0;
+    auto storage = mapFile(path, size);
+    auto bytes = static_cast<uint8_t*>(storage.get());
+
+    auto fail = [&path](const std::string& reason) {
+        return std::runtime_error("[Error] Invalid scene file '" + path.string() + "': " + reason);
+    };
+
+    if (size < sizeof(SceneFileHeader)) {
+        throw fail("truncated header");
+    }
+    SceneFileHeader header{};
+    memcpy(&header, bytes, sizeof(header));
+
+    if (memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        throw fail("bad magic");
+    }
+    if (header.version != SCENE_FILE_VERSION) {
+        throw fail("unsupported version " + std::to_string(header.version));
+    }
+    if (header.sphereStride != sizeof(Sphere) || header.materialStride != sizeof(Material)
+        || header.animationStride != sizeof(SphereAnimation)) {
+        throw fail("struct layout mismatch");
+    }
+    auto inBounds = [size](uint64_t offset, uint64_t count, uint64_t stride) {
+        return offset % SCENE_FILE_ALIGNMENT == 0 && offset <= size && count <= (size - offset) / stride;
+    };
+    if (!inBounds(header.sphereOffset, header.sphereAmount, sizeof(Sphere))
+        || !inBounds(header.sphereMaterialIndexOffset, header.sphereAmount, sizeof(uint32_t))
+        || !inBounds(header.materialOffset, header.materialAmount, sizeof(Material))
+        || !inBounds(header.animationOffset, header.animationAmount, sizeof(SphereAnimation))) {
+        throw fail("array out of bounds");
+    }
+
+    auto spheres = std::span{ reinterpret_cast<Sphere*>(bytes + header.sphereOffset), static_cast<size_t>(header.sphereAmount) };
+    auto sphereMaterialIndices = std::span{ reinterpret_cast<uint32_t*>(bytes + header.sphereMaterialIndexOffset), static_cast<size_t>(header.sphereAmount) };
+    auto materials = std::span{ reinterpret_cast<Material*>(bytes + header.materialOffset), static_cast<size_t>(header.materialAmount) };
+    auto animations = std::span{ reinterpret_cast<SphereAnimation*>(bytes + header.animationOffset), static_cast<size_t>(header.animationAmount) };
+    if (std::ranges::any_of(animations, [&spheres](auto& animation) { return animation.sphereIndex >= spheres.size(); })) {
+        throw fail("animation references a missing sphere");
+    }
+    if (std::ranges::any_of(sphereMaterialIndices, [&materials](auto index) { return index >= materials.size(); })) {
+        throw fail("sphere references a missing material");
+    }
+
+    return Scene{
+        .spheres = spheres,
+        .sphereMaterialIndices = sphereMaterialIndices,
+        .materials = materials,
+        .animations = animations,
+        .storage = storage
+    };
+}
+
+void saveScene(const Scene& scene, const std::filesystem::path& path) {
+    auto align = [](uint64_t offset) {
+        return (offset + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT;
+    };
+
+    SceneFileHeader header{
+        .version = SCENE_FILE_VERSION,
+        .sphereStride = sizeof(Sphere),
+        .materialStride = sizeof(Material),
+        .animationStride = sizeof(SphereAnimation),
+        .sphereAmount = scene.spheres.size(),
+        .materialAmount = scene.materials.size(),
+        .animationAmount = scene.animations.size(),
+    };
+    memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.sphereOffset = align(sizeof(SceneFileHeader));
+    header.sphereMaterialIndexOffset = align(header.sphereOffset + scene.spheres.size_bytes());
+    header.materialOffset = align(header.sphereMaterialIndexOffset + scene.sphereMaterialIndices.size_bytes());
+    header.animationOffset = align(header.materialOffset + scene.materials.size_bytes());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("[Error] Failed to open file at '" + path.string() + "'!");
+    }
+
+    auto pad_to = [&file](uint64_t offset) {
+        static const char zeros[SCENE_FILE_ALIGNMENT] = {};
+        file.write(zeros, offset - static_cast<uint64_t>(file.tellp()));
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pad_to(header.sphereOffset);
+    file.write(reinterpret_cast<const char*>(scene.spheres.data()), scene.spheres.size_bytes());
+    pad_to(header.sphereMaterialIndexOffset);
+    file.write(reinterpret_cast<const char*>(scene.sphereMaterialIndices.data()), scene.sphereMaterialIndices.size_bytes());
+    pad_to(header.materialOffset);
+    file.write(reinterpret_cast<const char*>(scene.materials.data()), scene.materials.size_bytes());
+    pad_to(header.animationOffset);
+    file.write(reinterpret_cast<const char*>(scene.animations.data()), scene.animations.size_bytes());
+
+    if (!file) {
+        throw std::runtime_error("[Error] Failed to write scene at '" + path.string() + "'!");
+    }
+}
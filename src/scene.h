@@ -2,6 +2,11 @@
 
 #include <glm/glm.hpp>
 
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+
 enum MaterialType {
     DIFFUSE = 0,
     METAL = 1,
@@ -13,145 +18,74 @@ enum TextureType {
     CHECKERED = 1
 };
 
+// Only the geometry (center + radius) is read by the intersection shader;
+// shading data lives in a deduplicated material table.
 struct Sphere {
     alignas(16) glm::vec4 geometry;
+};
+
+struct Material {
     alignas(4) uint32_t materialType;
     alignas(4) uint32_t textureType;
     alignas(16) glm::vec4 colors[2];
     alignas(4) float materialSpecificAttribute;
 };
 
-const uint32_t MAX_SPHERE_AMOUNT = 512;
+// Parametric motion of one sphere, evaluated on the GPU by shader.comp:
+// geometry(t) = center + amplitude * cos(angularFrequency * t + phase)
+struct SphereAnimation {
+    alignas(16) glm::vec4 center;
+    alignas(16) glm::vec4 amplitude;
+    alignas(16) glm::vec4 angularFrequency;
+    alignas(16) glm::vec4 phase;
+    alignas(4) uint32_t sphereIndex;
+};
 
+// The scene arrays are views into memory owned by storage, which is either
+// a generated scene or a memory-mapped scene file.
 struct Scene {
-    alignas(64) Sphere spheres[MAX_SPHERE_AMOUNT];
-    alignas(4) uint32_t sphereAmount;
+    std::span<Sphere> spheres;
+    std::span<uint32_t> sphereMaterialIndices;
+    std::span<Material> materials;
+    std::span<SphereAnimation> animations;
+    std::shared_ptr<void> storage;
 };
 
-#include <random>
-
-#include <chrono>
-
-
-
-inline float randomFloat(std::mt19937& engine, float min, float max) {
-    std::uniform_real_distribution<float> distribution(min, max);
-    return distribution(engine);
-}
-
-inline float randomFloat(std::mt19937& engine) {
-    return randomFloat(engine, 0.0f, 1.0f);
-}
-
-// https://www.codespeedy.com/hsv-to-rgb-in-cpp/
-inline glm::vec4 getRandomColor(std::mt19937& engine) {
-    float h = std::floor(randomFloat(engine, 0.0f, 360.0f));
-    float s = 0.75f, v = 0.45f;
-
-    float C = s * v;
-    float X = C * (1.0f - std::fabs(std::fmod(h / 60.0f, 2.0f) - 1.0f));
-    float m = v - C;
-
-    float r, g, b;
-
-    if (h >= 0 && h < 60) {
-        r = C, g = X, b = 0;
-    }
-    else if (h >= 60 && h < 120) {
-        r = X, g = C, b = 0;
-    }
-    else if (h >= 120 && h < 180) {
-        r = 0, g = C, b = X;
-    }
-    else if (h >= 180 && h < 240) {
-        r = 0, g = X, b = C;
-    }
-    else if (h >= 240 && h < 300) {
-        r = X, g = 0, b = C;
-    }
-    else {
-        r = C, g = 0, b = X;
-    }
+// Binary scene file, little-endian. The arrays are stored with the exact
+// layout of the GPU structs so they can be uploaded straight from the mapping.
+//
+//   SceneFileHeader
+//   Sphere          spheres[sphereAmount]                 at sphereOffset
+//   uint32_t        sphereMaterialIndices[sphereAmount]   at sphereMaterialIndexOffset
+//   Material        materials[materialAmount]             at materialOffset
+//   SphereAnimation animations[animationAmount]           at animationOffset
+const char SCENE_FILE_MAGIC[4] = { 'R', 'T', 'S', 'C' };
+const uint32_t SCENE_FILE_VERSION = 2;
+const uint64_t SCENE_FILE_ALIGNMENT = 64;
+
+struct SceneFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t sphereStride;
+    uint32_t materialStride;
+    uint32_t animationStride;
+    uint32_t reserved;
+    uint64_t sphereAmount;
+    uint64_t sphereOffset;
+    uint64_t sphereMaterialIndexOffset;
+    uint64_t materialAmount;
+    uint64_t materialOffset;
+    uint64_t animationAmount;
+    uint64_t animationOffset;
+};
 
-    return { r + m, g + m, b + m, 1.0f };
+inline glm::vec4 evaluateSphereAnimation(const SphereAnimation& animation, float t) {
+    return animation.center + animation.amplitude * glm::cos(animation.angularFrequency * t + animation.phase);
 }
 
-Scene generateRandomScene() {
-    Scene scene = {};
-
-    auto now = std::chrono::steady_clock::now();
-    auto t = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() * 0.001f;
-
-    scene.spheres[0] = {
-            .geometry = glm::vec4(0.0f, -1000.0f, 1.0f, 1000.0f),
-            .materialType = MaterialType::DIFFUSE,
-            .textureType = TextureType::CHECKERED,
-            .colors = {glm::vec4(0.05f, 0.05f, 0.05f, 1.0f), glm::vec4(0.95f, 0.95f, 0.95f, 1.0f)},
-            .materialSpecificAttribute = 0.0f
-    };
-
-    scene.spheres[1] = {
-            .geometry = glm::vec4(-4.0f, 1.0f, cos(2 * t), 1.0f),
-            .materialType = MaterialType::DIFFUSE,
-            .textureType = TextureType::SOLID,
-            .colors = {glm::vec4(0.6f, 0.3f, 0.1f, 1.0f)},
-            .materialSpecificAttribute = 0.0f
-    };
-
-    scene.spheres[2] = {
-            .geometry = glm::vec4(4.0f, 1.0f, cos(3 * t), 1.0f),
-            .materialType = MaterialType::METAL,
-            .textureType = TextureType::SOLID,
-            .colors = {glm::vec4(0.8f, 0.8f, 0.8f, 1.0f)},
-            .materialSpecificAttribute = 0.0f
-    };
-
-    auto offset = cos(t);
-    scene.spheres[3] = {
-            .geometry = glm::vec4(0.0f, 1.0f, offset, 1.0f),
-            .materialType = MaterialType::REFRACTIVE,
-            .textureType = TextureType::SOLID,
-            .colors = {glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)},
-            .materialSpecificAttribute = 1.5f
-    };
-
-    uint32_t sphereIndex = 4;
-
-    std::mt19937 engine{};
+// Three large animated spheres on a checkered ground, surrounded by a
+// (2 * gridHalfExtent)^2 grid of small random spheres.
+Scene generateRandomScene(int32_t gridHalfExtent = 11);
 
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            scene.spheres[sphereIndex].geometry =
-                glm::vec4(float(a) + 0.9f * randomFloat(engine), 0.2f, float(b) + 0.9f * randomFloat(engine), 0.2f);
-
-            const float materialProbability = randomFloat(engine);
-
-            if (materialProbability < 0.7) {
-                scene.spheres[sphereIndex].materialType = MaterialType::DIFFUSE;
-                scene.spheres[sphereIndex].textureType = TextureType::SOLID;
-                scene.spheres[sphereIndex].colors[0] = getRandomColor(engine);
-                scene.spheres[sphereIndex].materialSpecificAttribute = 0.0f;
-
-            }
-            else if (materialProbability < 0.85) {
-                scene.spheres[sphereIndex].materialType = MaterialType::METAL;
-                scene.spheres[sphereIndex].textureType = TextureType::SOLID;
-                scene.spheres[sphereIndex].colors[0] = glm::vec4(randomFloat(engine, 0.5f, 1.0f), randomFloat(engine, 0.5f, 1.0f),
-                    randomFloat(engine, 0.5f, 1.0f), 1.0f);
-                scene.spheres[sphereIndex].materialSpecificAttribute = 0.0f;
-
-            }
-            else {
-                scene.spheres[sphereIndex].materialType = MaterialType::REFRACTIVE;
-                scene.spheres[sphereIndex].textureType = TextureType::SOLID;
-                scene.spheres[sphereIndex].colors[0] = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
-                scene.spheres[sphereIndex].materialSpecificAttribute = 1.5f;
-            }
-
-            sphereIndex++;
-        }
-    }
-
-    scene.sphereAmount = sphereIndex;
-    return scene;
-}
+Scene loadScene(const std::filesystem::path& path);
+void saveScene(const Scene& scene, const std::filesystem::path& path);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+namespace startup {
+	using clock = std::chrono::steady_clock;
+
+	struct stage {
+		std::string_view name;
+		clock::time_point begin;
+		clock::time_point end;
+	};
+
+	// Bring-up stages of one device. Stages of different devices, and a device's
+	// pipeline compilation, run concurrently, so the stages may overlap.
+	struct timeline {
+		clock::time_point begin;
+		std::vector<stage> stages;
+	};
+
+	inline void init_timeline(timeline& timeline, clock::time_point begin) {
+		timeline = {
+			.begin = begin
+		};
+	}
+
+	inline void add_stage(timeline& timeline, stage stage) {
+		timeline.stages.push_back(stage);
+	}
+
+	// Adds a stage from its construction to the end of the scope.
+	struct scoped_stage {
+		timeline& target;
+		std::string_view name;
+		clock::time_point begin = clock::now();
+
+		~scoped_stage() {
+			add_stage(target, { name, begin, clock::now() });
+		}
+	};
+
+	// "<name> <duration> @<end>" per stage in order of their start, the end
+	// relative to the start of the bring-up.
+	inline void print_timeline(std::ostream& out, timeline timeline) {
+		std::ranges::sort(timeline.stages, std::ranges::less{}, [](auto& stage) { return stage.begin; });
+		auto first = true;
+		std::ranges::for_each(
+			timeline.stages,
+			[&out, &first, begin = timeline.begin](auto& stage) {
+				out << (first ? "" : ", ") << stage.name << " "
+					<< std::chrono::duration_cast<std::chrono::milliseconds>(stage.end - stage.begin) << " @"
+					<< std::chrono::duration_cast<std::chrono::milliseconds>(stage.end - begin);
+				first = false;
+			}
+		);
+	}
+}
@@ -3,6 +3,7 @@
 #include <functional>
 #include "vulkan_settings.h"
 #include "scene.h"
+#include "mesh.h"
 #include "render_call_info.h"
 
 #include <map>
@@ -13,6 +14,10 @@
 #include <numeric>
 #include <fstream>
 #include <unordered_map>
+#include <optional>
+#include <chrono>
+#include <thread>
+#include <tuple>
 
 #include "shader_path.hpp"
 
@@ -22,11 +27,15 @@ struct VulkanImage {
     vk::Image image;
     vk::DeviceMemory memory;
     vk::ImageView imageView;
+    // Bytes of device memory backing the image.
+    vk::DeviceSize size;
 };
 
 struct VulkanBuffer {
     vk::Buffer buffer;
     vk::DeviceMemory memory;
+    // Bytes of device memory backing the buffer.
+    vk::DeviceSize size;
 };
 
 struct VulkanAccelerationStructure {
@@ -65,48 +74,97 @@ namespace vulkan {
         return vk::createInstance(instanceCreateInfo);
     }
 
-    auto pick_physical_devices(vk::Instance instance, const auto& extensions) {
-        std::vector<vk::PhysicalDevice> allPhysicalDevices = instance.enumeratePhysicalDevices();
+    // "<device UUID>-<driver version>", identifies a GPU and its driver across runs.
+    inline std::string get_device_identity(vk::PhysicalDevice physical_device) {
+        vk::PhysicalDeviceIDProperties id_properties = {};
+        vk::PhysicalDeviceProperties2 properties2 = {
+                .pNext = &id_properties
+        };
+        physical_device.getProperties2(&properties2);
 
-        if (allPhysicalDevices.empty()) {
-            throw std::runtime_error("No GPU with Vulkan support found!");
+        auto identity = std::string{};
+        for (auto byte : id_properties.deviceUUID) {
+            constexpr auto hex_digits = "0123456789abcdef";
+            identity += hex_digits[byte >> 4];
+            identity += hex_digits[byte & 0xf];
         }
+        return identity + "-" + std::to_string(properties2.properties.driverVersion);
+    }
 
-        std::vector<vk::PhysicalDevice> withRequiredExtensionsPhysicalDevices{};
-        for (const vk::PhysicalDevice& d : allPhysicalDevices) {
-            std::vector<vk::ExtensionProperties> availableExtensions = d.enumerateDeviceExtensionProperties();
-            std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
-
-            for (const vk::ExtensionProperties& extension : availableExtensions) {
-                requiredExtensions.erase(extension.extensionName);
-            }
+    inline std::array<uint8_t, vk::UuidSize> get_device_uuid(vk::PhysicalDevice physical_device) {
+        vk::PhysicalDeviceIDProperties id_properties = {};
+        vk::PhysicalDeviceProperties2 properties2 = {
+                .pNext = &id_properties
+        };
+        physical_device.getProperties2(&properties2);
+        return id_properties.deviceUUID;
+    }
 
-            if (requiredExtensions.empty()) {
-                withRequiredExtensionsPhysicalDevices.push_back(d);
-            }
+    // Whether a GPU renders and, if it does not, why.
+    struct physical_device_pick {
+        vk::PhysicalDevice physical_device;
+        std::string name;
+        std::string identity;
+        // Index of the device group of the GPU and how many GPUs are linked in it.
+        uint32_t group;
+        uint32_t group_size;
+        // Empty for a picked GPU.
+        std::string skip_reason;
+    };
+
+    // Picks up to max_count GPUs with the required extensions, in device group order so linked
+    // adapters stay next to each other. GPUs are told apart by their device UUID, so identical
+    // cards sharing a PCI device ID all render, while a GPU exposed twice, e.g. by two drivers, is
+    // picked once. Every member of a device group renders as a device of its own.
+    // Returns the picked GPUs and the pick of every GPU for the startup report.
+    inline auto pick_physical_devices(vk::Instance instance, const auto& extensions, uint32_t max_count) {
+        std::vector<vk::PhysicalDeviceGroupProperties> groups = instance.enumeratePhysicalDeviceGroups();
+
+        if (groups.empty()) {
+            throw std::runtime_error("No GPU with Vulkan support found!");
         }
 
-        std::unordered_map<uint32_t, vk::PhysicalDevice> id_device_map{};
-
-        std::ranges::for_each(
-            withRequiredExtensionsPhysicalDevices,
-            [&id_device_map](vk::PhysicalDevice physical_device) {
-                auto properties = physical_device.getProperties();
-                id_device_map[properties.deviceID] = physical_device;
-            }
-        );
+        std::vector<vk::PhysicalDevice> picked_physical_devices{};
+        std::vector<physical_device_pick> picks{};
+        std::set<std::array<uint8_t, vk::UuidSize>> picked_uuids{};
+        for (uint32_t group = 0; group < groups.size(); group++) {
+            for (uint32_t k = 0; k < groups[group].physicalDeviceCount; k++) {
+                auto physical_device = groups[group].physicalDevices[k];
+                auto pick = physical_device_pick{
+                    .physical_device = physical_device,
+                    .name = physical_device.getProperties().deviceName,
+                    .identity = get_device_identity(physical_device),
+                    .group = group,
+                    .group_size = groups[group].physicalDeviceCount,
+                    .skip_reason = {}
+                };
 
-        auto unique_physical_devices = std::vector<vk::PhysicalDevice>(id_device_map.size());
+                std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
+                for (const vk::ExtensionProperties& extension : physical_device.enumerateDeviceExtensionProperties()) {
+                    requiredExtensions.erase(extension.extensionName);
+                }
 
-        std::ranges::transform(
-            id_device_map,
-            unique_physical_devices.begin(),
-            [](auto k_v) {
-                return k_v.second;
+                if (!requiredExtensions.empty()) {
+                    pick.skip_reason = "missing";
+                    for (auto& extension : requiredExtensions) {
+                        pick.skip_reason += " " + extension;
+                    }
+                }
+                else if (picked_uuids.contains(get_device_uuid(physical_device))) {
+                    pick.skip_reason = "same device UUID as a picked GPU";
+                }
+                else if (picked_physical_devices.size() >= max_count) {
+                    pick.skip_reason = "over the GPU count limit of " + std::to_string(max_count);
+                }
+                else {
+                    picked_uuids.insert(get_device_uuid(physical_device));
+                    picked_physical_devices.push_back(physical_device);
+                }
+                picks.push_back(std::move(pick));
             }
-        );
+        }
 
-        return unique_physical_devices;
+        return std::pair{ picked_physical_devices, picks };
     }
 
     inline auto find_queue_family(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface) {
@@ -142,26 +200,59 @@ namespace vulkan {
         return std::pair{ computeQueueFamily, presentQueueFamily };
     }
 
+    // Queue family of an offscreen device, which presents nothing: a compute family
+    // without graphics when there is one, like find_queue_family, else any compute family.
+    inline uint32_t find_compute_queue_family(vk::PhysicalDevice physicalDevice) {
+        std::vector<vk::QueueFamilyProperties> queueFamilies = physicalDevice.getQueueFamilyProperties();
+        std::optional<uint32_t> computeQueueFamily{};
+        for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+            if (!(queueFamilies[i].queueFlags & vk::QueueFlagBits::eCompute)) {
+                continue;
+            }
+            if (!(queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics)) {
+                return i;
+            }
+            if (!computeQueueFamily) {
+                computeQueueFamily = i;
+            }
+        }
+        if (!computeQueueFamily) {
+            throw std::runtime_error("[Error] GPU without compute queue");
+        }
+        return computeQueueFamily.value();
+    }
+
 
     auto create_device(
         vk::Instance instance,
         vk::PhysicalDevice physical_device,
         uint32_t computeQueueFamily, uint32_t presentQueueFamily,
-        const auto& extensions
+        const auto& extensions,
+        bool accelerationStructureHostCommands = false,
+        uint32_t traceQueueCount = 1
         ) {
-        float queuePriority = 1.0f;
+        // A second queue of the compute family, when the family has one, builds the
+        // acceleration structures of the next frame while the current one is traced.
+        // Up to traceQueueCount - 1 more queues of the family trace tiles next to the first one.
+        auto queueFamilies = physical_device.getQueueFamilyProperties();
+        uint32_t computeQueueCount = std::min(std::max(traceQueueCount + 1, 2u), queueFamilies[computeQueueFamily].queueCount);
+
+        auto queuePriorities = std::vector<float>(computeQueueCount, 1.0f);
         std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos = {
-                {
-                        .queueFamilyIndex = presentQueueFamily,
-                        .queueCount = 1,
-                        .pQueuePriorities = &queuePriority
-                },
                 {
                         .queueFamilyIndex = computeQueueFamily,
-                        .queueCount = 1,
-                        .pQueuePriorities = &queuePriority
+                        .queueCount = computeQueueCount,
+                        .pQueuePriorities = queuePriorities.data()
                 }
         };
+        if (presentQueueFamily != computeQueueFamily) {
+            queueCreateInfos.push_back(
+                {
+                        .queueFamilyIndex = presentQueueFamily,
+                        .queueCount = 1,
+                        .pQueuePriorities = queuePriorities.data()
+                });
+        }
 
         vk::PhysicalDeviceFeatures deviceFeatures = {
             .shaderFloat64 = true,
@@ -173,8 +264,14 @@ namespace vulkan {
                 .bufferDeviceAddressMultiDevice = false
         };
 
-        vk::PhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipelineFeatures = {
+        // Frames are paced with one timeline semaphore per device.
+        vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {
                 .pNext = &bufferDeviceAddressFeatures,
+                .timelineSemaphore = true
+        };
+
+        vk::PhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipelineFeatures = {
+                .pNext = &timelineSemaphoreFeatures,
                 .rayTracingPipeline = true
         };
 
@@ -183,7 +280,7 @@ namespace vulkan {
                 .accelerationStructure = true,
                 .accelerationStructureCaptureReplay = true,
                 .accelerationStructureIndirectBuild = false,
-                .accelerationStructureHostCommands = false,
+                .accelerationStructureHostCommands = accelerationStructureHostCommands,
                 .descriptorBindingAccelerationStructureUpdateAfterBind = false
         };
 
@@ -200,11 +297,25 @@ namespace vulkan {
 
         auto computeQueue = device.getQueue(computeQueueFamily, 0);
         auto presentQueue = device.getQueue(presentQueueFamily, 0);
+        auto buildQueue = computeQueueCount > 1 ? device.getQueue(computeQueueFamily, 1) : vk::Queue{};
+        auto traceQueues = std::vector<vk::Queue>{ computeQueue };
+        for (uint32_t queueIndex = 2; queueIndex < computeQueueCount; queueIndex++) {
+            traceQueues.push_back(device.getQueue(computeQueueFamily, queueIndex));
+        }
 
-        return std::tuple{ device, computeQueue, presentQueue };
+        return std::tuple{ device, computeQueue, presentQueue, buildQueue, traceQueues };
     }
 
 
+    inline bool supports_acceleration_structure_host_commands(vk::PhysicalDevice physical_device) {
+        vk::PhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures = {};
+        vk::PhysicalDeviceFeatures2 physicalDeviceFeatures2 = {
+                .pNext = &accelerationStructureFeatures
+        };
+        physical_device.getFeatures2(&physicalDeviceFeatures2);
+        return accelerationStructureFeatures.accelerationStructureHostCommands;
+    }
+
     inline auto create_swapchain(
         vk::PhysicalDevice physicalDevice,
         vk::SurfaceKHR surface,
@@ -214,7 +325,9 @@ namespace vulkan {
         vk::ColorSpaceKHR color_space,
         vk::PresentModeKHR presentMode,
         vk::Extent2D swapchain_extent,
-        vk::SurfaceTransformFlagBitsKHR pre_transform
+        vk::SurfaceTransformFlagBitsKHR pre_transform,
+        uint32_t compute_queue_family,
+        uint32_t present_queue_family
     ) {
         auto present_modes = physicalDevice.getSurfacePresentModesKHR(surface);
         if (!std::ranges::contains(present_modes, presentMode)) {
@@ -237,6 +350,14 @@ namespace vulkan {
                 .oldSwapchain = nullptr
         };
 
+        // The images are written by the compute queue and presented by the present
+        // queue, which may belong to another family.
+        auto queue_families = std::array{ compute_queue_family, present_queue_family };
+        if (compute_queue_family != present_queue_family) {
+            swapChainCreateInfo.setImageSharingMode(vk::SharingMode::eConcurrent)
+                .setQueueFamilyIndices(queue_families);
+        }
+
         auto swapchain = device.createSwapchainKHR(swapChainCreateInfo);
         return swapchain;
     }
@@ -297,7 +418,8 @@ namespace vulkan {
                                     .baseArrayLayer = 0,
                                     .layerCount = 1
                             }
-                    })
+                    }),
+                .size = memoryRequirements.size
         };
     }
 
@@ -342,6 +464,49 @@ namespace vulkan {
         return semaphores;
     }
 
+    inline auto create_timeline_semaphore(vk::Device device) {
+        vk::SemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {
+                .semaphoreType = vk::SemaphoreType::eTimeline,
+                .initialValue = 0
+        };
+        return device.createSemaphore({ .pNext = &semaphoreTypeCreateInfo });
+    }
+
+    inline void wait_timeline_semaphore(vk::Device device, vk::Semaphore semaphore, uint64_t value) {
+        auto res = device.waitSemaphores(vk::SemaphoreWaitInfo{}.setSemaphores(semaphore).setValues(value), UINT64_MAX);
+        if (res != vk::Result::eSuccess) {
+            throw std::runtime_error{ "failed to wait semaphores" };
+        }
+    }
+
+    // Index of the queue with the fewest submissions pending, each queue signaling the next value of its
+    // timeline semaphore per submission. When every queue has max_pending submissions pending it first
+    // waits for any of them to finish one.
+    inline uint32_t wait_least_busy_queue(vk::Device device, const std::vector<vk::Semaphore>& semaphores,
+        const std::vector<uint64_t>& submitted_values, uint64_t max_pending) {
+        while (true) {
+            uint32_t least_busy = 0;
+            uint64_t least_pending = UINT64_MAX;
+            for (uint32_t queue = 0; queue < semaphores.size(); queue++) {
+                auto pending = submitted_values[queue] - device.getSemaphoreCounterValue(semaphores[queue]);
+                if (pending < least_pending) {
+                    least_busy = queue;
+                    least_pending = pending;
+                }
+            }
+            if (least_pending < max_pending) {
+                return least_busy;
+            }
+            auto values = std::vector<uint64_t>(submitted_values.size());
+            std::ranges::transform(submitted_values, values.begin(), [max_pending](auto value) { return value - max_pending + 1; });
+            auto res = device.waitSemaphores(
+                vk::SemaphoreWaitInfo{ .flags = vk::SemaphoreWaitFlagBits::eAny }.setSemaphores(semaphores).setValues(values), UINT64_MAX);
+            if (res != vk::Result::eSuccess) {
+                throw std::runtime_error{ "failed to wait semaphores" };
+            }
+        }
+    }
+
     inline VulkanBuffer create_buffer(vk::Device device, const vk::DeviceSize& size, const vk::Flags<vk::BufferUsageFlagBits>& usage,
         const vk::Flags<vk::MemoryPropertyFlagBits>& memoryProperty, const vk::PhysicalDeviceMemoryProperties& memory_properties) {
         vk::BufferCreateInfo bufferCreateInfo = {
@@ -371,6 +536,7 @@ namespace vulkan {
         return {
                 .buffer = buffer,
                 .memory = memory,
+                .size = memoryRequirements.size
         };
     }
 
@@ -384,7 +550,8 @@ namespace vulkan {
 
         auto aabbBuffer = create_buffer(device, bufferSize,
             vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR |
-            vk::BufferUsageFlagBits::eShaderDeviceAddress,
+            vk::BufferUsageFlagBits::eShaderDeviceAddress |
+            vk::BufferUsageFlagBits::eStorageBuffer,
             vk::MemoryPropertyFlagBits::eHostVisible |
             vk::MemoryPropertyFlagBits::eHostCoherent |
             vk::MemoryPropertyFlagBits::eDeviceLocal,
@@ -392,9 +559,11 @@ namespace vulkan {
         return aabbBuffer;
     }
 
+    // BLASes that are built once pass eAllowCompaction in flags so compact_bottom_accels can shrink them.
     inline auto createBottomAccelerationStructure(vk::Device device, VulkanBuffer& aabbBuffer, uint32_t max_primitive_count,
         vk::AccelerationStructureGeometryKHR& geometry,
-        const vk::PhysicalDeviceMemoryProperties& memory_properties, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        const vk::PhysicalDeviceMemoryProperties& memory_properties, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader,
+        vk::BuildAccelerationStructureFlagsKHR flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace) {
 
         geometry.geometry.aabbs.sType = vk::StructureType::eAccelerationStructureGeometryAabbsDataKHR;
         geometry.geometry.aabbs.stride = sizeof(vk::AabbPositionsKHR);
@@ -403,7 +572,7 @@ namespace vulkan {
 
         vk::AccelerationStructureBuildGeometryInfoKHR buildInfo = {
                 .type = vk::AccelerationStructureTypeKHR::eBottomLevel,
-                .flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace,
+                .flags = flags,
                 .mode = vk::BuildAccelerationStructureModeKHR::eBuild,
                 .srcAccelerationStructure = nullptr,
                 .dstAccelerationStructure = nullptr,
@@ -452,6 +621,70 @@ namespace vulkan {
         return std::tuple{ bottomAccelerationStructure, buildInfo};
     }
 
+    // Static BLAS over one mesh of the shared vertex and index buffers, built by the
+    // fixed-function triangle intersection hardware instead of an intersection shader.
+    inline auto createTriangleBottomAccelerationStructure(vk::Device device, const VulkanBuffer& vertexBuffer, const VulkanBuffer& indexBuffer,
+        const Mesh& mesh, vk::AccelerationStructureGeometryKHR& geometry,
+        const vk::PhysicalDeviceMemoryProperties& memory_properties, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+
+        geometry.geometryType = vk::GeometryTypeKHR::eTriangles;
+        geometry.flags = vk::GeometryFlagBitsKHR::eOpaque;
+        geometry.geometry.triangles.sType = vk::StructureType::eAccelerationStructureGeometryTrianglesDataKHR;
+        geometry.geometry.triangles.vertexFormat = vk::Format::eR32G32B32Sfloat;
+        geometry.geometry.triangles.vertexData.deviceAddress = device.getBufferAddress({ .buffer = vertexBuffer.buffer });
+        geometry.geometry.triangles.vertexStride = sizeof(MeshVertex);
+        geometry.geometry.triangles.maxVertex = mesh.firstVertex + mesh.vertexCount - 1;
+        geometry.geometry.triangles.indexType = vk::IndexType::eUint32;
+        geometry.geometry.triangles.indexData.deviceAddress = device.getBufferAddress({ .buffer = indexBuffer.buffer });
+
+        vk::AccelerationStructureBuildGeometryInfoKHR buildInfo = {
+                .type = vk::AccelerationStructureTypeKHR::eBottomLevel,
+                .flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace | vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction,
+                .mode = vk::BuildAccelerationStructureModeKHR::eBuild,
+                .srcAccelerationStructure = nullptr,
+                .dstAccelerationStructure = nullptr,
+                .geometryCount = 1,
+                .pGeometries = &geometry,
+                .scratchData = {}
+        };
+
+        // Indices are local to the mesh, firstVertex rebases them into the shared vertex buffer.
+        vk::AccelerationStructureBuildRangeInfoKHR buildRangeInfo = {
+                .primitiveCount = mesh.indexCount / 3,
+                .primitiveOffset = static_cast<uint32_t>(sizeof(uint32_t) * mesh.firstIndex),
+                .firstVertex = mesh.firstVertex,
+                .transformOffset = 0
+        };
+
+        vk::AccelerationStructureBuildSizesInfoKHR buildSizesInfo = device.getAccelerationStructureBuildSizesKHR(
+            vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo, { buildRangeInfo.primitiveCount }, dynamicDispatchLoader);
+
+        VulkanAccelerationStructure bottomAccelerationStructure{};
+
+        bottomAccelerationStructure.structureBuffer = vulkan::create_buffer(device, buildSizesInfo.accelerationStructureSize,
+            vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR |
+            vk::BufferUsageFlagBits::eShaderDeviceAddress,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, memory_properties);
+
+        bottomAccelerationStructure.scratchBuffer = vulkan::create_buffer(device, buildSizesInfo.buildScratchSize,
+            vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eShaderDeviceAddress,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, memory_properties);
+
+        bottomAccelerationStructure.accelerationStructure = device.createAccelerationStructureKHR(
+            {
+                    .buffer = bottomAccelerationStructure.structureBuffer.buffer,
+                    .offset = 0,
+                    .size = buildSizesInfo.accelerationStructureSize,
+                    .type = vk::AccelerationStructureTypeKHR::eBottomLevel
+            }, nullptr, dynamicDispatchLoader);
+
+        buildInfo.dstAccelerationStructure = bottomAccelerationStructure.accelerationStructure;
+        buildInfo.scratchData.deviceAddress =
+            device.getBufferAddress({ .buffer = bottomAccelerationStructure.scratchBuffer.buffer });
+        return std::tuple{ bottomAccelerationStructure, buildInfo, buildRangeInfo };
+    }
+
     inline void destroy_acceleration_structure(vk::Device device, const VulkanAccelerationStructure& accelerationStructure, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
         device.destroyAccelerationStructureKHR(accelerationStructure.accelerationStructure, nullptr, dynamicDispatchLoader);
         vulkan::destroy_buffer(device, accelerationStructure.structureBuffer);
@@ -460,8 +693,87 @@ namespace vulkan {
     }
 
 
+    // Places the unit icosphere on a sphere: scale by the radius, translate to the center.
+    inline auto get_sphere_instance_transform(const glm::vec4& geometry) {
+        return vk::TransformMatrixKHR{ .matrix = std::array<std::array<float, 4>, 3>{ {
+                {geometry.w, 0.0f, 0.0f, geometry.x},
+                {0.0f, geometry.w, 0.0f, geometry.y},
+                {0.0f, 0.0f, geometry.w, geometry.z}
+        } } };
+    }
+
+    // Shader binding table hit group of each kind of TLAS instance.
+    const uint32_t procedural_sphere_hit_group = 0;
+    const uint32_t mesh_hit_group = 1;
+    const uint32_t icosphere_hit_group = 2;
+
+    // Spheres come first: either one instance of the procedural sphere BLAS,
+    // or in icosphere mode one icosphere instance per sphere, whose custom
+    // index is the sphere index. One instance per mesh placement follows,
+    // with its index in the mesh instance table as the custom index.
+    inline auto get_top_accel_instances(vk::Device device,
+        SphereMode sphere_mode,
+        vk::AccelerationStructureKHR sphere_bottom_accel,
+        std::span<const Sphere> spheres,
+        uint32_t icosphere_mesh_index,
+        const std::vector<VulkanAccelerationStructure>& mesh_bottom_accels,
+        const MeshScene& mesh_scene,
+        vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        auto get_address = [device, &dynamicDispatchLoader](vk::AccelerationStructureKHR accel) {
+            return device.getAccelerationStructureAddressKHR({ .accelerationStructure = accel }, dynamicDispatchLoader);
+        };
+
+        std::vector<vk::AccelerationStructureInstanceKHR> instances{};
+        if (sphere_mode == SphereMode::Aabb) {
+            instances.push_back(
+                {
+                        .transform = {.matrix = std::array<std::array<float, 4>, 3>{ {
+                                {1.0f, 0.0f, 0.0f, 0.0f},
+                                {0.0f, 1.0f, 0.0f, 0.0f},
+                                {0.0f, 0.0f, 1.0f, 0.0f}
+                        } } },
+                        .instanceCustomIndex = 0,
+                        .mask = 0xFF,
+                        .instanceShaderBindingTableRecordOffset = procedural_sphere_hit_group,
+                        .accelerationStructureReference = get_address(sphere_bottom_accel)
+                });
+        }
+        else {
+            auto icosphere_address = get_address(mesh_bottom_accels[icosphere_mesh_index].accelerationStructure);
+            instances.reserve(spheres.size() + mesh_scene.instances.size());
+            for (uint32_t i = 0; i < spheres.size(); i++) {
+                instances.push_back(
+                    {
+                            .transform = get_sphere_instance_transform(spheres[i].geometry),
+                            .instanceCustomIndex = i,
+                            .mask = 0xFF,
+                            .instanceShaderBindingTableRecordOffset = icosphere_hit_group,
+                            .flags = static_cast<VkGeometryInstanceFlagsKHR>(vk::GeometryInstanceFlagBitsKHR::eTriangleFacingCullDisable),
+                            .accelerationStructureReference = icosphere_address
+                    });
+            }
+        }
+        for (uint32_t i = 0; i < mesh_scene.instances.size(); i++) {
+            auto& instance = mesh_scene.instances[i];
+            instances.push_back(
+                {
+                        .transform = {.matrix = std::array<std::array<float, 4>, 3>{ {
+                                {instance.scale, 0.0f, 0.0f, instance.position.x},
+                                {0.0f, instance.scale, 0.0f, instance.position.y},
+                                {0.0f, 0.0f, instance.scale, instance.position.z}
+                        } } },
+                        .instanceCustomIndex = i,
+                        .mask = 0xFF,
+                        .instanceShaderBindingTableRecordOffset = mesh_hit_group,
+                        .flags = static_cast<VkGeometryInstanceFlagsKHR>(vk::GeometryInstanceFlagBitsKHR::eTriangleFacingCullDisable),
+                        .accelerationStructureReference = get_address(mesh_bottom_accels[instance.meshIndex].accelerationStructure)
+                });
+        }
+        return instances;
+    }
+
     inline auto createTopAccelerationStructure(vk::Device device,
-        vk::AccelerationStructureKHR bottom_accel,
+        std::span<const vk::AccelerationStructureInstanceKHR> instances,
         vk::AccelerationStructureGeometryKHR& geometry,
         const vk::PhysicalDeviceMemoryProperties& memory_properties,
         vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
@@ -484,7 +796,7 @@ namespace vulkan {
 
         // CALCULATE REQUIRED SIZE FOR THE ACCELERATION STRUCTURE
         vk::AccelerationStructureBuildSizesInfoKHR buildSizesInfo = device.getAccelerationStructureBuildSizesKHR(
-            vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo, { 1 }, dynamicDispatchLoader);
+            vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo, { static_cast<uint32_t>(instances.size()) }, dynamicDispatchLoader);
 
         VulkanAccelerationStructure topAccelerationStructure{};
         // ALLOCATE BUFFERS FOR ACCELERATION STRUCTURE
@@ -509,36 +821,20 @@ namespace vulkan {
             device.createAccelerationStructureKHR(createInfo, nullptr, dynamicDispatchLoader);
 
 
-        // CREATE INSTANCE INFO & WRITE IN NEW BUFFER
-        std::array<std::array<float, 4>, 3> matrix = {
-                {
-                        {1.0f, 0.0f, 0.0f, 0.0f},
-                        {0.0f, 1.0f, 0.0f, 0.0f},
-                        {0.0f, 0.0f, 1.0f, 0.0f}
-                } };
-
-        vk::AccelerationStructureInstanceKHR accelerationStructureInstance = {
-                .transform = {.matrix = matrix},
-                .instanceCustomIndex = 0,
-                .mask = 0xFF,
-                .instanceShaderBindingTableRecordOffset = 0,
-                .accelerationStructureReference = device.getAccelerationStructureAddressKHR(
-                        {.accelerationStructure = bottom_accel},
-                        dynamicDispatchLoader),
-        };
-
+        // WRITE INSTANCES IN NEW BUFFER
+        const vk::DeviceSize instancesSize = instances.size_bytes();
         topAccelerationStructure.instancesBuffer = vulkan::create_buffer(
             device,
-            sizeof(vk::AccelerationStructureInstanceKHR),
+            instancesSize,
             vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR |
-            vk::BufferUsageFlagBits::eShaderDeviceAddress,
+            vk::BufferUsageFlagBits::eShaderDeviceAddress |
+            vk::BufferUsageFlagBits::eStorageBuffer,
             vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostCoherent |
             vk::MemoryPropertyFlagBits::eHostVisible,
             memory_properties);
 
-        void* pInstancesBuffer = device.mapMemory(topAccelerationStructure.instancesBuffer.memory, 0,
-            sizeof(vk::AccelerationStructureInstanceKHR));
-        memcpy(pInstancesBuffer, &accelerationStructureInstance, sizeof(vk::AccelerationStructureInstanceKHR));
+        void* pInstancesBuffer = device.mapMemory(topAccelerationStructure.instancesBuffer.memory, 0, instancesSize);
+        memcpy(pInstancesBuffer, instances.data(), instancesSize);
         device.unmapMemory(topAccelerationStructure.instancesBuffer.memory);
 
 
@@ -570,7 +866,7 @@ namespace vulkan {
                 },
                 {
                         .binding = 2,
-                        .descriptorType = vk::DescriptorType::eUniformBuffer,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
                         .descriptorCount = 1,
                         .stageFlags = vk::ShaderStageFlagBits::eIntersectionKHR |
                                       vk::ShaderStageFlagBits::eClosestHitKHR
@@ -586,6 +882,42 @@ namespace vulkan {
                         .descriptorType = vk::DescriptorType::eUniformBuffer,
                         .descriptorCount = 1,
                         .stageFlags = vk::ShaderStageFlagBits::eRaygenKHR
+                },
+                {
+                        .binding = 5,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eClosestHitKHR
+                },
+                {
+                        .binding = 6,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eClosestHitKHR
+                },
+                {
+                        .binding = 7,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eClosestHitKHR
+                },
+                {
+                        .binding = 8,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eClosestHitKHR
+                },
+                {
+                        .binding = 9,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eClosestHitKHR
+                },
+                {
+                        .binding = 10,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eRaygenKHR
                 }
         };
 
@@ -597,25 +929,29 @@ namespace vulkan {
         return rtDescriptorSetLayout;
     }
 
-    inline auto create_descriptor_pool(vk::Device device, uint32_t swapchain_image_count) {
+    inline auto create_descriptor_pool(vk::Device device, uint32_t frame_slot_count) {
         std::vector<vk::DescriptorPoolSize> poolSizes = {
                 {
                         .type = vk::DescriptorType::eStorageImage,
-                        .descriptorCount = 2 * swapchain_image_count
+                        .descriptorCount = 2 * frame_slot_count
                 },
                 {
                         .type = vk::DescriptorType::eAccelerationStructureKHR,
-                        .descriptorCount = 1 * swapchain_image_count
+                        .descriptorCount = 1 * frame_slot_count
+                },
+                {
+                        .type = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 7 * frame_slot_count
                 },
                 {
                         .type = vk::DescriptorType::eUniformBuffer,
-                        .descriptorCount = 2 * swapchain_image_count
+                        .descriptorCount = 1 * frame_slot_count
                 }
         };
 
         auto rtDescriptorPool = device.createDescriptorPool(
             {
-                    .maxSets = swapchain_image_count,
+                    .maxSets = frame_slot_count,
                     .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
                     .pPoolSizes = poolSizes.data()
             });
@@ -623,19 +959,19 @@ namespace vulkan {
     }
 
 
-    inline auto create_sphere_buffer(vk::Device device, const vk::PhysicalDeviceMemoryProperties& memory_properties) {
-        const vk::DeviceSize bufferSize = sizeof(Sphere) * MAX_SPHERE_AMOUNT;
+    inline auto create_sphere_buffer(vk::Device device, uint32_t count, const vk::PhysicalDeviceMemoryProperties& memory_properties) {
+        const vk::DeviceSize bufferSize = sizeof(Sphere) * count;
 
         auto sphereBuffer = vulkan::create_buffer(device, bufferSize,
-            vk::BufferUsageFlagBits::eUniformBuffer,
+            vk::BufferUsageFlagBits::eStorageBuffer,
             vk::MemoryPropertyFlagBits::eHostVisible |
             vk::MemoryPropertyFlagBits::eHostCoherent |
             vk::MemoryPropertyFlagBits::eDeviceLocal, memory_properties);
         return sphereBuffer;
     }
 
-    inline auto create_render_call_info_buffers(vk::Device device, uint32_t swapchain_image_count, const vk::PhysicalDeviceMemoryProperties& memory_properties) {
-        std::vector<VulkanBuffer> renderCallInfoBuffers(swapchain_image_count);
+    inline auto create_render_call_info_buffers(vk::Device device, uint32_t frame_slot_count, const vk::PhysicalDeviceMemoryProperties& memory_properties) {
+        std::vector<VulkanBuffer> renderCallInfoBuffers(frame_slot_count);
         std::ranges::generate(
             renderCallInfoBuffers,
             [device, &memory_properties]() {
@@ -648,15 +984,64 @@ namespace vulkan {
         return renderCallInfoBuffers;
     }
 
-    inline auto create_descriptor_set(vk::Device device, uint32_t swapchain_image_count,
+    // Memory for buffers the host reads every byte of, which is slow from uncached memory.
+    inline vk::MemoryPropertyFlags get_host_read_memory_property(const vk::PhysicalDeviceMemoryProperties& memory_properties) {
+        auto memory_property = vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent };
+        auto cached_memory_property = memory_property | vk::MemoryPropertyFlagBits::eHostCached;
+        if (std::ranges::any_of(
+            std::span{ memory_properties.memoryTypes.data(), memory_properties.memoryTypeCount },
+            [cached_memory_property](auto& memory_type) {
+                return (memory_type.propertyFlags & cached_memory_property) == cached_memory_property;
+            })) {
+            memory_property = cached_memory_property;
+        }
+        return memory_property;
+    }
+
+    // Host visible buffers the render target, or the summed image, of each frame slot is copied to,
+    // from which the host composites the parts of all devices into one image.
+    inline auto create_readback_buffers(vk::Device device, uint32_t frame_slot_count, uint32_t width, uint32_t height, vk::DeviceSize texel_size,
+        const vk::PhysicalDeviceMemoryProperties& memory_properties) {
+        auto memory_property = get_host_read_memory_property(memory_properties);
+        std::vector<VulkanBuffer> readback_buffers(frame_slot_count);
+        std::ranges::generate(
+            readback_buffers,
+            [device, size = vk::DeviceSize{ width } * height * texel_size, memory_property, &memory_properties]() {
+                return vulkan::create_buffer(device, size, vk::BufferUsageFlagBits::eTransferDst, memory_property, memory_properties);
+            });
+        return readback_buffers;
+    }
+
+    // Host visible buffers of one uint per rendered row, to which the ray generation shader adds the
+    // rays it traced for the row when asked to, the cost map the workload is split by.
+    inline auto create_row_cost_buffers(vk::Device device, uint32_t frame_slot_count, uint32_t row_count,
+        const vk::PhysicalDeviceMemoryProperties& memory_properties) {
+        auto memory_property = get_host_read_memory_property(memory_properties);
+        std::vector<VulkanBuffer> row_cost_buffers(frame_slot_count);
+        std::ranges::generate(
+            row_cost_buffers,
+            [device, size = vk::DeviceSize{ row_count } * sizeof(uint32_t), memory_property, &memory_properties]() {
+                return vulkan::create_buffer(device, size, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                    memory_property, memory_properties);
+            });
+        return row_cost_buffers;
+    }
+
+    inline auto create_descriptor_set(vk::Device device, uint32_t frame_slot_count,
         vk::DescriptorSetLayout rtDescriptorSetLayout,
         vk::DescriptorPool rtDescriptorPool,
         const auto& render_target_images,
         const auto& top_accelerations,
         const auto& sphereBuffers,
         const auto& summed_images,
-        const auto& renderCallInfoBuffers) {
-        std::vector<vk::DescriptorSetLayout> layouts(swapchain_image_count);
+        const auto& renderCallInfoBuffers,
+        const VulkanBuffer& sphere_material_index_buffer,
+        const VulkanBuffer& material_buffer,
+        const VulkanBuffer& mesh_vertex_buffer,
+        const VulkanBuffer& mesh_index_buffer,
+        const VulkanBuffer& mesh_instance_buffer,
+        const auto& row_cost_buffers) {
+        std::vector<vk::DescriptorSetLayout> layouts(frame_slot_count);
         std::ranges::fill(layouts, rtDescriptorSetLayout);
         auto rtDescriptorSets = device.allocateDescriptorSets(
             vk::DescriptorSetAllocateInfo{}
@@ -664,7 +1049,7 @@ namespace vulkan {
             .setSetLayouts(layouts)
         );
 
-        auto render_target_image_infos = std::vector<vk::DescriptorImageInfo>(swapchain_image_count);
+        auto render_target_image_infos = std::vector<vk::DescriptorImageInfo>(frame_slot_count);
         std::ranges::transform(
             render_target_images,
             render_target_image_infos.begin(),
@@ -673,7 +1058,7 @@ namespace vulkan {
             }
         );
 
-        auto acceleration_structure_infos = std::vector<vk::WriteDescriptorSetAccelerationStructureKHR>(swapchain_image_count);
+        auto acceleration_structure_infos = std::vector<vk::WriteDescriptorSetAccelerationStructureKHR>(frame_slot_count);
         std::ranges::transform(
             top_accelerations,
             acceleration_structure_infos.begin(),
@@ -685,7 +1070,7 @@ namespace vulkan {
             }
         );
 
-        auto sphere_buffer_infos = std::vector<vk::DescriptorBufferInfo>(swapchain_image_count);
+        auto sphere_buffer_infos = std::vector<vk::DescriptorBufferInfo>(frame_slot_count);
         std::ranges::transform(
             sphereBuffers,
             sphere_buffer_infos.begin(),
@@ -693,12 +1078,12 @@ namespace vulkan {
                 return  vk::DescriptorBufferInfo{
                     .buffer = sphere_buffer.buffer,
                     .offset = 0,
-                    .range = sizeof(Sphere) * MAX_SPHERE_AMOUNT
+                    .range = vk::WholeSize
                 };
             }
         );
 
-        auto summed_image_infos = std::vector<vk::DescriptorImageInfo>(swapchain_image_count);
+        auto summed_image_infos = std::vector<vk::DescriptorImageInfo>(frame_slot_count);
         std::ranges::transform(
             summed_images,
             summed_image_infos.begin(),
@@ -707,10 +1092,31 @@ namespace vulkan {
             }
         );
 
-        std::vector<vk::DescriptorBufferInfo> renderCallInfoBufferInfos(swapchain_image_count);
+        std::vector<vk::DescriptorBufferInfo> renderCallInfoBufferInfos(frame_slot_count);
+
+        auto row_cost_buffer_infos = std::vector<vk::DescriptorBufferInfo>(frame_slot_count);
+        std::ranges::transform(
+            row_cost_buffers,
+            row_cost_buffer_infos.begin(),
+            [](auto& row_cost_buffer) {
+                return vk::DescriptorBufferInfo{}.setBuffer(row_cost_buffer.buffer).setRange(vk::WholeSize);
+            }
+        );
+
+        auto sphere_material_index_buffer_info = vk::DescriptorBufferInfo{}
+            .setBuffer(sphere_material_index_buffer.buffer)
+            .setRange(vk::WholeSize);
+        auto material_buffer_info = vk::DescriptorBufferInfo{}
+            .setBuffer(material_buffer.buffer)
+            .setRange(vk::WholeSize);
+        auto mesh_buffer_infos = std::array{
+            vk::DescriptorBufferInfo{}.setBuffer(mesh_vertex_buffer.buffer).setRange(vk::WholeSize),
+            vk::DescriptorBufferInfo{}.setBuffer(mesh_index_buffer.buffer).setRange(vk::WholeSize),
+            vk::DescriptorBufferInfo{}.setBuffer(mesh_instance_buffer.buffer).setRange(vk::WholeSize)
+        };
 
         std::vector<vk::WriteDescriptorSet> descriptorWrites{};
-        for (int i = 0; i < swapchain_image_count; i++) {
+        for (int i = 0; i < frame_slot_count; i++) {
             auto set = rtDescriptorSets[i];
             descriptorWrites.push_back(
                 {
@@ -736,7 +1142,7 @@ namespace vulkan {
                         .dstBinding = 2,
                         .dstArrayElement = 0,
                         .descriptorCount = 1,
-                        .descriptorType = vk::DescriptorType::eUniformBuffer,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
                         .pBufferInfo = &sphere_buffer_infos[i]
                 });
             descriptorWrites.push_back(
@@ -760,6 +1166,60 @@ namespace vulkan {
                         .descriptorType = vk::DescriptorType::eUniformBuffer,
                         .pBufferInfo = &renderCallInfoBufferInfos[i]
                 });
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 5,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &sphere_material_index_buffer_info
+                });
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 6,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &material_buffer_info
+                });
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 7,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &mesh_buffer_infos[0]
+                });
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 8,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &mesh_buffer_infos[1]
+                });
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 9,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &mesh_buffer_infos[2]
+                });
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 10,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &row_cost_buffer_infos[i]
+                });
         };
 
         device.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(),
@@ -769,12 +1229,18 @@ namespace vulkan {
     }
 
     inline auto create_pipeline_layout(vk::Device device, vk::DescriptorSetLayout rtDescriptorSetLayout) {
+        // The offset of the traced tile.
+        vk::PushConstantRange tile_offset_range = {
+                .stageFlags = vk::ShaderStageFlagBits::eRaygenKHR,
+                .offset = 0,
+                .size = sizeof(glm::uvec2)
+        };
         auto rtPipelineLayout = device.createPipelineLayout(
             {
                     .setLayoutCount = 1,
                     .pSetLayouts = &rtDescriptorSetLayout,
-                    .pushConstantRangeCount = 0,
-                    .pPushConstantRanges = nullptr
+                    .pushConstantRangeCount = 1,
+                    .pPushConstantRanges = &tile_offset_range
             });
         return rtPipelineLayout;
     }
@@ -812,6 +1278,8 @@ namespace vulkan {
         vk::ShaderModule intModule = createShaderModule(device, rint_shader_path);
         vk::ShaderModule chitModule = createShaderModule(device, rchit_shader_path);
         vk::ShaderModule missModule = createShaderModule(device, rmiss_shader_path);
+        vk::ShaderModule triangleChitModule = createShaderModule(device, triangle_rchit_shader_path);
+        vk::ShaderModule icosphereChitModule = createShaderModule(device, icosphere_rchit_shader_path);
 
         std::vector<vk::PipelineShaderStageCreateInfo> stages = {
                 {
@@ -833,6 +1301,16 @@ namespace vulkan {
                         .stage = vk::ShaderStageFlagBits::eClosestHitKHR,
                         .module = chitModule,
                         .pName = "main"
+                },
+                {
+                        .stage = vk::ShaderStageFlagBits::eClosestHitKHR,
+                        .module = triangleChitModule,
+                        .pName = "main"
+                },
+                {
+                        .stage = vk::ShaderStageFlagBits::eClosestHitKHR,
+                        .module = icosphereChitModule,
+                        .pName = "main"
                 }
         };
 
@@ -857,6 +1335,20 @@ namespace vulkan {
                         .closestHitShader = 3,
                         .anyHitShader = VK_SHADER_UNUSED_KHR,
                         .intersectionShader = 1
+                },
+                {
+                        .type = vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
+                        .generalShader = VK_SHADER_UNUSED_KHR,
+                        .closestHitShader = 4,
+                        .anyHitShader = VK_SHADER_UNUSED_KHR,
+                        .intersectionShader = VK_SHADER_UNUSED_KHR
+                },
+                {
+                        .type = vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
+                        .generalShader = VK_SHADER_UNUSED_KHR,
+                        .closestHitShader = 5,
+                        .anyHitShader = VK_SHADER_UNUSED_KHR,
+                        .intersectionShader = VK_SHADER_UNUSED_KHR
                 }
         };
 
@@ -882,6 +1374,8 @@ namespace vulkan {
         device.destroyShaderModule(chitModule);
         device.destroyShaderModule(missModule);
         device.destroyShaderModule(intModule);
+        device.destroyShaderModule(triangleChitModule);
+        device.destroyShaderModule(icosphereChitModule);
 
         return rtPipeline;
     }
@@ -897,7 +1391,9 @@ namespace vulkan {
         uint32_t handleSize = rayTracingProperties.shaderGroupHandleSize;
 
 
-        const uint32_t shaderGroupCount = 3;
+        // raygen, miss, then the procedural sphere, mesh and icosphere hit groups.
+        const uint32_t shaderGroupCount = 5;
+        const uint32_t hitGroupCount = 3;
         vk::DeviceSize sbtBufferSize = baseAlignment * shaderGroupCount;
 
         auto shaderBindingTableBuffer = vulkan::create_buffer(device, sbtBufferSize,
@@ -927,49 +1423,299 @@ namespace vulkan {
         sbtMissAddressRegion.deviceAddress = sbtAddress + baseAlignment;
 
         auto sbtHitAddressRegion = addressRegion;
+        sbtHitAddressRegion.size = baseAlignment * hitGroupCount;
         sbtHitAddressRegion.deviceAddress = sbtAddress + baseAlignment * 2;
 
         uint8_t* sbtBufferData = static_cast<uint8_t*>(device.mapMemory(shaderBindingTableBuffer.memory, 0, sbtBufferSize));
 
         memcpy(sbtBufferData, handles.data(), handleSize);
         memcpy(sbtBufferData + baseAlignment, handles.data() + handleSize, handleSize);
-        memcpy(sbtBufferData + baseAlignment * 2, handles.data() + handleSize * 2, handleSize);
+        for (uint32_t i = 0; i < hitGroupCount; i++) {
+            memcpy(sbtBufferData + baseAlignment * (2 + i), handles.data() + handleSize * (2 + i), handleSize);
+        }
 
         device.unmapMemory(shaderBindingTableBuffer.memory);
 
         return std::tuple{ shaderBindingTableBuffer, sbtRayGenAddressRegion, sbtMissAddressRegion, sbtHitAddressRegion };
     }
 
-    inline auto record_ray_tracing(vk::CommandBuffer commandBuffer, uint32_t queue_family, vk::Image render_target_image, vk::Image summed_image,
-        vk::Pipeline pipeline, vk::DescriptorSet descriptor_set, vk::PipelineLayout pipeline_layout,
-        vk::StridedDeviceAddressRegionKHR sbtRayGenAddressRegion, vk::StridedDeviceAddressRegionKHR sbtMissAddressRegion, vk::StridedDeviceAddressRegionKHR sbtHitAddressRegion,
-        uint32_t width, uint32_t height, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
-        // RENDER TARGET IMAGE UNDEFINED -> GENERAL
-        // Sync summed pixel color image with previous ray tracing.
-        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR,
-            vk::PipelineStageFlagBits::eRayTracingShaderKHR,
-            vk::DependencyFlagBits::eByRegion, {}, {},
-            std::array{
-                vk::ImageMemoryBarrier{
-                .srcAccessMask = vk::AccessFlagBits::eNoneKHR,
-                .dstAccessMask = vk::AccessFlagBits::eShaderWrite,
-                .oldLayout = vk::ImageLayout::eUndefined,
-                .newLayout = vk::ImageLayout::eGeneral,
-                .srcQueueFamilyIndex = queue_family,
-                .dstQueueFamilyIndex = queue_family,
-                .image = render_target_image,
-                .subresourceRange = {
-                        .aspectMask = vk::ImageAspectFlagBits::eColor,
-                        .baseMipLevel = 0,
-                        .levelCount = 1,
-                        .baseArrayLayer = 0,
-                        .layerCount = 1
-                },
-                },
-                vk::ImageMemoryBarrier{
-                .srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead,
-                .dstAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead,
-                .oldLayout = vk::ImageLayout::eGeneral,
+    // Storage buffer holding immutable scene data, written once at creation.
+    // An empty table still gets one element so it can be bound.
+    template<typename T>
+    inline auto create_static_storage_buffer(vk::Device device, std::span<const T> elements, const vk::PhysicalDeviceMemoryProperties& memory_properties,
+        vk::BufferUsageFlags extra_usage = {}) {
+        const vk::DeviceSize bufferSize = sizeof(T) * std::max<size_t>(elements.size(), 1);
+
+        auto buffer = vulkan::create_buffer(device, bufferSize,
+            vk::BufferUsageFlagBits::eStorageBuffer | extra_usage,
+            vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent |
+            vk::MemoryPropertyFlagBits::eDeviceLocal, memory_properties);
+
+        void* data = device.mapMemory(buffer.memory, 0, bufferSize);
+        memcpy(data, elements.data(), elements.size_bytes());
+        device.unmapMemory(buffer.memory);
+        return buffer;
+    }
+
+    inline auto create_animation_buffer(vk::Device device, std::span<const SphereAnimation> animations, const vk::PhysicalDeviceMemoryProperties& memory_properties) {
+        return create_static_storage_buffer(device, animations, memory_properties);
+    }
+
+    inline auto create_material_buffers(vk::Device device, std::span<const uint32_t> sphere_material_indices, std::span<const Material> materials,
+        const vk::PhysicalDeviceMemoryProperties& memory_properties) {
+        auto sphereMaterialIndexBuffer = create_static_storage_buffer(device, sphere_material_indices, memory_properties);
+        auto materialBuffer = create_static_storage_buffer(device, materials, memory_properties);
+        return std::tuple{ sphereMaterialIndexBuffer, materialBuffer };
+    }
+
+    inline auto create_mesh_buffers(vk::Device device, const MeshScene& mesh_scene, const vk::PhysicalDeviceMemoryProperties& memory_properties) {
+        const auto build_input_usage = vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+        auto vertexBuffer = create_static_storage_buffer(device, std::span{ mesh_scene.vertices }, memory_properties, build_input_usage);
+        auto indexBuffer = create_static_storage_buffer(device, std::span{ mesh_scene.indices }, memory_properties, build_input_usage);
+        auto instance_infos = getMeshInstanceInfos(mesh_scene);
+        auto instanceBuffer = create_static_storage_buffer(device, std::span<const MeshInstanceInfo>{ instance_infos }, memory_properties);
+        return std::tuple{ vertexBuffer, indexBuffer, instanceBuffer };
+    }
+
+    inline auto create_animation_descriptor_set_layout(vk::Device device) {
+        std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+                {
+                        .binding = 0,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eCompute
+                },
+                {
+                        .binding = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eCompute
+                },
+                {
+                        .binding = 2,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eCompute
+                },
+                {
+                        .binding = 3,
+                        .descriptorType = vk::DescriptorType::eUniformBuffer,
+                        .descriptorCount = 1,
+                        .stageFlags = vk::ShaderStageFlagBits::eCompute
+                }
+        };
+
+        return device.createDescriptorSetLayout(
+            {
+                    .bindingCount = static_cast<uint32_t>(bindings.size()),
+                    .pBindings = bindings.data()
+            });
+    }
+
+    inline auto create_animation_descriptor_pool(vk::Device device, uint32_t frame_slot_count) {
+        std::vector<vk::DescriptorPoolSize> poolSizes = {
+                {
+                        .type = vk::DescriptorType::eStorageBuffer,
+                        .descriptorCount = 3 * frame_slot_count
+                },
+                {
+                        .type = vk::DescriptorType::eUniformBuffer,
+                        .descriptorCount = 1 * frame_slot_count
+                }
+        };
+
+        return device.createDescriptorPool(
+            {
+                    .maxSets = frame_slot_count,
+                    .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+                    .pPoolSizes = poolSizes.data()
+            });
+    }
+
+    inline auto create_animation_descriptor_sets(vk::Device device, uint32_t frame_slot_count,
+        vk::DescriptorSetLayout descriptor_set_layout,
+        vk::DescriptorPool descriptor_pool,
+        const VulkanBuffer& animation_buffer, uint32_t animation_count,
+        const auto& sphere_buffers,
+        const auto& geometry_output_buffers,
+        const auto& render_call_info_buffers) {
+        std::vector<vk::DescriptorSetLayout> layouts(frame_slot_count);
+        std::ranges::fill(layouts, descriptor_set_layout);
+        auto descriptor_sets = device.allocateDescriptorSets(
+            vk::DescriptorSetAllocateInfo{}
+            .setDescriptorPool(descriptor_pool)
+            .setSetLayouts(layouts)
+        );
+
+        auto animation_buffer_info = vk::DescriptorBufferInfo{
+            .buffer = animation_buffer.buffer,
+            .offset = 0,
+            .range = sizeof(SphereAnimation) * animation_count
+        };
+        std::vector<vk::DescriptorBufferInfo> sphere_buffer_infos(frame_slot_count);
+        std::vector<vk::DescriptorBufferInfo> geometry_output_buffer_infos(frame_slot_count);
+        std::vector<vk::DescriptorBufferInfo> render_call_info_buffer_infos(frame_slot_count);
+
+        std::vector<vk::WriteDescriptorSet> descriptorWrites{};
+        for (int i = 0; i < frame_slot_count; i++) {
+            auto set = descriptor_sets[i];
+            sphere_buffer_infos[i] = vk::DescriptorBufferInfo{
+                .buffer = sphere_buffers[i].buffer,
+                .offset = 0,
+                .range = vk::WholeSize
+            };
+            geometry_output_buffer_infos[i] = vk::DescriptorBufferInfo{
+                .buffer = geometry_output_buffers[i].buffer,
+                .offset = 0,
+                .range = vk::WholeSize
+            };
+            render_call_info_buffer_infos[i] = vk::DescriptorBufferInfo{}
+                .setBuffer(render_call_info_buffers[i].buffer)
+                .setRange(vk::WholeSize);
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 0,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &animation_buffer_info
+                });
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 1,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &sphere_buffer_infos[i]
+                });
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 2,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &geometry_output_buffer_infos[i]
+                });
+            descriptorWrites.push_back(
+                {
+                        .dstSet = set,
+                        .dstBinding = 3,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eUniformBuffer,
+                        .pBufferInfo = &render_call_info_buffer_infos[i]
+                });
+        }
+
+        device.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(),
+            0, nullptr);
+
+        return descriptor_sets;
+    }
+
+    // The pass writes animated spheres either as AABBs or, in icosphere mode,
+    // as the transforms of their TLAS instances.
+    inline auto create_animation_pipeline(vk::Device device, vk::PipelineLayout pipeline_layout, SphereMode sphere_mode) {
+        vk::ShaderModule compModule = createShaderModule(device, comp_shader_path);
+
+        const vk::Bool32 write_instance_transforms = sphere_mode == SphereMode::Icosphere;
+        auto specialization_map_entry = vk::SpecializationMapEntry{ .constantID = 0, .offset = 0, .size = sizeof(vk::Bool32) };
+        auto specialization_info = vk::SpecializationInfo{
+                .mapEntryCount = 1,
+                .pMapEntries = &specialization_map_entry,
+                .dataSize = sizeof(write_instance_transforms),
+                .pData = &write_instance_transforms
+        };
+
+        vk::ComputePipelineCreateInfo pipelineCreateInfo = {
+                .stage = {
+                        .stage = vk::ShaderStageFlagBits::eCompute,
+                        .module = compModule,
+                        .pName = "main",
+                        .pSpecializationInfo = &specialization_info
+                },
+                .layout = pipeline_layout
+        };
+
+        auto pipeline = device.createComputePipeline(nullptr, pipelineCreateInfo).value;
+
+        device.destroyShaderModule(compModule);
+
+        return pipeline;
+    }
+
+    inline auto record_scene_animation(vk::CommandBuffer commandBuffer, vk::Pipeline pipeline, vk::DescriptorSet descriptor_set, vk::PipelineLayout pipeline_layout,
+        uint32_t animation_count) {
+        const uint32_t workgroup_size = 64;
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout,
+            0, descriptor_set, nullptr);
+        commandBuffer.dispatch((animation_count + workgroup_size - 1) / workgroup_size, 1, 1);
+
+        // Animated geometry is read by the BLAS build (AABBs) and the hit shaders (spheres).
+        commandBuffer.pipelineBarrier2(
+            vk::DependencyInfo{}
+            .setMemoryBarriers(
+                vk::MemoryBarrier2{}
+                .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eAccelerationStructureBuildKHR | vk::PipelineStageFlagBits2::eRayTracingShaderKHR)
+                .setDstAccessMask(vk::AccessFlagBits2::eShaderRead)
+            )
+        );
+    }
+
+    // Traces width x height pixels of the render target starting at tile_offset.
+    inline void record_trace_rays(vk::CommandBuffer commandBuffer,
+        vk::Pipeline pipeline, vk::DescriptorSet descriptor_set, vk::PipelineLayout pipeline_layout,
+        vk::StridedDeviceAddressRegionKHR sbtRayGenAddressRegion, vk::StridedDeviceAddressRegionKHR sbtMissAddressRegion, vk::StridedDeviceAddressRegionKHR sbtHitAddressRegion,
+        glm::uvec2 tile_offset, uint32_t width, uint32_t height, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, pipeline);
+
+        std::vector<vk::DescriptorSet> descriptorSets = { descriptor_set };
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, pipeline_layout,
+            0, descriptorSets, nullptr);
+        commandBuffer.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eRaygenKHR, 0, sizeof(tile_offset), &tile_offset);
+
+        commandBuffer.traceRaysKHR(sbtRayGenAddressRegion, sbtMissAddressRegion, sbtHitAddressRegion, {},
+            width, height, 1, dynamicDispatchLoader);
+    }
+
+    inline auto record_ray_tracing(vk::CommandBuffer commandBuffer, uint32_t queue_family, vk::Image render_target_image, vk::Image summed_image,
+        vk::Pipeline pipeline, vk::DescriptorSet descriptor_set, vk::PipelineLayout pipeline_layout,
+        vk::StridedDeviceAddressRegionKHR sbtRayGenAddressRegion, vk::StridedDeviceAddressRegionKHR sbtMissAddressRegion, vk::StridedDeviceAddressRegionKHR sbtHitAddressRegion,
+        uint32_t width, uint32_t height, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        // RENDER TARGET IMAGE UNDEFINED -> GENERAL
+        // Sync summed pixel color image with previous ray tracing.
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+            vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+            vk::DependencyFlagBits::eByRegion, {}, {},
+            std::array{
+                vk::ImageMemoryBarrier{
+                .srcAccessMask = vk::AccessFlagBits::eNoneKHR,
+                .dstAccessMask = vk::AccessFlagBits::eShaderWrite,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = vk::ImageLayout::eGeneral,
+                .srcQueueFamilyIndex = queue_family,
+                .dstQueueFamilyIndex = queue_family,
+                .image = render_target_image,
+                .subresourceRange = {
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1
+                },
+                },
+                vk::ImageMemoryBarrier{
+                .srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead,
+                .dstAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead,
+                .oldLayout = vk::ImageLayout::eGeneral,
                 .newLayout = vk::ImageLayout::eGeneral,
                 .srcQueueFamilyIndex = queue_family,
                 .dstQueueFamilyIndex = queue_family,
@@ -985,39 +1731,31 @@ namespace vulkan {
             });
 
         // RAY TRACING
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, pipeline);
-
-        std::vector<vk::DescriptorSet> descriptorSets = { descriptor_set };
-        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, pipeline_layout,
-            0, descriptorSets, nullptr);
-
-        commandBuffer.traceRaysKHR(sbtRayGenAddressRegion, sbtMissAddressRegion, sbtHitAddressRegion, {},
-            width, height, 1, dynamicDispatchLoader);
+        record_trace_rays(commandBuffer, pipeline, descriptor_set, pipeline_layout,
+            sbtRayGenAddressRegion, sbtMissAddressRegion, sbtHitAddressRegion,
+            glm::uvec2{ 0, 0 }, width, height, dynamicDispatchLoader);
     }
 
-    inline auto create_command_buffers(vk::Device device, vk::CommandPool commandPool, uint32_t swapchain_images_count, const auto& swapchain_images,
-        uint32_t queue_family, auto& render_target_images, auto& summed_images,
-        vk::Pipeline pipeline, const auto& descriptor_sets, vk::PipelineLayout pipeline_layout,
+    // Animation and acceleration structure builds of one frame slot, between its two timestamps.
+    inline void record_acceleration_structure_builds(vk::CommandBuffer commandBuffer, uint32_t frame_slot, uint32_t queue_family,
+        vk::Pipeline animation_pipeline, const auto& animation_descriptor_sets, vk::PipelineLayout animation_pipeline_layout, uint32_t animation_count,
         auto& aabbs, auto& bottom_accel_build_infos, auto& bottom_accels,
-        auto& top_accel_build_infos, auto& top_accels,
-        vk::StridedDeviceAddressRegionKHR sbtRayGenAddressRegion, vk::StridedDeviceAddressRegionKHR sbtMissAddressRegion, vk::StridedDeviceAddressRegionKHR sbtHitAddressRegion,
-        uint32_t width, uint32_t height, vk::Extent2D image_extent, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
-        auto commandBuffers = std::vector<vk::CommandBuffer>(swapchain_images_count);
-        for (int swapChainImageIndex = 0; swapChainImageIndex < swapchain_images_count; swapChainImageIndex++) {
-            auto& commandBuffer = commandBuffers[swapChainImageIndex];
-            auto& swapChainImage = swapchain_images[swapChainImageIndex];
-            commandBuffer = device.allocateCommandBuffers(
-                {
-                        .commandPool = commandPool,
-                        .level = vk::CommandBufferLevel::ePrimary,
-                        .commandBufferCount = 1
-                }).front();
-
-            vk::CommandBufferBeginInfo beginInfo = {};
-            commandBuffer.begin(&beginInfo);
+        auto& top_accel_build_infos, const auto& top_accels, uint32_t top_accel_instance_count,
+        vk::QueryPool timestamp_query_pool, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        const uint32_t first_timestamp = 2 * frame_slot;
+        commandBuffer.resetQueryPool(timestamp_query_pool, first_timestamp, 2);
+
+        // ANIMATE THE SCENE
+        if (animation_count > 0) {
+            record_scene_animation(commandBuffer, animation_pipeline, animation_descriptor_sets[frame_slot], animation_pipeline_layout, animation_count);
+        }
 
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, timestamp_query_pool, first_timestamp);
 
-            // BUILD THE ACCELERATION STRUCTURE
+        // BUILD THE ACCELERATION STRUCTURE
+        // There is no sphere BLAS in icosphere mode, and a static one is built
+        // once at startup, in both cases there are no build infos.
+        if (!bottom_accel_build_infos.empty()) {
             vk::AccelerationStructureBuildRangeInfoKHR buildRangeInfo = {
                     .primitiveCount = static_cast<uint32_t>(aabbs.size()),
                     .primitiveOffset = 0,
@@ -1026,37 +1764,80 @@ namespace vulkan {
             };
 
             const vk::AccelerationStructureBuildRangeInfoKHR* pBuildRangeInfos[] = { &buildRangeInfo };
-            commandBuffer.buildAccelerationStructuresKHR(1, &bottom_accel_build_infos[swapChainImageIndex], pBuildRangeInfos, dynamicDispatchLoader);
+            commandBuffer.buildAccelerationStructuresKHR(1, &bottom_accel_build_infos[frame_slot], pBuildRangeInfos, dynamicDispatchLoader);
             commandBuffer.pipelineBarrier2(
                 vk::DependencyInfo{}
                 .setBufferMemoryBarriers(
-                    vk::BufferMemoryBarrier2{}.setBuffer(bottom_accels[swapChainImageIndex].structureBuffer.buffer).setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite).setDstAccessMask(vk::AccessFlagBits2::eMemoryWrite)
+                    vk::BufferMemoryBarrier2{}.setBuffer(bottom_accels[frame_slot].structureBuffer.buffer).setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite).setDstAccessMask(vk::AccessFlagBits2::eMemoryWrite)
                     .setSrcQueueFamilyIndex(queue_family).setDstQueueFamilyIndex(queue_family)
                     .setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands).setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
                     .setSize(vk::WholeSize)
                 )
                 );
+        }
 
-            // BUILD THE ACCELERATION STRUCTURE
+        // BUILD THE ACCELERATION STRUCTURE
+        // The TLAS of a static scene is shared by all frame slots and built once at startup.
+        if (!top_accel_build_infos.empty()) {
             vk::AccelerationStructureBuildRangeInfoKHR top_buildRangeInfo = {
-                    .primitiveCount = 1,
+                    .primitiveCount = top_accel_instance_count,
                     .primitiveOffset = 0,
                     .firstVertex = 0,
                     .transformOffset = 0
             };
 
             const vk::AccelerationStructureBuildRangeInfoKHR* p_top_BuildRangeInfos[] = { &top_buildRangeInfo };
-            commandBuffer.buildAccelerationStructuresKHR(1, &top_accel_build_infos[swapChainImageIndex], p_top_BuildRangeInfos, dynamicDispatchLoader);
+            commandBuffer.buildAccelerationStructuresKHR(1, &top_accel_build_infos[frame_slot], p_top_BuildRangeInfos, dynamicDispatchLoader);
 
             commandBuffer.pipelineBarrier2(
                 vk::DependencyInfo{}
                 .setBufferMemoryBarriers(
-                    vk::BufferMemoryBarrier2{}.setBuffer(top_accels[swapChainImageIndex].structureBuffer.buffer).setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite).setDstAccessMask(vk::AccessFlagBits2::eMemoryWrite)
+                    vk::BufferMemoryBarrier2{}.setBuffer(top_accels[frame_slot].structureBuffer.buffer).setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite).setDstAccessMask(vk::AccessFlagBits2::eMemoryWrite)
                     .setSrcQueueFamilyIndex(queue_family).setDstQueueFamilyIndex(queue_family)
                     .setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands).setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
                     .setSize(vk::WholeSize)
                 )
             );
+        }
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, timestamp_query_pool, first_timestamp + 1);
+    }
+
+    // Trace command buffers are prerecorded for every pair of frame slot and swapchain image,
+    // at frame_slot * swapchain image count + image: the frame slot selects the per-frame
+    // resources, the swapchain image the copy destination.
+    inline auto create_command_buffers(vk::Device device, vk::CommandPool commandPool, uint32_t frame_slot_count, const auto& swapchain_images,
+        uint32_t queue_family, auto& render_target_images, auto& summed_images, const auto& readback_buffers, const auto& row_cost_buffers,
+        vk::Pipeline pipeline, const auto& descriptor_sets, vk::PipelineLayout pipeline_layout,
+        vk::Pipeline animation_pipeline, const auto& animation_descriptor_sets, vk::PipelineLayout animation_pipeline_layout, uint32_t animation_count,
+        auto& aabbs, auto& bottom_accel_build_infos, auto& bottom_accels,
+        auto& top_accel_build_infos, const auto& top_accels, uint32_t top_accel_instance_count,
+        vk::QueryPool timestamp_query_pool, bool record_builds,
+        vk::StridedDeviceAddressRegionKHR sbtRayGenAddressRegion, vk::StridedDeviceAddressRegionKHR sbtMissAddressRegion, vk::StridedDeviceAddressRegionKHR sbtHitAddressRegion,
+        uint32_t width, uint32_t height, vk::Extent2D image_extent, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        auto swapchain_images_count = static_cast<uint32_t>(swapchain_images.size());
+        auto commandBuffers = std::vector<vk::CommandBuffer>(frame_slot_count * swapchain_images_count);
+        for (uint32_t commandBufferIndex = 0; commandBufferIndex < commandBuffers.size(); commandBufferIndex++) {
+            auto frame_slot = commandBufferIndex / swapchain_images_count;
+            auto swapChainImageIndex = commandBufferIndex % swapchain_images_count;
+            auto& commandBuffer = commandBuffers[commandBufferIndex];
+            auto& swapChainImage = swapchain_images[swapChainImageIndex];
+            commandBuffer = device.allocateCommandBuffers(
+                {
+                        .commandPool = commandPool,
+                        .level = vk::CommandBufferLevel::ePrimary,
+                        .commandBufferCount = 1
+                }).front();
+
+            vk::CommandBufferBeginInfo beginInfo = {};
+            commandBuffer.begin(&beginInfo);
+
+            if (record_builds) {
+                record_acceleration_structure_builds(commandBuffer, frame_slot, queue_family,
+                    animation_pipeline, animation_descriptor_sets, animation_pipeline_layout, animation_count,
+                    aabbs, bottom_accel_build_infos, bottom_accels,
+                    top_accel_build_infos, top_accels, top_accel_instance_count,
+                    timestamp_query_pool, dynamicDispatchLoader);
+            }
 
             commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
                 vk::PipelineStageFlagBits::eTransfer,
@@ -1069,7 +1850,7 @@ namespace vulkan {
                     .newLayout = vk::ImageLayout::eTransferDstOptimal,
                     .srcQueueFamilyIndex = queue_family,
                     .dstQueueFamilyIndex = queue_family,
-                    .image = summed_images[swapChainImageIndex].image,
+                    .image = summed_images[frame_slot].image,
                     .subresourceRange = {
                             .aspectMask = vk::ImageAspectFlagBits::eColor,
                             .baseMipLevel = 0,
@@ -1078,7 +1859,7 @@ namespace vulkan {
                             .layerCount = 1
                     },
                 });
-            commandBuffer.clearColorImage(summed_images[swapChainImageIndex].image, vk::ImageLayout::eTransferDstOptimal,
+            commandBuffer.clearColorImage(summed_images[frame_slot].image, vk::ImageLayout::eTransferDstOptimal,
                 vk::ClearColorValue{},
                 vk::ImageSubresourceRange{}
                 .setAspectMask(vk::ImageAspectFlagBits::eColor)
@@ -1095,7 +1876,7 @@ namespace vulkan {
                     .newLayout = vk::ImageLayout::eGeneral,
                     .srcQueueFamilyIndex = queue_family,
                     .dstQueueFamilyIndex = queue_family,
-                    .image = summed_images[swapChainImageIndex].image,
+                    .image = summed_images[frame_slot].image,
                     .subresourceRange = {
                             .aspectMask = vk::ImageAspectFlagBits::eColor,
                             .baseMipLevel = 0,
@@ -1105,11 +1886,39 @@ namespace vulkan {
                     },
                 });
 
-            record_ray_tracing(commandBuffer, queue_family, render_target_images[swapChainImageIndex].image, summed_images[swapChainImageIndex].image,
-                pipeline, descriptor_sets[swapChainImageIndex], pipeline_layout,
+            // The ray generation shader adds to the row costs only if the render call info asks for them.
+            commandBuffer.fillBuffer(row_cost_buffers[frame_slot].buffer, 0, vk::WholeSize, 0);
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                {}, {},
+                vk::BufferMemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                    .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                    .srcQueueFamilyIndex = queue_family,
+                    .dstQueueFamilyIndex = queue_family,
+                    .buffer = row_cost_buffers[frame_slot].buffer,
+                    .offset = 0,
+                    .size = vk::WholeSize
+                },
+                {});
+
+            record_ray_tracing(commandBuffer, queue_family, render_target_images[frame_slot].image, summed_images[frame_slot].image,
+                pipeline, descriptor_sets[frame_slot], pipeline_layout,
                 sbtRayGenAddressRegion, sbtMissAddressRegion, sbtHitAddressRegion,
                 width, height, dynamicDispatchLoader);
 
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::PipelineStageFlagBits::eHost,
+                {}, {},
+                vk::BufferMemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                    .dstAccessMask = vk::AccessFlagBits::eHostRead,
+                    .srcQueueFamilyIndex = queue_family,
+                    .dstQueueFamilyIndex = queue_family,
+                    .buffer = row_cost_buffers[frame_slot].buffer,
+                    .offset = 0,
+                    .size = vk::WholeSize
+                },
+                {});
+
             // RENDER TARGET IMAGE: GENERAL -> TRANSFER SRC & SWAP CHAIN IMAGE: UNDEFINED -> TRANSFER DST
             vk::ImageMemoryBarrier imageBarriersToTransfer[2] = {
                 vk::ImageMemoryBarrier{
@@ -1119,7 +1928,7 @@ namespace vulkan {
                     .newLayout = vk::ImageLayout::eTransferSrcOptimal,
                     .srcQueueFamilyIndex = queue_family,
                     .dstQueueFamilyIndex = queue_family,
-                    .image = render_target_images[swapChainImageIndex].image,
+                    .image = render_target_images[frame_slot].image,
                     .subresourceRange = {
                             .aspectMask = vk::ImageAspectFlagBits::eColor,
                             .baseMipLevel = 0,
@@ -1171,9 +1980,37 @@ namespace vulkan {
                     }
             };
 
-            commandBuffer.copyImage(render_target_images[swapChainImageIndex].image, vk::ImageLayout::eTransferSrcOptimal, swapChainImage,
+            commandBuffer.copyImage(render_target_images[frame_slot].image, vk::ImageLayout::eTransferSrcOptimal, swapChainImage,
                 vk::ImageLayout::eTransferDstOptimal, 1, &imageCopy);
 
+            // COPY RENDER TARGET IMAGE TO READBACK BUFFER, read by the host once the frame is done
+            vk::BufferImageCopy readbackCopy = {
+                    .bufferOffset = 0,
+                    .bufferRowLength = 0,
+                    .bufferImageHeight = 0,
+                    .imageSubresource = subresourceLayers,
+                    .imageOffset = {0, 0, 0},
+                    .imageExtent = {
+                            .width = std::min(width, image_extent.width),
+                            .height = std::min(height, image_extent.height),
+                            .depth = 1
+                    }
+            };
+            commandBuffer.copyImageToBuffer(render_target_images[frame_slot].image, vk::ImageLayout::eTransferSrcOptimal,
+                readback_buffers[frame_slot].buffer, 1, &readbackCopy);
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                {}, {},
+                vk::BufferMemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                    .dstAccessMask = vk::AccessFlagBits::eHostRead,
+                    .srcQueueFamilyIndex = queue_family,
+                    .dstQueueFamilyIndex = queue_family,
+                    .buffer = readback_buffers[frame_slot].buffer,
+                    .offset = 0,
+                    .size = vk::WholeSize
+                },
+                {});
+
 
             // SWAP CHAIN IMAGE: TRANSFER DST -> PRESENT
             vk::ImageMemoryBarrier barrierSwapChainToPresent = vk::ImageMemoryBarrier{
@@ -1204,6 +2041,303 @@ namespace vulkan {
     }
 
 
+    // Command buffers of the build queue: the animation and acceleration structure builds of
+    // each frame slot, which the trace on the compute queue waits for with a semaphore.
+    inline auto create_build_command_buffers(vk::Device device, vk::CommandPool commandPool, uint32_t frame_slot_count, uint32_t queue_family,
+        vk::Pipeline animation_pipeline, const auto& animation_descriptor_sets, vk::PipelineLayout animation_pipeline_layout, uint32_t animation_count,
+        auto& aabbs, auto& bottom_accel_build_infos, auto& bottom_accels,
+        auto& top_accel_build_infos, const auto& top_accels, uint32_t top_accel_instance_count,
+        vk::QueryPool timestamp_query_pool, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        auto commandBuffers = device.allocateCommandBuffers(
+            {
+                    .commandPool = commandPool,
+                    .level = vk::CommandBufferLevel::ePrimary,
+                    .commandBufferCount = frame_slot_count
+            });
+        for (uint32_t frame_slot = 0; frame_slot < frame_slot_count; frame_slot++) {
+            auto& commandBuffer = commandBuffers[frame_slot];
+            vk::CommandBufferBeginInfo beginInfo = {};
+            commandBuffer.begin(&beginInfo);
+            record_acceleration_structure_builds(commandBuffer, frame_slot, queue_family,
+                animation_pipeline, animation_descriptor_sets, animation_pipeline_layout, animation_count,
+                aabbs, bottom_accel_build_infos, bottom_accels,
+                top_accel_build_infos, top_accels, top_accel_instance_count,
+                timestamp_query_pool, dynamicDispatchLoader);
+            commandBuffer.end();
+        }
+        return commandBuffers;
+    }
+
+    // Rows of the tile tile_index when the image is cut into tiles of tile_height rows.
+    inline uint32_t get_tile_row_count(uint32_t tile_index, uint32_t tile_height, uint32_t height) {
+        return std::min(tile_height, height - tile_index * tile_height);
+    }
+
+    // In tile mode a frame slot starts with one command buffer running the builds of the
+    // frame, if they are not on the build queue, and clearing the summed image of the slot.
+    inline auto create_tile_frame_command_buffers(vk::Device device, vk::CommandPool commandPool, uint32_t frame_slot_count,
+        uint32_t queue_family, auto& render_target_images, auto& summed_images,
+        vk::Pipeline animation_pipeline, const auto& animation_descriptor_sets, vk::PipelineLayout animation_pipeline_layout, uint32_t animation_count,
+        auto& aabbs, auto& bottom_accel_build_infos, auto& bottom_accels,
+        auto& top_accel_build_infos, const auto& top_accels, uint32_t top_accel_instance_count,
+        vk::QueryPool timestamp_query_pool, bool record_builds, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        auto commandBuffers = device.allocateCommandBuffers(
+            {
+                    .commandPool = commandPool,
+                    .level = vk::CommandBufferLevel::ePrimary,
+                    .commandBufferCount = frame_slot_count
+            });
+        for (uint32_t frame_slot = 0; frame_slot < frame_slot_count; frame_slot++) {
+            auto& commandBuffer = commandBuffers[frame_slot];
+            vk::CommandBufferBeginInfo beginInfo = {};
+            commandBuffer.begin(&beginInfo);
+
+            if (record_builds) {
+                record_acceleration_structure_builds(commandBuffer, frame_slot, queue_family,
+                    animation_pipeline, animation_descriptor_sets, animation_pipeline_layout, animation_count,
+                    aabbs, bottom_accel_build_infos, bottom_accels,
+                    top_accel_build_infos, top_accels, top_accel_instance_count,
+                    timestamp_query_pool, dynamicDispatchLoader);
+            }
+
+            auto subresourceRange = vk::ImageSubresourceRange{
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+            };
+            // SUMMED IMAGE: UNDEFINED -> TRANSFER DST
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                vk::PipelineStageFlagBits::eTransfer,
+                {}, {}, {},
+                vk::ImageMemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eNoneKHR,
+                    .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+                    .oldLayout = vk::ImageLayout::eUndefined,
+                    .newLayout = vk::ImageLayout::eTransferDstOptimal,
+                    .srcQueueFamilyIndex = queue_family,
+                    .dstQueueFamilyIndex = queue_family,
+                    .image = summed_images[frame_slot].image,
+                    .subresourceRange = subresourceRange
+                });
+            commandBuffer.clearColorImage(summed_images[frame_slot].image, vk::ImageLayout::eTransferDstOptimal,
+                vk::ClearColorValue{}, subresourceRange);
+            // SUMMED IMAGE: TRANSFER DST -> GENERAL & RENDER TARGET IMAGE: UNDEFINED -> GENERAL
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                {}, {}, {},
+                std::array{
+                    vk::ImageMemoryBarrier{
+                        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                        .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+                        .newLayout = vk::ImageLayout::eGeneral,
+                        .srcQueueFamilyIndex = queue_family,
+                        .dstQueueFamilyIndex = queue_family,
+                        .image = summed_images[frame_slot].image,
+                        .subresourceRange = subresourceRange
+                    },
+                    vk::ImageMemoryBarrier{
+                        .srcAccessMask = vk::AccessFlagBits::eNoneKHR,
+                        .dstAccessMask = vk::AccessFlagBits::eShaderWrite,
+                        .oldLayout = vk::ImageLayout::eUndefined,
+                        .newLayout = vk::ImageLayout::eGeneral,
+                        .srcQueueFamilyIndex = queue_family,
+                        .dstQueueFamilyIndex = queue_family,
+                        .image = render_target_images[frame_slot].image,
+                        .subresourceRange = subresourceRange
+                    }
+                });
+
+            commandBuffer.end();
+        }
+        return commandBuffers;
+    }
+
+    // One command buffer per frame slot and tile tracing the tile and copying it to the
+    // readback buffer of the slot, command buffer frame_slot * tile_count + tile_index.
+    // The tiles of a slot touch disjoint pixels, so they need no barriers between each other.
+    inline auto create_tile_command_buffers(vk::Device device, vk::CommandPool commandPool, uint32_t frame_slot_count,
+        uint32_t tile_count, uint32_t tile_height, uint32_t width, uint32_t height,
+        uint32_t queue_family, auto& render_target_images, const auto& readback_buffers,
+        vk::Pipeline pipeline, const auto& descriptor_sets, vk::PipelineLayout pipeline_layout,
+        vk::StridedDeviceAddressRegionKHR sbtRayGenAddressRegion, vk::StridedDeviceAddressRegionKHR sbtMissAddressRegion, vk::StridedDeviceAddressRegionKHR sbtHitAddressRegion,
+        vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        auto commandBuffers = device.allocateCommandBuffers(
+            {
+                    .commandPool = commandPool,
+                    .level = vk::CommandBufferLevel::ePrimary,
+                    .commandBufferCount = frame_slot_count * tile_count
+            });
+        for (uint32_t commandBufferIndex = 0; commandBufferIndex < commandBuffers.size(); commandBufferIndex++) {
+            auto frame_slot = commandBufferIndex / tile_count;
+            auto tile_index = commandBufferIndex % tile_count;
+            auto tile_offset = glm::uvec2{ 0, tile_index * tile_height };
+            auto tile_row_count = get_tile_row_count(tile_index, tile_height, height);
+            auto& commandBuffer = commandBuffers[commandBufferIndex];
+            vk::CommandBufferBeginInfo beginInfo = {};
+            commandBuffer.begin(&beginInfo);
+
+            record_trace_rays(commandBuffer, pipeline, descriptor_sets[frame_slot], pipeline_layout,
+                sbtRayGenAddressRegion, sbtMissAddressRegion, sbtHitAddressRegion,
+                tile_offset, width, tile_row_count, dynamicDispatchLoader);
+
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::PipelineStageFlagBits::eTransfer,
+                {},
+                vk::MemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                    .dstAccessMask = vk::AccessFlagBits::eTransferRead
+                },
+                {}, {});
+
+            // COPY THE TILE OF THE RENDER TARGET IMAGE TO ITS ROWS OF THE READBACK BUFFER
+            vk::BufferImageCopy readbackCopy = {
+                    .bufferOffset = vk::DeviceSize{ tile_offset.y } * width * 4,
+                    .bufferRowLength = 0,
+                    .bufferImageHeight = 0,
+                    .imageSubresource = {
+                            .aspectMask = vk::ImageAspectFlagBits::eColor,
+                            .mipLevel = 0,
+                            .baseArrayLayer = 0,
+                            .layerCount = 1
+                    },
+                    .imageOffset = {0, static_cast<int32_t>(tile_offset.y), 0},
+                    .imageExtent = {
+                            .width = width,
+                            .height = tile_row_count,
+                            .depth = 1
+                    }
+            };
+            commandBuffer.copyImageToBuffer(render_target_images[frame_slot].image, vk::ImageLayout::eGeneral,
+                readback_buffers[frame_slot].buffer, 1, &readbackCopy);
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                {},
+                vk::MemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                    .dstAccessMask = vk::AccessFlagBits::eHostRead
+                },
+                {}, {});
+
+            commandBuffer.end();
+        }
+        return commandBuffers;
+    }
+
+    // In sample split mode every device traces the whole image with its share of the samples, one command
+    // buffer per frame slot, and reads back the summed image, so the host can add up the samples of all devices.
+    inline auto create_sample_split_command_buffers(vk::Device device, vk::CommandPool commandPool, uint32_t frame_slot_count,
+        uint32_t queue_family, auto& render_target_images, auto& summed_images, const auto& readback_buffers,
+        vk::Pipeline pipeline, const auto& descriptor_sets, vk::PipelineLayout pipeline_layout,
+        vk::Pipeline animation_pipeline, const auto& animation_descriptor_sets, vk::PipelineLayout animation_pipeline_layout, uint32_t animation_count,
+        auto& aabbs, auto& bottom_accel_build_infos, auto& bottom_accels,
+        auto& top_accel_build_infos, const auto& top_accels, uint32_t top_accel_instance_count,
+        vk::QueryPool timestamp_query_pool, bool record_builds,
+        vk::StridedDeviceAddressRegionKHR sbtRayGenAddressRegion, vk::StridedDeviceAddressRegionKHR sbtMissAddressRegion, vk::StridedDeviceAddressRegionKHR sbtHitAddressRegion,
+        uint32_t width, uint32_t height, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        auto commandBuffers = device.allocateCommandBuffers(
+            {
+                    .commandPool = commandPool,
+                    .level = vk::CommandBufferLevel::ePrimary,
+                    .commandBufferCount = frame_slot_count
+            });
+        for (uint32_t frame_slot = 0; frame_slot < frame_slot_count; frame_slot++) {
+            auto& commandBuffer = commandBuffers[frame_slot];
+            vk::CommandBufferBeginInfo beginInfo = {};
+            commandBuffer.begin(&beginInfo);
+
+            if (record_builds) {
+                record_acceleration_structure_builds(commandBuffer, frame_slot, queue_family,
+                    animation_pipeline, animation_descriptor_sets, animation_pipeline_layout, animation_count,
+                    aabbs, bottom_accel_build_infos, bottom_accels,
+                    top_accel_build_infos, top_accels, top_accel_instance_count,
+                    timestamp_query_pool, dynamicDispatchLoader);
+            }
+
+            auto subresourceRange = vk::ImageSubresourceRange{
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+            };
+            // SUMMED IMAGE: UNDEFINED -> TRANSFER DST
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                vk::PipelineStageFlagBits::eTransfer,
+                {}, {}, {},
+                vk::ImageMemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eNoneKHR,
+                    .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+                    .oldLayout = vk::ImageLayout::eUndefined,
+                    .newLayout = vk::ImageLayout::eTransferDstOptimal,
+                    .srcQueueFamilyIndex = queue_family,
+                    .dstQueueFamilyIndex = queue_family,
+                    .image = summed_images[frame_slot].image,
+                    .subresourceRange = subresourceRange
+                });
+            commandBuffer.clearColorImage(summed_images[frame_slot].image, vk::ImageLayout::eTransferDstOptimal,
+                vk::ClearColorValue{}, subresourceRange);
+            // SUMMED IMAGE: TRANSFER DST -> GENERAL
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                {}, {}, {},
+                vk::ImageMemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                    .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                    .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+                    .newLayout = vk::ImageLayout::eGeneral,
+                    .srcQueueFamilyIndex = queue_family,
+                    .dstQueueFamilyIndex = queue_family,
+                    .image = summed_images[frame_slot].image,
+                    .subresourceRange = subresourceRange
+                });
+
+            record_ray_tracing(commandBuffer, queue_family, render_target_images[frame_slot].image, summed_images[frame_slot].image,
+                pipeline, descriptor_sets[frame_slot], pipeline_layout,
+                sbtRayGenAddressRegion, sbtMissAddressRegion, sbtHitAddressRegion,
+                width, height, dynamicDispatchLoader);
+
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::PipelineStageFlagBits::eTransfer,
+                {},
+                vk::MemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                    .dstAccessMask = vk::AccessFlagBits::eTransferRead
+                },
+                {}, {});
+
+            // COPY THE SUMMED IMAGE TO THE READBACK BUFFER, read by the host once the frame is done
+            vk::BufferImageCopy readbackCopy = {
+                    .bufferOffset = 0,
+                    .bufferRowLength = 0,
+                    .bufferImageHeight = 0,
+                    .imageSubresource = {
+                            .aspectMask = vk::ImageAspectFlagBits::eColor,
+                            .mipLevel = 0,
+                            .baseArrayLayer = 0,
+                            .layerCount = 1
+                    },
+                    .imageOffset = {0, 0, 0},
+                    .imageExtent = {
+                            .width = width,
+                            .height = height,
+                            .depth = 1
+                    }
+            };
+            commandBuffer.copyImageToBuffer(summed_images[frame_slot].image, vk::ImageLayout::eGeneral,
+                readback_buffers[frame_slot].buffer, 1, &readbackCopy);
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                {},
+                vk::MemoryBarrier{
+                    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                    .dstAccessMask = vk::AccessFlagBits::eHostRead
+                },
+                {}, {});
+
+            commandBuffer.end();
+        }
+        return commandBuffers;
+    }
+
     inline auto execute_single_time_command(vk::Device device, vk::Queue queue, vk::CommandPool command_pool, const std::function<void(const vk::CommandBuffer& singleTimeCommandBuffer)>& c) {
         vk::CommandBuffer singleTimeCommandBuffer = device.allocateCommandBuffers(
             {
@@ -1236,21 +2370,304 @@ namespace vulkan {
         device.freeCommandBuffers(command_pool, singleTimeCommandBuffer);
     }
 
-    inline auto update_accel_structures_data(vk::Device device,
-        auto& aabbs, VulkanBuffer& aabb_buffer,
-        VulkanBuffer sphere_buffer, uint32_t sphere_buffer_size,
-        std::span<Sphere> spheres
-    ) {
+    // Builds acceleration structures that never change in one submission and frees their scratch memory.
+    // All of them must be of the same level.
+    inline void build_static_accels(vk::Device device, vk::Queue queue, vk::CommandPool command_pool,
+        std::vector<VulkanAccelerationStructure>& accels,
+        const std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>& build_infos,
+        const std::vector<vk::AccelerationStructureBuildRangeInfoKHR>& build_range_infos,
+        vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        if (accels.empty()) {
+            return;
+        }
+        auto p_build_range_infos = std::vector<const vk::AccelerationStructureBuildRangeInfoKHR*>(build_range_infos.size());
+        std::ranges::transform(build_range_infos, p_build_range_infos.begin(), [](auto& info) { return &info; });
+        execute_single_time_command(device, queue, command_pool,
+            [&build_infos, &p_build_range_infos, &dynamicDispatchLoader](const vk::CommandBuffer& command_buffer) {
+                command_buffer.buildAccelerationStructuresKHR(static_cast<uint32_t>(build_infos.size()), build_infos.data(), p_build_range_infos.data(), dynamicDispatchLoader);
+            });
+
+        // The scratch memory is not needed once the build has finished.
+        std::ranges::for_each(
+            accels,
+            [device](auto& accel) {
+                vulkan::destroy_buffer(device, accel.scratchBuffer);
+                accel.scratchBuffer = {};
+            }
+        );
+    }
+
+    // Replaces built BLASes, which must have been built with eAllowCompaction,
+    // by copies of their compacted size and frees the originals.
+    inline void compact_bottom_accels(vk::Device device, vk::Queue queue, vk::CommandPool command_pool,
+        std::vector<VulkanAccelerationStructure>& bottom_accels,
+        const vk::PhysicalDeviceMemoryProperties& memory_properties, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        if (bottom_accels.empty()) {
+            return;
+        }
+        auto accel_count = static_cast<uint32_t>(bottom_accels.size());
+        auto accels = std::vector<vk::AccelerationStructureKHR>(accel_count);
+        std::ranges::transform(bottom_accels, accels.begin(), [](auto& bottom_accel) { return bottom_accel.accelerationStructure; });
+
+        auto query_pool = device.createQueryPool(
+            {
+                    .queryType = vk::QueryType::eAccelerationStructureCompactedSizeKHR,
+                    .queryCount = accel_count
+            });
+        execute_single_time_command(device, queue, command_pool,
+            [query_pool, accel_count, &accels, &dynamicDispatchLoader](const vk::CommandBuffer& command_buffer) {
+                command_buffer.resetQueryPool(query_pool, 0, accel_count);
+                command_buffer.pipelineBarrier2(
+                    vk::DependencyInfo{}
+                    .setMemoryBarriers(
+                        vk::MemoryBarrier2{}
+                        .setSrcStageMask(vk::PipelineStageFlagBits2::eAccelerationStructureBuildKHR)
+                        .setSrcAccessMask(vk::AccessFlagBits2::eAccelerationStructureWriteKHR)
+                        .setDstStageMask(vk::PipelineStageFlagBits2::eAccelerationStructureBuildKHR)
+                        .setDstAccessMask(vk::AccessFlagBits2::eAccelerationStructureReadKHR)
+                    )
+                );
+                command_buffer.writeAccelerationStructuresPropertiesKHR(accels, vk::QueryType::eAccelerationStructureCompactedSizeKHR,
+                    query_pool, 0, dynamicDispatchLoader);
+            });
+        auto compacted_sizes = std::vector<vk::DeviceSize>(accel_count);
+        auto result = device.getQueryPoolResults(query_pool, 0, accel_count, sizeof(vk::DeviceSize) * accel_count, compacted_sizes.data(),
+            sizeof(vk::DeviceSize), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+        device.destroyQueryPool(query_pool);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("[Error] failed to query compacted acceleration structure sizes");
+        }
+
+        auto compacted_accels = std::vector<VulkanAccelerationStructure>(accel_count);
+        for (uint32_t i = 0; i < accel_count; i++) {
+            compacted_accels[i].structureBuffer = vulkan::create_buffer(device, compacted_sizes[i],
+                vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR |
+                vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                vk::MemoryPropertyFlagBits::eDeviceLocal, memory_properties);
+            compacted_accels[i].accelerationStructure = device.createAccelerationStructureKHR(
+                {
+                        .buffer = compacted_accels[i].structureBuffer.buffer,
+                        .offset = 0,
+                        .size = compacted_sizes[i],
+                        .type = vk::AccelerationStructureTypeKHR::eBottomLevel
+                }, nullptr, dynamicDispatchLoader);
+        }
+        execute_single_time_command(device, queue, command_pool,
+            [&bottom_accels, &compacted_accels, &dynamicDispatchLoader](const vk::CommandBuffer& command_buffer) {
+                for (size_t i = 0; i < bottom_accels.size(); i++) {
+                    command_buffer.copyAccelerationStructureKHR(
+                        {
+                                .src = bottom_accels[i].accelerationStructure,
+                                .dst = compacted_accels[i].accelerationStructure,
+                                .mode = vk::CopyAccelerationStructureModeKHR::eCompact
+                        }, dynamicDispatchLoader);
+                }
+            });
+
+        std::ranges::for_each(
+            bottom_accels,
+            [device, &dynamicDispatchLoader](auto& bottom_accel) {
+                vulkan::destroy_acceleration_structure(device, bottom_accel, dynamicDispatchLoader);
+            }
+        );
+        bottom_accels = std::move(compacted_accels);
+    }
+
+    // Mesh BLASes are static: they are built once here and shared by every
+    // frame slot, only the TLAS referencing them is rebuilt per frame.
+    inline auto create_mesh_bottom_accels(vk::Device device, vk::Queue queue, vk::CommandPool command_pool,
+        const VulkanBuffer& vertex_buffer, const VulkanBuffer& index_buffer, const MeshScene& mesh_scene,
+        const vk::PhysicalDeviceMemoryProperties& memory_properties, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        auto mesh_count = mesh_scene.meshes.size();
+        auto geometries = std::vector<vk::AccelerationStructureGeometryKHR>(mesh_count);
+        auto bottom_accels = std::vector<VulkanAccelerationStructure>(mesh_count);
+        auto build_infos = std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>(mesh_count);
+        auto build_range_infos = std::vector<vk::AccelerationStructureBuildRangeInfoKHR>(mesh_count);
+        for (size_t i = 0; i < mesh_count; i++) {
+            auto [bottom_accel, build_info, build_range_info] = createTriangleBottomAccelerationStructure(device, vertex_buffer, index_buffer,
+                mesh_scene.meshes[i], geometries[i], memory_properties, dynamicDispatchLoader);
+            bottom_accels[i] = bottom_accel;
+            build_infos[i] = build_info;
+            build_range_infos[i] = build_range_info;
+        }
+        if (mesh_count == 0) {
+            return bottom_accels;
+        }
+
+        build_static_accels(device, queue, command_pool, bottom_accels, build_infos, build_range_infos, dynamicDispatchLoader);
+        return bottom_accels;
+    }
+
+    // Lends worker threads to deferred host operations until all of them are complete.
+    inline void join_deferred_operations(vk::Device device, const std::vector<vk::DeferredOperationKHR>& operations,
+        vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        auto thread_count = std::max(1u, std::thread::hardware_concurrency());
+        {
+            auto workers = std::vector<std::jthread>{};
+            for (uint32_t i = 0; i < thread_count; i++) {
+                workers.emplace_back(
+                    [device, &operations, &dynamicDispatchLoader]() {
+                        for (auto operation : operations) {
+                            // Idle means the operation has no work for this thread yet but is not done,
+                            // thread done that it needs no more threads.
+                            auto result = vk::Result::eThreadIdleKHR;
+                            while (result == vk::Result::eThreadIdleKHR) {
+                                result = static_cast<vk::Result>(dynamicDispatchLoader.vkDeferredOperationJoinKHR(device, operation));
+                                if (result == vk::Result::eThreadIdleKHR) {
+                                    std::this_thread::yield();
+                                }
+                            }
+                        }
+                    });
+            }
+        }
+        std::ranges::for_each(
+            operations,
+            [device, &dynamicDispatchLoader](auto operation) {
+                if (device.getDeferredOperationResultKHR(operation, dynamicDispatchLoader) != vk::Result::eSuccess) {
+                    throw std::runtime_error("[Error] deferred acceleration structure build failed");
+                }
+            }
+        );
+    }
+
+    // Host counterpart of create_mesh_bottom_accels for devices with accelerationStructureHostCommands.
+    // The builds read the meshes straight from host memory and run as deferred operations on
+    // all cores. The structures are placed in host-visible memory, compact_bottom_accels then
+    // moves them to device-local memory.
+    inline auto create_mesh_bottom_accels_on_host(vk::Device device, const MeshScene& mesh_scene,
+        const vk::PhysicalDeviceMemoryProperties& memory_properties, vk::detail::DispatchLoaderDynamic& dynamicDispatchLoader) {
+        auto mesh_count = mesh_scene.meshes.size();
+        auto geometries = std::vector<vk::AccelerationStructureGeometryKHR>(mesh_count);
+        auto bottom_accels = std::vector<VulkanAccelerationStructure>(mesh_count);
+        auto build_infos = std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>(mesh_count);
+        auto build_range_infos = std::vector<vk::AccelerationStructureBuildRangeInfoKHR>(mesh_count);
+        auto scratch_memories = std::vector<std::vector<std::byte>>(mesh_count);
+        for (size_t i = 0; i < mesh_count; i++) {
+            auto& mesh = mesh_scene.meshes[i];
+            auto& geometry = geometries[i];
+            geometry.geometryType = vk::GeometryTypeKHR::eTriangles;
+            geometry.flags = vk::GeometryFlagBitsKHR::eOpaque;
+            geometry.geometry.triangles.sType = vk::StructureType::eAccelerationStructureGeometryTrianglesDataKHR;
+            geometry.geometry.triangles.vertexFormat = vk::Format::eR32G32B32Sfloat;
+            geometry.geometry.triangles.vertexData.hostAddress = mesh_scene.vertices.data();
+            geometry.geometry.triangles.vertexStride = sizeof(MeshVertex);
+            geometry.geometry.triangles.maxVertex = mesh.firstVertex + mesh.vertexCount - 1;
+            geometry.geometry.triangles.indexType = vk::IndexType::eUint32;
+            geometry.geometry.triangles.indexData.hostAddress = mesh_scene.indices.data();
+
+            build_infos[i] = {
+                    .type = vk::AccelerationStructureTypeKHR::eBottomLevel,
+                    .flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace | vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction,
+                    .mode = vk::BuildAccelerationStructureModeKHR::eBuild,
+                    .geometryCount = 1,
+                    .pGeometries = &geometry
+            };
+            build_range_infos[i] = {
+                    .primitiveCount = mesh.indexCount / 3,
+                    .primitiveOffset = static_cast<uint32_t>(sizeof(uint32_t) * mesh.firstIndex),
+                    .firstVertex = mesh.firstVertex,
+                    .transformOffset = 0
+            };
+
+            vk::AccelerationStructureBuildSizesInfoKHR buildSizesInfo = device.getAccelerationStructureBuildSizesKHR(
+                vk::AccelerationStructureBuildTypeKHR::eHost, build_infos[i], { build_range_infos[i].primitiveCount }, dynamicDispatchLoader);
+
+            bottom_accels[i].structureBuffer = vulkan::create_buffer(device, buildSizesInfo.accelerationStructureSize,
+                vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR |
+                vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, memory_properties);
+            bottom_accels[i].accelerationStructure = device.createAccelerationStructureKHR(
+                {
+                        .buffer = bottom_accels[i].structureBuffer.buffer,
+                        .offset = 0,
+                        .size = buildSizesInfo.accelerationStructureSize,
+                        .type = vk::AccelerationStructureTypeKHR::eBottomLevel
+                }, nullptr, dynamicDispatchLoader);
+
+            scratch_memories[i].resize(buildSizesInfo.buildScratchSize);
+            build_infos[i].dstAccelerationStructure = bottom_accels[i].accelerationStructure;
+            build_infos[i].scratchData.hostAddress = scratch_memories[i].data();
+        }
+
+        // One operation per mesh, so small meshes run side by side and large ones are split
+        // across threads by the implementation.
+        auto operations = std::vector<vk::DeferredOperationKHR>{};
+        for (size_t i = 0; i < mesh_count; i++) {
+            auto operation = device.createDeferredOperationKHR(nullptr, dynamicDispatchLoader);
+            const vk::AccelerationStructureBuildRangeInfoKHR* p_build_range_info = &build_range_infos[i];
+            auto result = static_cast<vk::Result>(dynamicDispatchLoader.vkBuildAccelerationStructuresKHR(device, operation, 1,
+                reinterpret_cast<const VkAccelerationStructureBuildGeometryInfoKHR*>(&build_infos[i]),
+                reinterpret_cast<const VkAccelerationStructureBuildRangeInfoKHR* const*>(&p_build_range_info)));
+            if (result == vk::Result::eOperationDeferredKHR) {
+                operations.push_back(operation);
+                continue;
+            }
+            device.destroyDeferredOperationKHR(operation, nullptr, dynamicDispatchLoader);
+            if (result != vk::Result::eSuccess && result != vk::Result::eOperationNotDeferredKHR) {
+                throw std::runtime_error("[Error] failed to build acceleration structure on the host");
+            }
+        }
+        join_deferred_operations(device, operations, dynamicDispatchLoader);
+        std::ranges::for_each(
+            operations,
+            [device, &dynamicDispatchLoader](auto operation) {
+                device.destroyDeferredOperationKHR(operation, nullptr, dynamicDispatchLoader);
+            }
+        );
+        return bottom_accels;
+    }
+
+    inline vk::DeviceSize get_acceleration_structure_memory(const std::vector<VulkanAccelerationStructure>& accels) {
+        return std::transform_reduce(accels.begin(), accels.end(), vk::DeviceSize{ 0 }, std::plus{},
+            [](auto& accel) { return accel.structureBuffer.size; });
+    }
+
+    // Scratch and instance buffers, the memory only needed to (re)build the acceleration structures.
+    inline vk::DeviceSize get_acceleration_structure_build_memory(const std::vector<VulkanAccelerationStructure>& accels) {
+        return std::transform_reduce(accels.begin(), accels.end(), vk::DeviceSize{ 0 }, std::plus{},
+            [](auto& accel) { return accel.scratchBuffer.size + accel.instancesBuffer.size; });
+    }
+
+    // Works for buffers and images.
+    inline vk::DeviceSize get_resources_memory(const auto& resources) {
+        return std::transform_reduce(resources.begin(), resources.end(), vk::DeviceSize{ 0 }, std::plus{},
+            [](auto& resource) { return resource.size; });
+    }
+
+    // Two timestamps per frame slot around its acceleration structure builds.
+    inline auto create_timestamp_query_pool(vk::Device device, uint32_t frame_slot_count) {
+        return device.createQueryPool(
+            {
+                    .queryType = vk::QueryType::eTimestamp,
+                    .queryCount = 2 * frame_slot_count
+            });
+    }
+
+    // GPU time of the acceleration structure builds of the last submission of
+    // this frame slot, if it has completed.
+    inline std::optional<std::chrono::nanoseconds> get_acceleration_structure_build_duration(vk::Device device, vk::QueryPool timestamp_query_pool,
+        uint32_t frame_slot, float timestamp_period) {
+        std::array<uint64_t, 2> timestamps{};
+        auto result = device.getQueryPoolResults(timestamp_query_pool, 2 * frame_slot, 2,
+            sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess) {
+            return std::nullopt;
+        }
+        return std::chrono::nanoseconds{ static_cast<int64_t>((timestamps[1] - timestamps[0]) * static_cast<double>(timestamp_period)) };
+    }
+
+    inline void update_aabb_data(vk::Device device, auto& aabbs, VulkanBuffer& aabb_buffer) {
         auto aabbs_buffer_size = sizeof(aabbs[0]) * aabbs.size();
         void* data = device.mapMemory(aabb_buffer.memory, 0, aabbs_buffer_size);
         memcpy(data, aabbs.data(), aabbs_buffer_size);
         device.unmapMemory(aabb_buffer.memory);
+    }
 
-        {
-            void* data = device.mapMemory(sphere_buffer.memory, 0, sphere_buffer_size);
-            memcpy(data, spheres.data(), sizeof(Sphere) * spheres.size());
-            device.unmapMemory(sphere_buffer.memory);
-        }
+    inline void update_sphere_data(vk::Device device, VulkanBuffer& sphere_buffer, std::span<const Sphere> spheres) {
+        void* data = device.mapMemory(sphere_buffer.memory, 0, spheres.size_bytes());
+        memcpy(data, spheres.data(), spheres.size_bytes());
+        device.unmapMemory(sphere_buffer.memory);
     }
 
 }
@@ -1281,6 +2698,13 @@ public:
         return requiredDeviceExtensions;
     }
 
+    // The offscreen renderer presents nothing: its instance has no surface extension, so its device may not enable the swapchain.
+    static auto get_required_headless_device_extensions() {
+        auto requiredDeviceExtensions = get_required_device_extensions();
+        std::erase_if(requiredDeviceExtensions, [](auto extension) { return std::string_view{ extension } == VK_KHR_SWAPCHAIN_EXTENSION_NAME; });
+        return requiredDeviceExtensions;
+    }
+
 private:
     
     std::vector<vk::Fence> m_fences;
@@ -1,7 +1,16 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 struct VulkanSettings {
     uint32_t windowWidth, windowHeight;
 };
+
+// How spheres are represented in the acceleration structures.
+enum class SphereMode : uint32_t {
+    // One AABB per sphere in a per-image BLAS, intersected by shader.rint.
+    Aabb = 0,
+    // One TLAS instance of a shared unit icosphere triangle BLAS per sphere.
+    Icosphere = 1
+};
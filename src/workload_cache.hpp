@@ -0,0 +1,134 @@
+#pragma once
+
+#include "workload_tuner.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace tune {
+	// A distribution the tuner settled on, with the throughput estimates behind it.
+	struct cached_workload {
+		std::vector<uint32_t> workload_distribution;
+		std::vector<double> throughput;
+	};
+
+	// FNV-1a over the bytes of the elements, which must not contain padding.
+	template<typename T>
+		requires std::is_trivially_copyable_v<T>
+	inline uint64_t fingerprint(uint64_t hash, std::span<const T> elements) {
+		auto bytes = reinterpret_cast<const unsigned char*>(elements.data());
+		for (size_t i = 0; i < elements.size_bytes(); i++) {
+			hash = (hash ^ bytes[i]) * 0x100000001b3;
+		}
+		return hash;
+	}
+
+	template<typename T>
+		requires std::is_trivially_copyable_v<T>
+	inline uint64_t fingerprint(uint64_t hash, const T& value) {
+		return fingerprint(hash, std::span<const T>{ &value, 1 });
+	}
+
+	constexpr uint64_t fingerprint_basis = 0xcbf29ce484222325;
+
+	// The balance depends on the devices and their drivers in strip order, the resolution and the scene.
+	inline std::string get_workload_cache_key(std::span<const std::string> device_identities, uint32_t width, uint32_t height, uint64_t scene_fingerprint) {
+		auto key = std::ostringstream{};
+		for (auto& identity : device_identities) {
+			key << identity << ",";
+		}
+		key << width << "x" << height << "," << std::hex << scene_fingerprint;
+		return key.str();
+	}
+
+	// One line per key: "<key> <gpu count> <rows>... <throughput>...".
+	inline std::map<std::string, cached_workload> read_workload_cache(const std::filesystem::path& path) {
+		auto cache = std::map<std::string, cached_workload>{};
+		auto file = std::ifstream{ path };
+		auto line = std::string{};
+		while (std::getline(file, line)) {
+			auto entry = std::istringstream{ line };
+			auto key = std::string{};
+			uint32_t gpu_count = 0;
+			if (!(entry >> key >> gpu_count) || gpu_count == 0) {
+				continue;
+			}
+			auto cached = cached_workload{
+				.workload_distribution = std::vector<uint32_t>(gpu_count),
+				.throughput = std::vector<double>(gpu_count)
+			};
+			for (auto& rows : cached.workload_distribution) {
+				entry >> rows;
+			}
+			for (auto& throughput : cached.throughput) {
+				entry >> throughput;
+			}
+			if (entry) {
+				cache[key] = std::move(cached);
+			}
+		}
+		return cache;
+	}
+
+	inline std::optional<cached_workload> load_cached_workload(const std::filesystem::path& path, const std::string& key) {
+		auto cache = read_workload_cache(path);
+		if (auto entry = cache.find(key); entry != cache.end()) {
+			return entry->second;
+		}
+		return std::nullopt;
+	}
+
+	// Replaces the entry of key and keeps the entries of other rigs and scenes.
+	inline void store_cached_workload(const std::filesystem::path& path, const std::string& key, const cached_workload& cached) {
+		auto cache = read_workload_cache(path);
+		cache[key] = cached;
+		auto file = std::ofstream{ path, std::ios::trunc };
+		file.precision(17);
+		for (auto& [entry_key, entry] : cache) {
+			file << entry_key << " " << entry.workload_distribution.size();
+			for (auto rows : entry.workload_distribution) {
+				file << " " << rows;
+			}
+			for (auto throughput : entry.throughput) {
+				file << " " << throughput;
+			}
+			file << "\n";
+		}
+		if (!file) {
+			throw std::runtime_error("[Error] failed to write the workload cache " + path.string());
+		}
+	}
+
+	// Starts tuning from a cached distribution: the estimates are known, so the tuner only moves rows once they drift.
+	inline bool seed_tuning_info(tuning_info& info, const cached_workload& cached) {
+		if (cached.workload_distribution.size() != info.gpu_count || cached.throughput.size() != info.gpu_count
+			|| std::accumulate(cached.workload_distribution.begin(), cached.workload_distribution.end(), 0u) != info.total_workload
+			|| std::ranges::any_of(cached.workload_distribution, [](auto rows) { return rows == 0; })
+			|| std::ranges::any_of(cached.throughput, [](auto throughput) { return !(throughput > 0); })) {
+			return false;
+		}
+		info.throughput = cached.throughput;
+		info.workload_distribution = cached.workload_distribution;
+		return true;
+	}
+
+	// The balanced distribution of the current estimates, std::nullopt while a GPU has none.
+	inline std::optional<cached_workload> get_cached_workload(const tuning_info& info) {
+		if (std::ranges::any_of(info.throughput, [](auto throughput) { return throughput == 0; })) {
+			return std::nullopt;
+		}
+		return cached_workload{
+			.workload_distribution = get_balanced_workload(info),
+			.throughput = info.throughput
+		};
+	}
+}
@@ -4,6 +4,10 @@
 #include <cstdint>
 #include <algorithm>
 #include <ranges>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <optional>
 
 namespace tune {
 	using namespace std::literals;
@@ -14,92 +18,237 @@ namespace tune {
 		std::vector<std::chrono::steady_clock::duration> estimated_gpu_duration;
 	};
 
+	// Weight of a new throughput sample in the moving average.
+	constexpr double throughput_smoothing = 0.3;
+	// A sample further off the estimate than this many standard deviations of the measured noise,
+	// and at least minimum_step_ratio, is an outlier...
+	constexpr double step_deviations = 4.0;
+	constexpr double minimum_step_ratio = 1.25;
+	// ...unless it repeats in the same direction, then the GPU really changed speed and the estimate
+	// restarts from the mean of those samples.
+	constexpr uint32_t persistent_outlier_count = 2;
+	// Rebalance only when that shortens the predicted frame by more than this many standard deviations
+	// of the estimates, and at least by minimum_rebalance_gain, so noise around the balance point does not
+	// move rows back and forth.
+	constexpr double rebalance_deviations = 2.0;
+	constexpr double minimum_rebalance_gain = 0.005;
+	// Once the split follows the cost map, later moves go this fraction of the way to the balanced split.
+	constexpr double cost_split_damping = 0.5;
+
 	struct tuning_info {
 		uint32_t total_workload;
 		uint32_t gpu_count;
 
-		std::vector<frame_info> frame_infos;
+		// Exponentially weighted cost per nanosecond of every GPU, zero before its first sample.
+		std::vector<double> throughput;
+		// Exponentially weighted variance of the log ratio of a sample to the estimate of every GPU,
+		// outliers excluded.
+		std::vector<double> noise_variance;
+		// Consecutive outliers in the same direction of every GPU, negative below the estimate, and their sum.
+		std::vector<int32_t> outlier_count;
+		std::vector<double> outlier_sum;
+		// The distribution of the last frame added.
+		std::vector<uint32_t> workload_distribution;
+		// Measured cost of every unit of work scaled to a mean of one, empty while every unit costs one.
+		// The units of a distribution are stacked from the first one in GPU order, like the strips of the image.
+		// Every map set is averaged into it with the weight of a throughput sample.
+		std::vector<double> row_cost;
+		// Whether the distribution already follows the cost map, cleared with the map and by a speed step.
+		bool cost_split;
 	};
 
 	inline void init_tuning_info(tuning_info& info, uint32_t total_workload, uint32_t gpu_count) {
 		info = {
 			.total_workload = total_workload,
-			.gpu_count = gpu_count
+			.gpu_count = gpu_count,
+			.throughput = std::vector<double>(gpu_count),
+			.noise_variance = std::vector<double>(gpu_count),
+			.outlier_count = std::vector<int32_t>(gpu_count),
+			.outlier_sum = std::vector<double>(gpu_count),
+			.workload_distribution = {},
+			.row_cost = {},
+			.cost_split = false
 		};
 	}
 
-	inline void add_frame_info(tuning_info& info, frame_info frame) {
-		if (info.frame_infos.size() > 10) {
-			info.frame_infos = { info.frame_infos.back() };
+	// Takes the cost of every unit of work, e.g. the rays traced per row, into account from the next frame added on.
+	// A cost map of the wrong size or without any cost goes back to units of equal cost.
+	inline void set_row_cost(tuning_info& info, std::vector<double> row_cost) {
+		auto total_cost = std::accumulate(row_cost.begin(), row_cost.end(), 0.0);
+		if (row_cost.size() != info.total_workload || total_cost <= 0) {
+			info.row_cost.clear();
+			info.cost_split = false;
+			return;
+		}
+		std::ranges::for_each(row_cost, [scale = row_cost.size() / total_cost](auto& cost) { cost *= scale; });
+		if (info.row_cost.empty()) {
+			info.row_cost = std::move(row_cost);
+			return;
+		}
+		for (uint32_t row = 0; row < info.total_workload; row++) {
+			info.row_cost[row] += throughput_smoothing * (row_cost[row] - info.row_cost[row]);
 		}
-		info.frame_infos.push_back(frame);
 	}
 
-	inline std::optional<std::vector<uint32_t>> get_workload(tuning_info& info) {
-		auto& frame_info = info.frame_infos.back();
-
-		auto average_estimated_gpu_duration = std::accumulate(frame_info.estimated_gpu_duration.begin(), frame_info.estimated_gpu_duration.end(), 0ns)/frame_info.estimated_gpu_duration.size();
-		auto variant_estimated_gpu_duration = 0.0;
-		std::ranges::for_each(
-			frame_info.estimated_gpu_duration,
-			[&variant_estimated_gpu_duration, average_estimated_gpu_duration](auto duration) {
-				auto v = (static_cast<float>(duration.count()) - average_estimated_gpu_duration.count()) / average_estimated_gpu_duration.count();
-				variant_estimated_gpu_duration += v * v;
+	// Cost of the part of every GPU in the distribution.
+	inline std::vector<double> get_gpu_costs(const tuning_info& info, const std::vector<uint32_t>& workload_distribution) {
+		auto costs = std::vector<double>(info.gpu_count);
+		uint32_t first_row = 0;
+		for (uint32_t i = 0; i < info.gpu_count; i++) {
+			costs[i] = info.row_cost.empty()
+				? workload_distribution[i]
+				: std::accumulate(info.row_cost.begin() + first_row, info.row_cost.begin() + first_row + workload_distribution[i], 0.0);
+			first_row += workload_distribution[i];
+		}
+		return costs;
+	}
+
+	inline void add_frame_info(tuning_info& info, frame_info frame) {
+		auto costs = get_gpu_costs(info, frame.workload_distribution);
+		for (uint32_t i = 0; i < info.gpu_count; i++) {
+			auto nanoseconds = std::chrono::duration<double, std::nano>(frame.estimated_gpu_duration[i]).count();
+			if (nanoseconds <= 0 || costs[i] <= 0) {
+				continue;
 			}
-		);
-		if (variant_estimated_gpu_duration > 1.8) {
-			const auto& estimated_gpu_duration = frame_info.estimated_gpu_duration;
-			const auto& workload_distribution = frame_info.workload_distribution;
-			float total_v = 0;
-			auto gpu_v = std::vector<float>(estimated_gpu_duration.size());
-			auto indices = std::vector<uint32_t>(gpu_v.size());
-			std::ranges::iota(indices, 0);
-
-			std::ranges::for_each(
-				indices,
-				[&estimated_gpu_duration, &workload_distribution,
-				&total_v, &gpu_v](auto i) {
-					auto v = static_cast<float>(workload_distribution[i]) / estimated_gpu_duration[i].count();
-					total_v += v;
-					gpu_v[i] = v;
+			auto sample = costs[i] / nanoseconds;
+			auto& throughput = info.throughput[i];
+			if (throughput == 0) {
+				throughput = sample;
+				continue;
+			}
+			auto deviation = std::log(sample / throughput);
+			auto step = std::max(std::log(minimum_step_ratio), step_deviations * std::sqrt(info.noise_variance[i]));
+			if (std::abs(deviation) >= step) {
+				auto& outlier_count = info.outlier_count[i];
+				if (outlier_count == 0 || (outlier_count < 0) != (deviation < 0)) {
+					outlier_count = 0;
+					info.outlier_sum[i] = 0;
 				}
-			);
-
-			auto next_workload_distribution = std::vector<uint32_t>(workload_distribution.size());
-			uint32_t remain = info.total_workload;
-			std::ranges::for_each(
-				indices,
-				[&next_workload_distribution, &gpu_v, total_v, total_workload=info.total_workload, &remain](auto i) {
-					next_workload_distribution[i] = static_cast<uint32_t>(total_workload * gpu_v[i] / total_v);
-					remain -= next_workload_distribution[i];
+				outlier_count += deviation < 0 ? -1 : 1;
+				info.outlier_sum[i] += sample;
+				if (static_cast<uint32_t>(std::abs(outlier_count)) < persistent_outlier_count) {
+					continue;
 				}
-			);
-			assert(remain < next_workload_distribution.size());
-			for (int i = 0; i < remain; i++) {
-				next_workload_distribution[i]++;
+				throughput = info.outlier_sum[i] / std::abs(outlier_count);
+				info.cost_split = false;
+			}
+			else {
+				throughput += throughput_smoothing * (sample - throughput);
+				info.noise_variance[i] += throughput_smoothing * (deviation * deviation - info.noise_variance[i]);
 			}
-			remain = 0;
-			return next_workload_distribution;
+			info.outlier_count[i] = 0;
+		}
+		info.workload_distribution = std::move(frame.workload_distribution);
+	}
+
+	// Nanoseconds until the slowest GPU finishes its part of the distribution.
+	inline double get_predicted_duration(const tuning_info& info, const std::vector<uint32_t>& workload_distribution) {
+		auto costs = get_gpu_costs(info, workload_distribution);
+		auto duration = 0.0;
+		for (uint32_t i = 0; i < info.gpu_count; i++) {
+			duration = std::max(duration, costs[i] / info.throughput[i]);
 		}
-		else if (rand()%3) {
-			auto best_frame_ite = std::ranges::min_element(info.frame_infos,
-				std::ranges::less{},
-				[](auto& frame_info) {
-					return frame_info.duration;
-				});
-			auto next_workload_distribution = best_frame_ite->workload_distribution;
-
-			auto extent_offset = std::vector<int32_t>(next_workload_distribution.size());
-			auto dec_index = rand() % next_workload_distribution.size();
-			auto inc_index = rand() % next_workload_distribution.size();
-			if (next_workload_distribution[dec_index] > 1) {
-				next_workload_distribution[inc_index] += 1;
-				next_workload_distribution[dec_index] -= 1;
+		return duration;
+	}
+
+	// Cuts the units where their cumulative cost reaches the share of every GPU in the total
+	// throughput, rounding to the nearest cut, every GPU keeps at least one unit of work.
+	inline std::vector<uint32_t> get_cost_balanced_workload(const tuning_info& info) {
+		auto total_throughput = std::accumulate(info.throughput.begin(), info.throughput.end(), 0.0);
+		auto total_cost = std::accumulate(info.row_cost.begin(), info.row_cost.end(), 0.0);
+
+		auto workload_distribution = std::vector<uint32_t>(info.gpu_count);
+		uint32_t row = 0;
+		auto cost = 0.0;
+		auto target_cost = 0.0;
+		for (uint32_t i = 0; i + 1 < info.gpu_count; i++) {
+			target_cost += total_cost * info.throughput[i] / total_throughput;
+			auto first_row = row;
+			auto last_row = info.total_workload - (info.gpu_count - 1 - i);
+			while (row < last_row && (row == first_row || cost + info.row_cost[row] / 2 <= target_cost)) {
+				cost += info.row_cost[row];
+				row++;
 			}
-			return next_workload_distribution;
+			workload_distribution[i] = row - first_row;
 		}
-		else {
+		workload_distribution.back() = info.total_workload - row;
+		return workload_distribution;
+	}
+
+	// Moves every cut between the units of two GPUs cost_split_damping of the way to the balanced one, so the
+	// noise of the estimates and the cost map does not move rows back and forth. Both sets of cuts increase by at least one unit,
+	// so the moved ones do as well.
+	inline std::vector<uint32_t> get_damped_workload(const tuning_info& info, const std::vector<uint32_t>& balanced_workload_distribution) {
+		auto workload_distribution = std::vector<uint32_t>(info.gpu_count);
+		int64_t cut = 0;
+		int64_t balanced_cut = 0;
+		int64_t previous_damped_cut = 0;
+		for (uint32_t i = 0; i + 1 < info.gpu_count; i++) {
+			cut += info.workload_distribution[i];
+			balanced_cut += balanced_workload_distribution[i];
+			auto damped_cut = cut + std::lround(cost_split_damping * (balanced_cut - cut));
+			workload_distribution[i] = static_cast<uint32_t>(damped_cut - previous_damped_cut);
+			previous_damped_cut = damped_cut;
+		}
+		workload_distribution.back() = info.total_workload - static_cast<uint32_t>(previous_damped_cut);
+		return workload_distribution;
+	}
+
+	// Splits the workload in proportion to the estimated throughputs, by cost once there is a cost map and
+	// else with the largest remainder method, every GPU keeps at least one unit of work.
+	inline std::vector<uint32_t> get_balanced_workload(const tuning_info& info) {
+		if (!info.row_cost.empty() && info.total_workload >= info.gpu_count) {
+			return get_cost_balanced_workload(info);
+		}
+		auto total_throughput = std::accumulate(info.throughput.begin(), info.throughput.end(), 0.0);
+		auto minimum = info.total_workload >= info.gpu_count ? 1u : 0u;
+		auto distributable = info.total_workload - minimum * info.gpu_count;
+
+		auto workload_distribution = std::vector<uint32_t>(info.gpu_count, minimum);
+		auto remainders = std::vector<std::pair<double, uint32_t>>(info.gpu_count);
+		uint32_t remain = distributable;
+		for (uint32_t i = 0; i < info.gpu_count; i++) {
+			auto share = distributable * info.throughput[i] / total_throughput;
+			auto whole = std::min(static_cast<uint32_t>(share), remain);
+			workload_distribution[i] += whole;
+			remain -= whole;
+			remainders[i] = { share - whole, i };
+		}
+		std::ranges::sort(remainders, std::ranges::greater{});
+		for (uint32_t k = 0; remain > 0; k = (k + 1) % info.gpu_count, remain--) {
+			workload_distribution[remainders[k].second]++;
+		}
+		return workload_distribution;
+	}
+
+	// Fraction the predicted frame has to shorten by to rebalance. The moving average leaves
+	// sqrt(smoothing / (2 - smoothing)) of the sample noise in the estimate of every GPU.
+	inline double get_rebalance_threshold(const tuning_info& info) {
+		auto noise_variance = std::ranges::max(info.noise_variance);
+		auto estimate_deviation = std::sqrt(noise_variance * throughput_smoothing / (2 - throughput_smoothing));
+		return std::max(minimum_rebalance_gain, rebalance_deviations * estimate_deviation);
+	}
+
+	// The next distribution once every GPU has an estimate and rebalancing pays off, std::nullopt to keep the current one.
+	inline std::optional<std::vector<uint32_t>> get_workload(tuning_info& info) {
+		if (info.workload_distribution.size() != info.gpu_count
+			|| std::ranges::any_of(info.throughput, [](auto throughput) { return throughput == 0; })) {
 			return std::nullopt;
 		}
+		auto next_workload_distribution = get_balanced_workload(info);
+		if (next_workload_distribution == info.workload_distribution) {
+			return std::nullopt;
+		}
+		auto duration = get_predicted_duration(info, info.workload_distribution);
+		auto next_duration = get_predicted_duration(info, next_workload_distribution);
+		if (next_duration >= duration * (1 - get_rebalance_threshold(info))) {
+			return std::nullopt;
+		}
+		auto cost_balanced = !info.row_cost.empty() && info.total_workload >= info.gpu_count;
+		if (cost_balanced && info.cost_split) {
+			next_workload_distribution = get_damped_workload(info, next_workload_distribution);
+		}
+		info.cost_split = cost_balanced;
+		return next_workload_distribution;
 	}
-}
\ No newline at end of file
+}
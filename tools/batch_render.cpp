@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#include "offscreen_renderer.h"
+
+// One line of the job list:
+//   <scene> <width> <height> <samples> <output.png> [<x> <y> <z> <dx> <dy> <dz>]
+// A scene of "-" is the generated random scene, the optional camera is a position and a view direction.
+struct batch_job {
+    std::string scene_path;
+    uint32_t width;
+    uint32_t height;
+    uint32_t samples;
+    std::string output_path;
+    offscreen::camera camera;
+};
+
+// The camera of the ray generation shader when none is given.
+const auto default_camera = offscreen::camera{
+    .position = glm::vec3(13.0f, 2.0f, -3.0f),
+    .direction = glm::vec3(-13.0f, -2.0f, 3.0f)
+};
+
+// Nothing for empty and comment lines.
+std::optional<batch_job> parse_job(const std::string& line) {
+    auto fields = std::istringstream{ line };
+    auto job = batch_job{};
+    job.camera = default_camera;
+    if (!(fields >> job.scene_path) || job.scene_path.starts_with("#")) {
+        return std::nullopt;
+    }
+    if (!(fields >> job.width >> job.height >> job.samples >> job.output_path)) {
+        throw std::runtime_error("[Error] expected <scene> <width> <height> <samples> <output> in \"" + line + "\"");
+    }
+    auto& position = job.camera.position;
+    auto& direction = job.camera.direction;
+    if (fields >> position.x && !(fields >> position.y >> position.z >> direction.x >> direction.y >> direction.z)) {
+        throw std::runtime_error("[Error] expected a camera position and direction in \"" + line + "\"");
+    }
+    if (job.width == 0 || job.height == 0 || job.samples == 0) {
+        throw std::runtime_error("[Error] need at least one pixel and one sample in \"" + line + "\"");
+    }
+    return job;
+}
+
+double get_milliseconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, const char** argv) {
+    using namespace std::literals;
+    // COMMAND LINE ARGUMENTS
+    const char* jobs_path = nullptr;
+    uint32_t gpu_index = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i] == "--help"s) {
+            std::cout << "--help                            # Show this help infomation" << std::endl;
+            std::cout << "--jobs <path>                     # Job list, one \"<scene> <width> <height> <samples> <output.png> [camera]\" per line, stdin by default" << std::endl;
+            std::cout << "--gpu <index>                     # GPU to render on, in the order of the GPU pick" << std::endl;
+            exit(0);
+        }
+        else if (argv[i] == "--jobs"s) {
+            jobs_path = argv[i + 1];
+            ++i;
+        }
+        else if (argv[i] == "--gpu"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), gpu_index);
+            ++i;
+        }
+        else {
+            std::cerr << "unknown argument: " << argv[i] << std::endl;
+        }
+    }
+
+    offscreen::renderer* renderer = nullptr;
+    try {
+        auto job_file = std::ifstream{};
+        if (jobs_path) {
+            job_file.open(jobs_path);
+            if (!job_file) {
+                throw std::runtime_error("[Error] failed to open " + std::string{ jobs_path });
+            }
+        }
+        auto& jobs = jobs_path ? static_cast<std::istream&>(job_file) : std::cin;
+
+        // Device, pipeline and shader binding table are created once and kept for all jobs.
+        auto begin = std::chrono::steady_clock::now();
+        renderer = offscreen::create_renderer(gpu_index);
+        auto startup_ms = get_milliseconds(begin);
+        std::cout << "startup: " << std::fixed << std::setprecision(2) << startup_ms << " ms" << std::endl;
+
+        std::optional<std::string> loaded_scene_path;
+        uint32_t job_count = 0;
+        uint32_t failed_job_count = 0;
+        uint64_t rendered_samples = 0;
+        auto line = std::string{};
+        while (std::getline(jobs, line)) {
+            auto job_begin = std::chrono::steady_clock::now();
+            auto job_index = job_count;
+            try {
+                auto job = parse_job(line);
+                if (!job) {
+                    continue;
+                }
+                job_count++;
+
+                // A job for the scene loaded before starts right away.
+                auto scene_ms = 0.0;
+                if (loaded_scene_path != job->scene_path) {
+                    auto scene_begin = std::chrono::steady_clock::now();
+                    loaded_scene_path.reset();
+                    auto scene = job->scene_path == "-" ? generateRandomScene() : loadScene(job->scene_path);
+                    offscreen::load_scene(*renderer, scene, MeshScene{}, SphereMode::Aabb, 0, 0.0f);
+                    loaded_scene_path = job->scene_path;
+                    scene_ms = get_milliseconds(scene_begin);
+                }
+                auto resized = job->width != offscreen::get_width(*renderer) || job->height != offscreen::get_height(*renderer);
+                offscreen::set_resolution(*renderer, job->width, job->height);
+                offscreen::clear_samples(*renderer);
+
+                auto render_begin = std::chrono::steady_clock::now();
+                offscreen::render(*renderer, job->camera, 0, job->samples, 0, job->height);
+                auto image = std::vector<uint8_t>(size_t{ job->width } * job->height * 4);
+                offscreen::read_image(*renderer, 0, job->height, image.data());
+                auto render_ms = get_milliseconds(render_begin);
+
+                if (!stbi_write_png(job->output_path.c_str(), static_cast<int>(job->width), static_cast<int>(job->height), 4, image.data(), static_cast<int>(job->width * 4))) {
+                    throw std::runtime_error("[Error] failed to write " + job->output_path);
+                }
+                auto samples = uint64_t{ job->width } * job->height * job->samples;
+                rendered_samples += samples;
+                std::cout << "job[" << job_index << "]: " << job->output_path << " " << job->width << "x" << job->height << " "
+                    << job->samples << " spp, scene " << scene_ms << " ms" << (resized ? ", resized" : "")
+                    << ", render " << render_ms << " ms, " << samples / render_ms / 1e3 << " Msamples/s, total " << get_milliseconds(job_begin) << " ms" << std::endl;
+            }
+            catch (std::exception& e) {
+                job_count = job_index + 1;
+                failed_job_count++;
+                std::cerr << "job[" << job_index << "]: " << e.what() << std::endl;
+            }
+        }
+
+        auto total_ms = get_milliseconds(begin);
+        std::cout << "jobs: " << job_count << ", failed " << failed_job_count << ", total " << total_ms << " ms including startup, "
+            << total_ms / std::max(job_count, 1u) << " ms per job, " << rendered_samples / total_ms / 1e3 << " Msamples/s amortized" << std::endl;
+        offscreen::destroy_renderer(renderer);
+        return failed_job_count > 0 ? 1 : 0;
+    }
+    catch (std::exception& e) {
+        offscreen::destroy_renderer(renderer);
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,513 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "render_farm.hpp"
+#include "offscreen_renderer.h"
+
+struct options {
+    uint32_t worker_count = 2;
+    uint32_t gpu_count = 1;
+    bool synthetic = false;
+    std::string scene_path;
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    uint32_t samples = 10;
+    uint32_t frame_count = 1;
+    uint32_t tile_rows = 64;
+    std::string output_prefix;
+    std::string socket_path;
+    double job_timeout = 0;
+    uint32_t crash_after = 0;
+};
+
+// Frames are rendered at this spacing of the scene time.
+constexpr float frame_time = 1.0f / 30.0f;
+
+// The worker side keeps one renderer for all its jobs and only loads the scene again when the
+// scene or the time of a job differs from the one before.
+struct gpu_worker {
+    offscreen::renderer* renderer = nullptr;
+    bool has_scene = false;
+    std::string scene_path;
+    float time = 0;
+};
+
+// The scene of the job when it differs from the one the worker has loaded. Loading it only reads the
+// scene file, so its errors are the same on every worker.
+std::optional<Scene> load_job_scene(const gpu_worker& worker, const farm::job& job, const std::string& scene_path) {
+    if (worker.has_scene && worker.scene_path == scene_path && worker.time == job.time) {
+        return std::nullopt;
+    }
+    return scene_path.empty() ? generateRandomScene() : loadScene(scene_path);
+}
+
+void render_on_gpu(gpu_worker& worker, uint32_t gpu_index, const farm::job& job, const std::optional<Scene>& scene, const std::string& scene_path,
+    std::vector<uint8_t>& texels) {
+    if (worker.renderer == nullptr) {
+        worker.renderer = offscreen::create_renderer(gpu_index);
+    }
+    if (scene) {
+        offscreen::load_scene(*worker.renderer, scene.value(), MeshScene{}, SphereMode::Aabb, 0, job.time);
+        worker.has_scene = true;
+        worker.scene_path = scene_path;
+        worker.time = job.time;
+    }
+    offscreen::set_resolution(*worker.renderer, job.width, job.height);
+    offscreen::clear_samples(*worker.renderer);
+    auto camera = offscreen::camera{
+        .position = glm::vec3(job.camera_position[0], job.camera_position[1], job.camera_position[2]),
+        .direction = glm::vec3(job.camera_direction[0], job.camera_direction[1], job.camera_direction[2])
+    };
+    offscreen::render(*worker.renderer, camera, 0, job.samples, job.first_row, job.row_count);
+    offscreen::read_image(*worker.renderer, job.first_row, job.row_count, texels.data());
+}
+
+// Stand-in for a GPU on hosts without ray tracing: the sky colour of the miss shader fading to
+// white towards the bottom, with a red band that moves with the time. It is cheap and depends only
+// on the pixel and the frame, which is all a test of the tile assembly and the worker loss needs.
+void render_synthetic(const farm::job& job, std::vector<uint8_t>& texels) {
+    auto band = job.time * 0.5f - std::floor(job.time * 0.5f);
+    for (uint32_t row = 0; row < job.row_count; row++) {
+        auto t = float(job.first_row + row) / job.height;
+        for (uint32_t x = 0; x < job.width; x++) {
+            auto texel = &texels[(size_t{ row } * job.width + x) * 4];
+            auto in_band = std::abs(float(x) / job.width - band) < 0.02f;
+            texel[0] = static_cast<uint8_t>(std::lround(255 * (in_band ? 1.0f : 0.7f + 0.3f * t)));
+            texel[1] = static_cast<uint8_t>(std::lround(255 * (in_band ? 0.0f : 0.8f + 0.2f * t)));
+            texel[2] = static_cast<uint8_t>(std::lround(255 * (in_band ? 0.0f : 1.0f)));
+            texel[3] = 255;
+        }
+    }
+}
+
+int run_worker(const options& options, uint32_t worker_index) {
+    int fd = farm::connect_unix_socket(options.socket_path);
+    farm::send_message(fd, farm::message_type::hello, farm::hello{ .worker = worker_index });
+
+    auto gpu_index = worker_index % options.gpu_count;
+    auto worker = gpu_worker{};
+    auto texels = std::vector<uint8_t>{};
+    uint32_t job_count = 0;
+    while (auto message = farm::receive_message(fd)) {
+        auto job = farm::get_payload_head<farm::job>(message.value());
+        if (message->type != farm::message_type::job || !job) {
+            break;
+        }
+        if (options.crash_after > 0 && worker_index == 0 && job_count == options.crash_after) {
+            // Fault injection: the worker dies with its jobs unanswered.
+            _exit(1);
+        }
+        auto scene_path_bytes = farm::get_payload_tail<farm::job>(message.value());
+        auto scene_path = std::string{ reinterpret_cast<const char*>(scene_path_bytes.data()), scene_path_bytes.size() };
+        texels.resize(size_t{ job->row_count } * job->width * 4);
+        auto scene = std::optional<Scene>{};
+        try {
+            if (!options.synthetic) {
+                scene = load_job_scene(worker, job.value(), scene_path);
+            }
+        }
+        catch (std::exception& e) {
+            auto error = std::string{ e.what() };
+            farm::send_message(fd, farm::message_type::error, std::as_bytes(std::span{ error }));
+            continue;
+        }
+        try {
+            if (options.synthetic) {
+                render_synthetic(job.value(), texels);
+            }
+            else {
+                render_on_gpu(worker, gpu_index, job.value(), scene, scene_path, texels);
+            }
+        }
+        catch (std::exception& e) {
+            // A render or device error, like a lost device or exhausted memory, is this worker's own. The
+            // worker reports it and exits, which drops its renderer, and the coordinator requeues its tiles.
+            // A lost device cannot be waited on, so the renderer is not destroyed first.
+            auto error = std::string{ e.what() };
+            farm::send_message(fd, farm::message_type::failed, std::as_bytes(std::span{ error }));
+            close(fd);
+            _exit(1);
+        }
+        auto rows = farm::rows{ .frame = job->frame, .first_row = job->first_row, .row_count = job->row_count, .width = job->width };
+        if (!farm::send_message(fd, farm::message_type::rows, rows, std::as_bytes(std::span{ texels }))) {
+            break;
+        }
+        job_count++;
+    }
+    offscreen::destroy_renderer(worker.renderer);
+    close(fd);
+    return 0;
+}
+
+struct worker_state {
+    pid_t pid = -1;
+    int fd = -1;
+    bool alive = false;
+    // Tiles sent and not answered yet, a worker answers them in order.
+    std::deque<uint32_t> tiles;
+    std::chrono::steady_clock::time_point last_message;
+    uint32_t tiles_rendered = 0;
+    uint32_t rows_rendered = 0;
+};
+
+// Up to this many tiles are queued at a worker, so it starts the next one while the coordinator
+// receives the last.
+constexpr size_t max_queued_tiles = 2;
+
+class coordinator {
+public:
+    coordinator(const options& options) : m_options(options), m_workers(options.worker_count) {
+        m_listener = farm::listen_unix_socket(options.socket_path, static_cast<int>(options.worker_count));
+        std::cout.flush();
+        for (uint32_t i = 0; i < options.worker_count; i++) {
+            auto pid = fork();
+            if (pid < 0) {
+                throw std::runtime_error("[Error] failed to start worker " + std::to_string(i));
+            }
+            if (pid == 0) {
+                close(m_listener);
+                int exit_code = 1;
+                try {
+                    exit_code = run_worker(options, i);
+                }
+                catch (std::exception& e) {
+                    std::cerr << "worker[" << i << "]: " << e.what() << std::endl;
+                }
+                _exit(exit_code);
+            }
+            m_workers[i].pid = pid;
+        }
+        accept_workers();
+    }
+
+    ~coordinator() {
+        for (auto& worker : m_workers) {
+            if (worker.alive) {
+                farm::send_message(worker.fd, farm::message_type::shutdown, std::span<const std::byte>{});
+                close(worker.fd);
+            }
+            if (worker.pid > 0) {
+                waitpid(worker.pid, nullptr, 0);
+            }
+        }
+        close(m_listener);
+        unlink(m_options.socket_path.c_str());
+    }
+
+    std::vector<uint8_t> render_frame(uint32_t frame) {
+        auto& options = m_options;
+        auto tile_count = (options.height + options.tile_rows - 1) / options.tile_rows;
+        auto image = std::vector<uint8_t>(size_t{ options.width } * options.height * 4);
+        m_pending_tiles.clear();
+        m_frame_error.reset();
+        for (uint32_t tile = 0; tile < tile_count; tile++) {
+            m_pending_tiles.push_back(tile);
+        }
+
+        uint32_t done_tile_count = 0;
+        while (done_tile_count < tile_count) {
+            for (uint32_t i = 0; i < m_workers.size(); i++) {
+                while (m_workers[i].alive && m_workers[i].tiles.size() < max_queued_tiles && !m_pending_tiles.empty() && !m_frame_error) {
+                    send_tile(i, frame, m_pending_tiles.front());
+                }
+            }
+            auto poll_fds = std::vector<pollfd>{};
+            auto poll_workers = std::vector<uint32_t>{};
+            for (uint32_t i = 0; i < m_workers.size(); i++) {
+                if (m_workers[i].alive && !m_workers[i].tiles.empty()) {
+                    poll_fds.push_back({ .fd = m_workers[i].fd, .events = POLLIN, .revents = 0 });
+                    poll_workers.push_back(i);
+                }
+            }
+            // After a job error no more tiles are sent, the frame fails once the tiles in flight are answered.
+            if (poll_fds.empty()) {
+                throw std::runtime_error(m_frame_error.value_or("[Error] all workers lost"));
+            }
+            if (poll(poll_fds.data(), poll_fds.size(), 1000) < 0 && errno != EINTR) {
+                throw std::runtime_error("[Error] failed to wait for the workers");
+            }
+            for (size_t p = 0; p < poll_fds.size(); p++) {
+                if (poll_fds[p].revents != 0 && receive_tile(poll_workers[p], frame, image)) {
+                    done_tile_count++;
+                }
+            }
+            if (options.job_timeout > 0) {
+                auto now = std::chrono::steady_clock::now();
+                for (uint32_t i = 0; i < m_workers.size(); i++) {
+                    auto& worker = m_workers[i];
+                    if (worker.alive && !worker.tiles.empty() &&
+                        std::chrono::duration<double>(now - worker.last_message).count() > options.job_timeout) {
+                        lose_worker(i, "no answer within the job timeout");
+                    }
+                }
+            }
+        }
+        return image;
+    }
+
+    void print_stats() const {
+        for (uint32_t i = 0; i < m_workers.size(); i++) {
+            auto& worker = m_workers[i];
+            std::cout << "worker[" << i << "]: " << worker.tiles_rendered << " tiles, " << worker.rows_rendered << " rows"
+                << (worker.alive ? "" : ", lost") << std::endl;
+        }
+    }
+
+private:
+    // Workers that exit or do not connect within the deadline are lost from the start, the ones still
+    // running are killed so the destructor does not wait for them.
+    void accept_workers() {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        uint32_t waiting = m_options.worker_count;
+        while (waiting > 0 && std::chrono::steady_clock::now() < deadline) {
+            auto listener_fd = pollfd{ .fd = m_listener, .events = POLLIN, .revents = 0 };
+            if (poll(&listener_fd, 1, 100) > 0) {
+                int fd = accept4(m_listener, nullptr, nullptr, SOCK_CLOEXEC);
+                auto message = fd >= 0 ? farm::receive_message(fd) : std::nullopt;
+                auto hello = message ? farm::get_payload_head<farm::hello>(message.value()) : std::nullopt;
+                if (message && message->type == farm::message_type::hello && hello && hello->worker < m_workers.size() && !m_workers[hello->worker].alive) {
+                    m_workers[hello->worker].fd = fd;
+                    m_workers[hello->worker].alive = true;
+                    m_workers[hello->worker].last_message = std::chrono::steady_clock::now();
+                    waiting--;
+                }
+                else if (fd >= 0) {
+                    close(fd);
+                }
+            }
+            for (auto& worker : m_workers) {
+                if (!worker.alive && worker.pid > 0 && waitpid(worker.pid, nullptr, WNOHANG) == worker.pid) {
+                    worker.pid = -1;
+                    waiting--;
+                }
+            }
+        }
+        for (uint32_t i = 0; i < m_workers.size(); i++) {
+            if (!m_workers[i].alive) {
+                std::cout << "worker[" << i << "]: did not connect" << std::endl;
+                if (m_workers[i].pid > 0) {
+                    kill(m_workers[i].pid, SIGKILL);
+                }
+            }
+        }
+    }
+
+    void send_tile(uint32_t worker_index, uint32_t frame, uint32_t tile) {
+        auto& options = m_options;
+        auto& worker = m_workers[worker_index];
+        m_pending_tiles.pop_front();
+        worker.tiles.push_back(tile);
+
+        auto first_row = tile * options.tile_rows;
+        auto job = farm::job{
+            .frame = frame,
+            .first_row = first_row,
+            .row_count = std::min(options.tile_rows, options.height - first_row),
+            .width = options.width,
+            .height = options.height,
+            .samples = options.samples,
+            .time = frame * frame_time,
+            .camera_position = { 13.0f, 2.0f, -3.0f },
+            .camera_direction = { -13.0f, -2.0f, 3.0f }
+        };
+        if (worker.tiles.size() == 1) {
+            worker.last_message = std::chrono::steady_clock::now();
+        }
+        if (!farm::send_message(worker.fd, farm::message_type::job, job, std::as_bytes(std::span{ options.scene_path }))) {
+            lose_worker(worker_index, "connection closed");
+        }
+    }
+
+    // True when the message completed a tile.
+    bool receive_tile(uint32_t worker_index, uint32_t frame, std::vector<uint8_t>& image) {
+        auto& options = m_options;
+        auto& worker = m_workers[worker_index];
+        auto message = farm::receive_message(worker.fd);
+        if (!message) {
+            lose_worker(worker_index, "connection closed");
+            return false;
+        }
+        worker.last_message = std::chrono::steady_clock::now();
+        // A job error, like a scene that does not load, is the same on every worker, so it fails the frame
+        // rather than the worker, which stays for the next frame.
+        if (message->type == farm::message_type::error) {
+            auto error = std::string{ reinterpret_cast<const char*>(message->payload.data()), message->payload.size() };
+            std::cout << "worker[" << worker_index << "]: failed tile " << worker.tiles.front() << ", " << error << std::endl;
+            worker.tiles.pop_front();
+            if (!m_frame_error) {
+                m_frame_error = error;
+            }
+            return false;
+        }
+        if (message->type == farm::message_type::failed) {
+            auto error = std::string{ reinterpret_cast<const char*>(message->payload.data()), message->payload.size() };
+            lose_worker(worker_index, error);
+            return false;
+        }
+
+        auto tile = worker.tiles.front();
+        auto first_row = tile * options.tile_rows;
+        auto row_count = std::min(options.tile_rows, options.height - first_row);
+        auto rows = farm::get_payload_head<farm::rows>(message.value());
+        auto texels = rows ? farm::get_payload_tail<farm::rows>(message.value()) : std::span<const std::byte>{};
+        if (message->type != farm::message_type::rows || !rows || rows->frame != frame || rows->first_row != first_row ||
+            rows->row_count != row_count || rows->width != options.width || texels.size() != size_t{ row_count } * options.width * 4) {
+            lose_worker(worker_index, "unexpected message");
+            return false;
+        }
+        memcpy(image.data() + size_t{ first_row } * options.width * 4, texels.data(), texels.size());
+        worker.tiles.pop_front();
+        worker.tiles_rendered++;
+        worker.rows_rendered += row_count;
+        return true;
+    }
+
+    // The tiles of a lost worker go back to the front of the queue, to the workers left.
+    void lose_worker(uint32_t worker_index, const std::string& reason) {
+        auto& worker = m_workers[worker_index];
+        std::cout << "worker[" << worker_index << "]: lost, " << reason << ", " << worker.tiles.size() << " tiles requeued" << std::endl;
+        m_pending_tiles.insert(m_pending_tiles.begin(), worker.tiles.begin(), worker.tiles.end());
+        worker.tiles.clear();
+        worker.alive = false;
+        close(worker.fd);
+        worker.fd = -1;
+        if (worker.pid > 0) {
+            kill(worker.pid, SIGKILL);
+        }
+    }
+
+    options m_options;
+    int m_listener;
+    std::vector<worker_state> m_workers;
+    std::deque<uint32_t> m_pending_tiles;
+    // The first job error of the frame.
+    std::optional<std::string> m_frame_error;
+};
+
+void write_ppm(const std::string& path, const std::vector<uint8_t>& image, uint32_t width, uint32_t height) {
+    auto file = std::ofstream{ path, std::ios::binary };
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (size_t texel = 0; texel < image.size(); texel += 4) {
+        file.write(reinterpret_cast<const char*>(&image[texel]), 3);
+    }
+    if (!file) {
+        throw std::runtime_error("[Error] failed to write " + path);
+    }
+}
+
+int main(int argc, const char** argv) {
+    using namespace std::literals;
+    // COMMAND LINE ARGUMENTS
+    auto options = ::options{};
+    options.socket_path = "/tmp/render_farm_" + std::to_string(getpid()) + ".sock";
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i] == "--help"s) {
+            std::cout << "--help                            # Show this help infomation" << std::endl;
+            std::cout << "--workers <count>                 # Worker processes, worker i renders on GPU i modulo the GPU count" << std::endl;
+            std::cout << "--gpus <count>                    # GPUs the workers are pinned to" << std::endl;
+            std::cout << "--synthetic                       # Workers render a test pattern on the CPU instead of using a GPU" << std::endl;
+            std::cout << "--scene <path>                    # Binary scene file to render (see scene_generator)" << std::endl;
+            std::cout << "--width <width>                   # Image width" << std::endl;
+            std::cout << "--height <height>                 # Image height" << std::endl;
+            std::cout << "--samples <count>                 # Samples per pixel" << std::endl;
+            std::cout << "--frames <count>                  # Frames to render, 1/30 s of scene time apart" << std::endl;
+            std::cout << "--tile-rows <rows>                # Rows of the tiles the frames are cut into" << std::endl;
+            std::cout << "--output <prefix>                 # Write every frame to <prefix><frame>.ppm" << std::endl;
+            std::cout << "--socket <path>                   # Unix socket the workers connect to" << std::endl;
+            std::cout << "--job-timeout <seconds>           # Give up on a worker that does not answer for this long" << std::endl;
+            std::cout << "--crash-after <jobs>              # Make worker 0 exit at this job, to test the worker loss" << std::endl;
+            exit(0);
+        }
+        else if (argv[i] == "--workers"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), options.worker_count);
+            ++i;
+        }
+        else if (argv[i] == "--gpus"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), options.gpu_count);
+            ++i;
+        }
+        else if (argv[i] == "--synthetic"s) {
+            options.synthetic = true;
+        }
+        else if (argv[i] == "--scene"s) {
+            options.scene_path = argv[i + 1];
+            ++i;
+        }
+        else if (argv[i] == "--width"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), options.width);
+            ++i;
+        }
+        else if (argv[i] == "--height"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), options.height);
+            ++i;
+        }
+        else if (argv[i] == "--samples"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), options.samples);
+            ++i;
+        }
+        else if (argv[i] == "--frames"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), options.frame_count);
+            ++i;
+        }
+        else if (argv[i] == "--tile-rows"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), options.tile_rows);
+            ++i;
+        }
+        else if (argv[i] == "--output"s) {
+            options.output_prefix = argv[i + 1];
+            ++i;
+        }
+        else if (argv[i] == "--socket"s) {
+            options.socket_path = argv[i + 1];
+            ++i;
+        }
+        else if (argv[i] == "--job-timeout"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), options.job_timeout);
+            ++i;
+        }
+        else if (argv[i] == "--crash-after"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), options.crash_after);
+            ++i;
+        }
+        else {
+            std::cerr << "unknown argument: " << argv[i] << std::endl;
+        }
+    }
+
+    try {
+        if (options.worker_count == 0 || options.gpu_count == 0 || options.width == 0 || options.height == 0 || options.tile_rows == 0 || options.samples == 0) {
+            throw std::runtime_error("[Error] need at least one worker, one GPU, one pixel, one row per tile and one sample");
+        }
+        auto coordinator = ::coordinator{ options };
+        for (uint32_t frame = 0; frame < options.frame_count; frame++) {
+            auto begin = std::chrono::steady_clock::now();
+            auto image = coordinator.render_frame(frame);
+            auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin);
+            std::cout << "frame " << frame << ": " << duration.count() << " ms" << std::endl;
+            if (!options.output_prefix.empty()) {
+                write_ppm(options.output_prefix + std::to_string(frame) + ".ppm", image, options.width, options.height);
+            }
+        }
+        coordinator.print_stats();
+        return 0;
+    }
+    catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,15 @@
+# Runs the farm with worker 0 dying at its second job. The farm has to exit cleanly with the frame
+# completed by the worker left.
+execute_process(
+    COMMAND ${RENDER_FARM} --synthetic --workers 2 --crash-after 1
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE output
+)
+message("${output}")
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "render_farm exited with ${result}")
+endif()
+if(NOT output MATCHES "worker\\[0\\]: lost.*frame 0: ")
+    message(FATAL_ERROR "frame 0 did not complete after worker 0 was lost")
+endif()
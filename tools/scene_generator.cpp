@@ -0,0 +1,62 @@
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "scene.h"
+
+int main(int argc, const char** argv) {
+    using namespace std::literals;
+    // COMMAND LINE ARGUMENTS
+    uint32_t sphere_count = 0;
+    int32_t grid_half_extent = 11;
+    const char* output_path = "scene.rtsc";
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i] == "--help"s) {
+            std::cout << "--help                            # Show this help infomation" << std::endl;
+            std::cout << "--grid <half extent>              # Small spheres on a (2 * half extent)^2 grid" << std::endl;
+            std::cout << "--spheres <count>                 # Pick the grid size for at least <count> spheres" << std::endl;
+            std::cout << "--output <path>                   # Scene file to write" << std::endl;
+            exit(0);
+        }
+        else if (argv[i] == "--grid"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), grid_half_extent);
+            ++i;
+        }
+        else if (argv[i] == "--spheres"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), sphere_count);
+            ++i;
+        }
+        else if (argv[i] == "--output"s) {
+            output_path = argv[i + 1];
+            ++i;
+        }
+        else {
+            std::cerr << "unknown argument: " << argv[i] << std::endl;
+        }
+    }
+
+    if (sphere_count > 0) {
+        grid_half_extent = static_cast<int32_t>(std::ceil(std::sqrt(sphere_count / 4.0)));
+    }
+
+    try {
+        auto begin_time = std::chrono::steady_clock::now();
+        auto scene = generateRandomScene(grid_half_extent);
+        auto generated_time = std::chrono::steady_clock::now();
+        saveScene(scene, output_path);
+        auto saved_time = std::chrono::steady_clock::now();
+
+        std::cout << output_path << ": " << scene.spheres.size() << " spheres, " << scene.materials.size() << " materials, "
+            << scene.animations.size() << " animations" << std::endl;
+        std::cout << "generate: " << std::chrono::duration_cast<std::chrono::milliseconds>(generated_time - begin_time)
+            << ", write: " << std::chrono::duration_cast<std::chrono::milliseconds>(saved_time - generated_time) << std::endl;
+    }
+    catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
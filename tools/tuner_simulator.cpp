@@ -0,0 +1,270 @@
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "workload_tuner.hpp"
+
+// A synthetic multi-GPU setup the tuner is run against, one frame_info per benchmark segment.
+struct scenario {
+    std::string name;
+    // Rows of unit cost per millisecond of every GPU.
+    std::vector<double> speeds;
+    // Standard deviation of the measured GPU durations relative to the real ones.
+    double noise;
+    // From segment throttle_segment on, GPU throttle_gpu runs at throttle_factor of its speed.
+    uint32_t throttle_segment = UINT32_MAX;
+    uint32_t throttle_gpu = 0;
+    double throttle_factor = 1;
+    // Cost of the rows from top to bottom grows linearly from 1 - cost_slope to 1 + cost_slope.
+    double cost_slope = 0;
+    // The tuner gets the cost of every row each segment, measured with the same relative noise as the durations.
+    bool report_row_cost = false;
+};
+
+struct scenario_result {
+    // Segments until the frame stays within convergence_tolerance of the ideal one, counted from the last speed change.
+    uint32_t segments_to_convergence;
+    // Frame duration over the ideal one minus one, averaged over the last quarter of the segments.
+    double steady_state_imbalance;
+    // Largest change of the rows of one GPU within the last quarter of the segments.
+    uint32_t oscillation_rows;
+    // Distributions returned by the tuner, each one rebuilds the resources of every GPU.
+    uint32_t rebalance_count;
+};
+
+constexpr double convergence_tolerance = 0.05;
+
+double get_row_cost(const scenario& scenario, uint32_t row, uint32_t rows) {
+    return 1 + scenario.cost_slope * (2.0 * (row + 0.5) / rows - 1);
+}
+
+double get_speed(const scenario& scenario, uint32_t gpu, uint32_t segment) {
+    auto speed = scenario.speeds[gpu];
+    if (segment >= scenario.throttle_segment && gpu == scenario.throttle_gpu) {
+        speed *= scenario.throttle_factor;
+    }
+    return speed;
+}
+
+// Milliseconds every GPU needs for its strip, the strips stacked from the top in GPU order.
+std::vector<double> get_gpu_durations(const scenario& scenario, const std::vector<uint32_t>& workload_distribution, uint32_t rows, uint32_t segment) {
+    auto durations = std::vector<double>(workload_distribution.size());
+    uint32_t first_row = 0;
+    for (uint32_t gpu = 0; gpu < workload_distribution.size(); gpu++) {
+        auto cost = 0.0;
+        for (auto row = first_row; row < first_row + workload_distribution[gpu]; row++) {
+            cost += get_row_cost(scenario, row, rows);
+        }
+        durations[gpu] = cost / get_speed(scenario, gpu, segment);
+        first_row += workload_distribution[gpu];
+    }
+    return durations;
+}
+
+// Shortest frame any split into strips of whole rows reaches.
+double get_ideal_duration(const scenario& scenario, uint32_t rows, uint32_t segment) {
+    auto fits = [&scenario, rows, segment](double duration) {
+        uint32_t row = 0;
+        for (uint32_t gpu = 0; gpu < scenario.speeds.size() && row < rows; gpu++) {
+            auto budget = duration * get_speed(scenario, gpu, segment);
+            while (row < rows && get_row_cost(scenario, row, rows) <= budget) {
+                budget -= get_row_cost(scenario, row, rows);
+                row++;
+            }
+        }
+        return row == rows;
+    };
+    auto low = 0.0;
+    auto high = rows * (1 + scenario.cost_slope) / std::ranges::min(scenario.speeds) / std::min(1.0, scenario.throttle_factor);
+    for (int i = 0; i < 60; i++) {
+        auto middle = (low + high) / 2;
+        (fits(middle) ? high : low) = middle;
+    }
+    return high;
+}
+
+scenario_result simulate(const scenario& scenario, uint32_t rows, uint32_t segment_count, uint32_t seed) {
+    auto gpu_count = static_cast<uint32_t>(scenario.speeds.size());
+    auto random_engine = std::mt19937{ seed };
+    auto noise = std::normal_distribution<double>{ 1, scenario.noise };
+
+    tune::tuning_info tuning_info{};
+    tune::init_tuning_info(tuning_info, rows, gpu_count);
+
+    // The same initial split as the renderer: equal strips, the remainder on the first GPU.
+    auto workload_distribution = std::vector<uint32_t>(gpu_count, rows / gpu_count);
+    workload_distribution[0] += rows - gpu_count * (rows / gpu_count);
+
+    auto result = scenario_result{};
+    auto imbalances = std::vector<double>(segment_count);
+    auto distributions = std::vector<std::vector<uint32_t>>(segment_count);
+    auto last_change = scenario.throttle_segment < segment_count ? scenario.throttle_segment : 0;
+    for (uint32_t segment = 0; segment < segment_count; segment++) {
+        auto durations = get_gpu_durations(scenario, workload_distribution, rows, segment);
+        auto frame_duration = std::ranges::max(durations);
+        imbalances[segment] = frame_duration / get_ideal_duration(scenario, rows, segment) - 1;
+        distributions[segment] = workload_distribution;
+
+        auto frame_info = tune::frame_info{
+            .workload_distribution = workload_distribution,
+            .duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(frame_duration)),
+            .estimated_gpu_duration = std::vector<std::chrono::steady_clock::duration>(gpu_count)
+        };
+        for (uint32_t gpu = 0; gpu < gpu_count; gpu++) {
+            auto measured = durations[gpu] * std::max(0.0, noise(random_engine));
+            frame_info.estimated_gpu_duration[gpu] =
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(measured));
+        }
+        if (scenario.report_row_cost) {
+            auto row_cost = std::vector<double>(rows);
+            for (uint32_t row = 0; row < rows; row++) {
+                row_cost[row] = get_row_cost(scenario, row, rows) * std::max(0.0, noise(random_engine));
+            }
+            tune::set_row_cost(tuning_info, std::move(row_cost));
+        }
+        tune::add_frame_info(tuning_info, std::move(frame_info));
+        if (auto next_workload_distribution = tune::get_workload(tuning_info)) {
+            workload_distribution = next_workload_distribution.value();
+            result.rebalance_count++;
+        }
+    }
+
+    result.segments_to_convergence = segment_count - last_change;
+    for (auto segment = segment_count; segment > last_change && imbalances[segment - 1] <= convergence_tolerance; segment--) {
+        result.segments_to_convergence = segment - 1 - last_change;
+    }
+
+    auto steady_state_begin = segment_count - std::max(1u, segment_count / 4);
+    result.steady_state_imbalance = std::accumulate(imbalances.begin() + steady_state_begin, imbalances.end(), 0.0) / (segment_count - steady_state_begin);
+
+    for (uint32_t gpu = 0; gpu < gpu_count; gpu++) {
+        auto [min_rows, max_rows] = std::ranges::minmax(
+            distributions | std::views::drop(steady_state_begin) | std::views::transform([gpu](auto& distribution) { return distribution[gpu]; }));
+        result.oscillation_rows = std::max(result.oscillation_rows, max_rows - min_rows);
+    }
+    return result;
+}
+
+std::vector<double> parse_speeds(const char* text) {
+    auto speeds = std::vector<double>{};
+    auto end = text + strlen(text);
+    while (text < end) {
+        double speed = 0;
+        auto [next, error] = std::from_chars(text, end, speed);
+        if (error != std::errc{} || speed <= 0) {
+            throw std::runtime_error("[Error] invalid GPU speeds");
+        }
+        speeds.push_back(speed);
+        text = next < end ? next + 1 : next;
+    }
+    return speeds;
+}
+
+int main(int argc, const char** argv) {
+    using namespace std::literals;
+    // COMMAND LINE ARGUMENTS
+    uint32_t rows = 1080;
+    uint32_t segment_count = 40;
+    uint32_t seed = 1;
+    const char* speeds_text = "1,2,0.5";
+    double noise = 0.05;
+    double max_imbalance = 0;
+    uint32_t max_convergence_segments = UINT32_MAX;
+    const char* scenario_name = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i] == "--help"s) {
+            std::cout << "--help                            # Show this help infomation" << std::endl;
+            std::cout << "--rows <count>                    # Image height distributed by the tuner" << std::endl;
+            std::cout << "--segments <count>                # Benchmark segments to simulate per scenario" << std::endl;
+            std::cout << "--speeds <s0,s1,...>              # Relative speed of every simulated GPU" << std::endl;
+            std::cout << "--noise <fraction>                # Relative noise of the measured GPU durations" << std::endl;
+            std::cout << "--seed <seed>                     # Seed of the timing noise" << std::endl;
+            std::cout << "--max-imbalance <fraction>        # Exit with 1 if a steady state is further off the ideal" << std::endl;
+            std::cout << "--max-convergence <segments>      # Exit with 1 if a scenario takes longer to converge" << std::endl;
+            std::cout << "--scenario <name>                 # Only run the scenario of that name" << std::endl;
+            exit(0);
+        }
+        else if (argv[i] == "--rows"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), rows);
+            ++i;
+        }
+        else if (argv[i] == "--segments"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), segment_count);
+            ++i;
+        }
+        else if (argv[i] == "--speeds"s) {
+            speeds_text = argv[i + 1];
+            ++i;
+        }
+        else if (argv[i] == "--noise"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), noise);
+            ++i;
+        }
+        else if (argv[i] == "--seed"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), seed);
+            ++i;
+        }
+        else if (argv[i] == "--max-imbalance"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), max_imbalance);
+            ++i;
+        }
+        else if (argv[i] == "--max-convergence"s) {
+            std::from_chars(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), max_convergence_segments);
+            ++i;
+        }
+        else if (argv[i] == "--scenario"s) {
+            scenario_name = argv[i + 1];
+            ++i;
+        }
+        else {
+            std::cerr << "unknown argument: " << argv[i] << std::endl;
+        }
+    }
+
+    try {
+        auto speeds = parse_speeds(speeds_text);
+        if (speeds.empty() || rows < speeds.size() || segment_count == 0) {
+            throw std::runtime_error("[Error] need at least one GPU, one row per GPU and one segment");
+        }
+        auto scenarios = std::vector<scenario>{
+            { .name = "fixed", .speeds = speeds, .noise = 0 },
+            { .name = "noisy", .speeds = speeds, .noise = noise },
+            { .name = "throttle", .speeds = speeds, .noise = noise,
+                .throttle_segment = segment_count / 2, .throttle_gpu = static_cast<uint32_t>(std::ranges::max_element(speeds) - speeds.begin()), .throttle_factor = 0.5 },
+            { .name = "cost_map", .speeds = speeds, .noise = noise, .cost_slope = 0.75 },
+            { .name = "cost_map_aware", .speeds = speeds, .noise = noise, .cost_slope = 0.75, .report_row_cost = true },
+        };
+
+        if (scenario_name) {
+            std::erase_if(scenarios, [scenario_name](auto& scenario) { return scenario.name != scenario_name; });
+            if (scenarios.empty()) {
+                throw std::runtime_error("[Error] unknown scenario: " + std::string{ scenario_name });
+            }
+        }
+
+        auto failed = false;
+        for (auto& scenario : scenarios) {
+            auto result = simulate(scenario, rows, segment_count, seed);
+            std::cout << scenario.name << ": "
+                << result.segments_to_convergence << " segments to convergence, "
+                << std::fixed << std::setprecision(2) << 100 * result.steady_state_imbalance << "% steady state imbalance, "
+                << result.oscillation_rows << " rows oscillation, "
+                << result.rebalance_count << " rebalances" << std::endl;
+            failed |= max_imbalance > 0 && result.steady_state_imbalance > max_imbalance;
+            failed |= result.segments_to_convergence > max_convergence_segments;
+        }
+        return failed ? 1 : 0;
+    }
+    catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}